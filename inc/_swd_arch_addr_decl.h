@@ -5,8 +5,21 @@
 #include <stdint.h>
 
 // System control register
+#define VTOR ((uint32_t)0xE000ED08)  // Vector Table Offset Register
 #define AIRCR ((uint32_t)0xE000ED0C) // Application Interrupt and Reset Control Register
+#define CCR ((uint32_t)0xE000ED14)   // Configuration and Control Register
 #define DFSR ((uint32_t)0xE000ED30)  // Debug Fault Status Register
+#define MVFR0 ((uint32_t)0xE000EF40) // Media and VFP Feature Register 0
+
+// Cache identification and maintenance, only implemented by cores with caches (Cortex-M7)
+#define CLIDR ((uint32_t)0xE000ED78)    // Cache Level ID Register
+#define CTR ((uint32_t)0xE000ED7C)      // Cache Type Register
+#define CCSIDR ((uint32_t)0xE000ED80)   // Cache Size ID Register
+#define CSSELR ((uint32_t)0xE000ED84)   // Cache Size Selection Register
+#define ICIALLU ((uint32_t)0xE000EF50)  // Invalidate the whole I-cache to PoU
+#define ICIMVAU ((uint32_t)0xE000EF58)  // Invalidate an I-cache line by address to PoU
+#define DCCIMVAC ((uint32_t)0xE000EF70) // Clean and invalidate a D-cache line by address to PoC
+#define DCCISW ((uint32_t)0xE000EF74)   // Clean and invalidate a D-cache line by set and way
 
 // Debug Registers
 #define DHCSR ((uint32_t)0xE000EDF0) // Debug Halting Control and Status Register
@@ -19,24 +32,82 @@
 #define FP_REMAP ((uint32_t)0xE0002004)
 #define FP_CMPN ((uint32_t)0xE0002008)
 
+// Data Watchpoint and Trace unit, comparator n registers are at DWT_COMP0 + 0x10 * n
+#define DWT_CTRL ((uint32_t)0xE0001000)
+#define DWT_CYCCNT ((uint32_t)0xE0001004) // Cycle Count Register
+#define DWT_PCSR ((uint32_t)0xE000101C)   // Program Counter Sample Register
+#define DWT_COMP0 ((uint32_t)0xE0001020)
+#define DWT_MASK0 ((uint32_t)0xE0001024)
+#define DWT_FUNCTION0 ((uint32_t)0xE0001028)
+#define DWT_CMP_STRIDE ((uint32_t)0x10)
+
 // Constants for convenience
 // DHCSR fields
-#define DBG_KEY ((uint32_t)0xA05F0000) // Special Sequence required for DHCSR
-#define C_DEBUGEN ((uint32_t)0x1)      // Bit required for DHCSR control bit
-#define C_HALT ((uint32_t)0x2)         // Halt debugger
-#define C_STEP ((uint32_t)0x4)         // Step debugger
-#define C_MASKINTS ((uint32_t)0x8)     // Mask interrupts when debugging
-#define S_HALTED ((uint32_t)0x20000)   // Halt status
-#define S_REGRDY ((uint32_t)0x10000)   // DCRDR status checking
+#define DBG_KEY ((uint32_t)0xA05F0000)    // Special Sequence required for DHCSR
+#define C_DEBUGEN ((uint32_t)0x1)         // Bit required for DHCSR control bit
+#define C_HALT ((uint32_t)0x2)            // Halt debugger
+#define C_STEP ((uint32_t)0x4)            // Step debugger
+#define C_MASKINTS ((uint32_t)0x8)        // Mask interrupts when debugging
+#define S_HALTED ((uint32_t)0x20000)      // Halt status
+#define S_REGRDY ((uint32_t)0x10000)      // DCRDR status checking
+#define S_LOCKUP ((uint32_t)0x80000)      // Core is locked up
+#define S_RETIRE_ST ((uint32_t)0x1000000) // Instruction retired since last read (sticky)
+#define S_RESET_ST ((uint32_t)0x2000000)  // Core reset since last read (sticky)
+
+// CFBP fields (CONTROL occupies bits [31:24])
+#define CFBP_FPCA ((uint32_t)0x04000000) // Floating-point context active
+
+// MVFR0 fields
+#define MVFR0_SIMD_REGS ((uint32_t)0xF) // Number of FP registers, 0 without an FPU
+
+// CCR fields
+#define CCR_DC ((uint32_t)0x10000) // D-cache enabled
+#define CCR_IC ((uint32_t)0x20000) // I-cache enabled
+
+// Cache identification fields
+#define CLIDR_CTYPE1 ((uint32_t)0x7)                          // Level 1 cache type, 0 if none
+#define CTR_IMINLINE(ctr) ((ctr) & 0xF)                       // log2 of the I-cache line words
+#define CTR_DMINLINE(ctr) (((ctr) >> 16) & 0xF)               // log2 of the D-cache line words
+#define CCSIDR_LINE_SIZE(ccsidr) ((ccsidr) & 0x7)             // log2 of the line words, minus 2
+#define CCSIDR_WAYS(ccsidr) ((((ccsidr) >> 3) & 0x3FF) + 1)   // Associativity
+#define CCSIDR_SETS(ccsidr) ((((ccsidr) >> 13) & 0x7FFF) + 1) // Number of sets
+
+// xPSR fields
+#define XPSR_T ((uint32_t)0x01000000) // Thumb state, must be set for the core to execute
+#define XPSR_IPSR ((uint32_t)0x1FF)   // Number of the active exception, 0 in Thread mode
+
+// DFSR fields, write 1 to clear
+#define DFSR_HALTED ((uint32_t)0x1)    // Halt request or step
+#define DFSR_BKPT ((uint32_t)0x2)      // Breakpoint
+#define DFSR_DWTTRAP ((uint32_t)0x4)   // Watchpoint
+#define DFSR_VCATCH ((uint32_t)0x8)    // Vector catch
+#define DFSR_EXTERNAL ((uint32_t)0x10) // External debug request (EDBGRQ)
 
 // DEMCR fields
-#define VC_CORERESET ((uint32_t)0x1) // Catch a local reset
+#define VC_CORERESET ((uint32_t)0x1)  // Catch a local reset
+#define TRCENA ((uint32_t)0x01000000) // Enable the DWT and ITM
+
+// DWT_CTRL fields
+#define DWT_NUMCOMP_SHIFT (28)    // Number of comparators, bits [31:28]
+#define CYCCNTENA ((uint32_t)0x1) // Enable the cycle counter
+
+// DWT_FUNCTIONn fields
+#define DWT_FUNC_MASK ((uint32_t)0xF)      // FUNCTION, 0 disables the comparator
+#define DWT_DATAVMATCH ((uint32_t)0x100)   // Compare data values instead of addresses
+#define DWT_LNK1ENA ((uint32_t)0x200)      // Linked address comparison is supported
+#define DWT_DATAVSIZE_SHIFT (10)           // Data value size, bits [11:10]
+#define DWT_DATAVADDR0_SHIFT (12)          // Linked address comparator, bits [15:12]
+#define DWT_DATAVADDR1_SHIFT (16)          // Second linked comparator, bits [19:16]
+#define DWT_MATCHED ((uint32_t)0x01000000) // Comparator matched, cleared on read
 
 // AIRCR fields
 #define VECTKEY ((uint32_t)0x05FA0000) // Special sequence required for AIRCR
 #define SYSRESETREQ ((uint32_t)0x4)    // Local reset core + peripherals
 #define VECTRESET ((uint32_t)0x1)      // Local reset core (and maybe peripherals)
 
+// Thumb instructions
+#define THUMB_BKPT ((uint16_t)0xBE00) // BKPT #0
+
 // FP_CTRL fields
 #define KEY ((uint32_t)0x2)
 // FP_COMPn fields
@@ -44,11 +115,22 @@
 
 // FP_REMAP fields
 #define RMPSPT ((uint32_t)0x20000000)
+#define REMAP_MASK ((uint32_t)0x1FFFFFE0) // Remap table address bits [28:5]
 
 // ARMv7-M Memory Regions
 #define CODE_BASE_ADDR ((uint32_t)0x0)
 #define CODE_END_ADDR ((uint32_t)0x1FFFFFFF)
 #define SRAM_BASE_ADDR ((uint32_t)0x20000000)
 #define SRAM_END_ADDR ((uint32_t)0x3FFFFFFF)
+#define PERIPH_BASE_ADDR ((uint32_t)0x40000000)
+#define PERIPH_END_ADDR ((uint32_t)0x5FFFFFFF)
+#define EXT_RAM_BASE_ADDR ((uint32_t)0x60000000)
+#define EXT_RAM_END_ADDR ((uint32_t)0x9FFFFFFF)
+#define EXT_DEV_BASE_ADDR ((uint32_t)0xA0000000)
+#define EXT_DEV_END_ADDR ((uint32_t)0xDFFFFFFF)
+#define PPB_BASE_ADDR ((uint32_t)0xE0000000)
+#define PPB_END_ADDR ((uint32_t)0xE00FFFFF)
+#define VENDOR_BASE_ADDR ((uint32_t)0xE0100000)
+#define VENDOR_END_ADDR ((uint32_t)0xFFFFFFFF)
 
 #endif // __SWD_ARCH_ADDR_DECL_H
\ No newline at end of file
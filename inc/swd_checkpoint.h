@@ -0,0 +1,101 @@
+
+#ifndef __SWD_CHECKPOINT_H
+#define __SWD_CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_crc_target.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/* "SWDC" in little endian, first word of a stored checkpoint */
+#define SWD_CHECKPOINT_MAGIC ((uint32_t)0x43445753)
+#define SWD_CHECKPOINT_VERSION (1)
+
+/* Flag of a page table entry whose page holds a single byte value, given by the low byte */
+#define SWD_CHECKPOINT_PAGE_FILL ((uint32_t)0x80000000)
+
+/* Smallest scratch SRAM which lets `swd_checkpoint_restore` hash pages on the target */
+#define SWD_CHECKPOINT_SCRATCH_SIZE (SWD_CRC32_TARGET_SIZE + 20)
+
+/*
+ * @brief Target memory saved by a checkpoint
+ */
+typedef struct _swd_checkpoint_region_t {
+    uint32_t start;
+    uint32_t len;
+} swd_checkpoint_region_t;
+
+/*
+ * @brief Checkpoint held in host memory in its stored form, so it can be written to and read from
+ *          a file as is. All fields of the stored form are little endian:
+ *  header      magic, version, size, CRC32 of the rest, page size, region count, register count,
+ *              0, register set (64 bit)
+ *  registers   one word per register, indexed by swd_target_register_t
+ *  regions     start, length and index of the first page, one entry per region
+ *  page table  CRC32 of the page and offset of its content, or SWD_CHECKPOINT_PAGE_FILL and
+ *              the byte value of a page holding a single value
+ *  content     the pages which are not a single value
+ */
+typedef struct _swd_checkpoint_t {
+    uint8_t *data;
+    uint32_t size;
+} swd_checkpoint_t;
+
+typedef struct _swd_checkpoint_stats_t {
+    /*
+     * Pages of the checkpoint
+     */
+    uint32_t pages;
+    /*
+     * Pages whose target content differed from the checkpoint and were written back
+     */
+    uint32_t dirty;
+    uint64_t bytes_written;
+} swd_checkpoint_stats_t;
+
+/*
+ * @brief Save the core registers and target memory of the halted target. The memory is split
+ *          into pages of SWD_CHECKPOINT_PAGE_SIZE bytes, each stored with its CRC32
+ * @param swd_checkpoint_t* reference of the checkpoint structure to initialize
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param swd_checkpoint_region_t* regions to save, ex. the RAM of the application
+ * @param uint32_t number of regions
+ * @param uint8_t* buffer receiving the stored form
+ * @param uint32_t size of the buffer. Pages holding a single byte value take no content, the
+ *          others take their size
+ * @return SWD_HOST_TABLE_FULL if the buffer is too small
+ */
+swd_err_t swd_checkpoint_capture(swd_checkpoint_t *cp, swd_host_t *host,
+                                 const swd_checkpoint_region_t *regions, uint32_t cnt,
+                                 uint8_t *buf, uint32_t bufsz);
+
+/*
+ * @brief Use a checkpoint read back from storage. Nothing is copied, the memory has to stay
+ *          valid while the checkpoint is used
+ * @param swd_checkpoint_t* reference of the checkpoint structure to initialize
+ * @param uint8_t* stored form
+ * @param uint32_t size of the stored form
+ * @return SWD_CHECKPOINT_INVALID if the stored form is corrupted, inconsistent or of another
+ *          version
+ */
+swd_err_t swd_checkpoint_open(swd_checkpoint_t *cp, uint8_t *data, uint32_t size);
+
+/*
+ * @brief Bring the halted target back to a checkpoint. The target pages are hashed and only
+ *          those whose CRC32 differs from the checkpoint are written, then every saved register
+ *          is restored
+ * @param swd_checkpoint_t* reference of the checkpoint
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param uint32_t start of SRAM outside of the checkpoint's regions whose content may be lost,
+ *          word aligned. The pages are hashed on the target with a CRC routine copied there
+ * @param uint32_t size of that SRAM. Below SWD_CHECKPOINT_SCRATCH_SIZE, ex. 0, the pages are
+ *          hashed on the host from a streamed read instead
+ * @param swd_checkpoint_stats_t* what was written. Can be NULL
+ * @return SWD_TARGET_INVALID_ADDR if the scratch SRAM overlaps a region
+ */
+swd_err_t swd_checkpoint_restore(const swd_checkpoint_t *cp, swd_host_t *host, uint32_t scratch,
+                                 uint32_t scratch_size, swd_checkpoint_stats_t *_Nullable stats);
+
+#endif // __SWD_CHECKPOINT_H
\ No newline at end of file
@@ -12,8 +12,151 @@
 /* Enable Built in logging of swd activity */
 #define SWD_ENABLE_LOGGING
 
+/*
+ * Block DAP ports which are undefined under certain misconfigurations (DB0-DB3, BASE).
+ * The host still uses DB0-DB3 internally since it keeps CSW.Size at word
+ */
 #define SWD_DISABLE_UNDEFINED_PORT
 
+/* Number of words staged on the stack for each pipelined memory transfer */
+#define SWD_HOST_XFER_CHUNK_WORDS (64)
+
+/* Maximum number of segments sorted together by readv/writev. Larger vectors are split */
+#define SWD_HOST_IOV_BATCH_SIZE (32)
+
+/*
+ * Largest gap (in bytes) between two readv segments which is read through instead of
+ * starting a new transfer. Rewriting TAR costs about as much as reading a few words
+ */
+#define SWD_HOST_IOV_COALESCE_GAP (16)
+
+/*
+ * Size in bytes of the chunks of the streaming transfers, each staged in a stack buffer. Must be
+ * a multiple of 4
+ */
+#define SWD_HOST_STREAM_CHUNK_BYTES (256)
+
+/* Longest pattern `swd_host_memory_find` can search for */
+#define SWD_HOST_FIND_MAX_PATTERN (64)
+
+/*
+ * Polling interval bounds of the debug event monitor, in the caller's tick unit. The interval
+ * drops to the minimum whenever the target is resumed and doubles on every idle poll
+ */
+#define SWD_HOST_MONITOR_MIN_INTERVAL (1)
+#define SWD_HOST_MONITOR_MAX_INTERVAL (128)
+
+/* Upper bound of the instructions stepped by one `swd_host_step_range` call */
+#define SWD_HOST_STEP_RANGE_MAX_STEPS (100000)
+
+/* Number of FPB comparators (code and literal) shadowed by the host */
+#define SWD_HOST_MAX_FPB_COMPARATORS (16)
+
+/*
+ * Slots of the software breakpoint hash table. Must be a power of two, at most three quarters
+ * of the slots are used
+ */
+#define SWD_HOST_SW_BKPT_SLOTS (64)
+
+/* Number of DWT comparators shadowed by the host */
+#define SWD_HOST_MAX_DWT_COMPARATORS (8)
+
+/*
+ * Buckets of the PC sampling profiler's histogram. Must be a power of two, samples of new PCs
+ * are dropped once three quarters of the buckets are used
+ */
+#define SWD_PROFILE_BUCKETS (1024)
+
+/* Number of PC samples read in one pipelined transfer by the profiler */
+#define SWD_PROFILE_BATCH (64)
+
+/* DHCSR polls to wait for a flash algorithm function to return */
+#define SWD_FLASH_MAX_POLLS (1000000)
+
+/* Bytes covered by one on-target CRC when verifying flash */
+#define SWD_FLASH_VERIFY_BLOCK (4096)
+
+/* Largest number of sectors compared by one differential programming call */
+#define SWD_FLASH_DIFF_MAX_SECTORS (2048)
+
+/*
+ * Share of the flash's sectors (in percent) which must have changed for differential
+ * programming to erase the whole chip instead of single sectors
+ */
+#define SWD_FLASH_CHIP_ERASE_PERCENT (50)
+
+/*
+ * zlib compatible `uint32_t f(uint32_t crc, const uint8_t *buf, uint32_t len)` used for the host
+ * side CRC32, ex. a ROM routine. If this is not set ARMv8 CRC instructions are used when the
+ * compiler provides them, a table otherwise
+ */
+// #define SWD_CRC32_HW_FUNC esp_rom_crc32_le
+
+/* DHCSR polls to wait for the on-target CRC routine to return */
+#define SWD_CRC32_TARGET_MAX_POLLS (1000000)
+
+/*
+ * Bytes staged by the image loader to merge adjacent segments and records. Blocks handed to a
+ * sink end on a multiple of it, so it should be a multiple of the flash page size
+ */
+#define SWD_IMAGE_CHUNK_BYTES (4096)
+
+/*
+ * Value of the bytes between segments or records which share a chunk. They are staged along,
+ * so a flash page is programmed once, and should match the erased value of the flash
+ */
+#define SWD_IMAGE_GAP_FILL (0xFF)
+
+/* Let the image loader map files with POSIX mmap */
+// #define SWD_IMAGE_ENABLE_MMAP
+
+/* Provide `swd_coredump_save`, which writes the core file through a POSIX mmap of it */
+// #define SWD_COREDUMP_ENABLE_MMAP
+
+/*
+ * Granularity of checkpoints. Smaller pages make restores write less but the checkpoint larger,
+ * as each page costs a table entry and a CRC call
+ */
+#define SWD_CHECKPOINT_PAGE_SIZE (1024)
+
+/* Bytes read, checked and rewritten at a time by a march element run from the host */
+#define SWD_MEMTEST_BLOCK_BYTES (1024)
+
+/* DHCSR polls to wait for a march element run on the target */
+#define SWD_MEMTEST_MAX_POLLS (1000000)
+
+/* Longest .gcda file name, including the prefix of the file sink */
+#define SWD_GCOV_MAX_PATH (256)
+
+/* Provide `swd_gcov_sink_files`, which writes .gcda files with stdio */
+// #define SWD_GCOV_ENABLE_FILES
+
+/*
+ * Status word reads per pipelined poll of a test mailbox. DHCSR is checked between polls, to
+ * notice a test which faulted instead of completing
+ */
+#define SWD_TESTRUN_POLL_BURST (32)
+
+/* Reads of the status word, or of DHCSR, to wait for a test of a mailbox test binary */
+#define SWD_TESTRUN_MAX_POLLS (1000000)
+
+/* Maximum number of entries in the host's memory region table */
+#define SWD_HOST_MAX_REGIONS (16)
+
+/*
+ * Host side cache of target memory used for cacheable regions while the target is halted.
+ * Set the number of lines to 0 to disable it
+ */
+#define SWD_HOST_MEM_CACHE_LINES (8)
+#define SWD_HOST_MEM_CACHE_LINE_WORDS (8)
+
+/*
+ * Line aligned address ranges written since the core last ran, whose D-cache lines are cleaned
+ * and I-cache lines invalidated before it runs again on cores with caches (Cortex-M7). Ranges
+ * are merged when the table is full. Set to 0 to disable the cache maintenance
+ */
+#define SWD_HOST_CACHE_MAINT_RANGES (8)
+
 #ifdef SWD_ENABLE_LOGGING
 
 /*
@@ -0,0 +1,51 @@
+
+#ifndef __SWD_COREDUMP_H
+#define __SWD_COREDUMP_H
+
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/*
+ * @brief Range of target memory saved in a core dump
+ */
+typedef struct _swd_coredump_region_t {
+    uint32_t start;
+    uint32_t len;
+} swd_coredump_region_t;
+
+/*
+ * @brief Stream an ELF core file of the halted target to `consumer`: an NT_PRSTATUS note with
+ *          R0-R15 and xPSR, an NT_ARM_VFP note when a floating-point context is active, and one
+ *          PT_LOAD segment per region. GDB loads it with `target core`
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param swd_coredump_region_t* memory to save, ex. every RAM bank
+ * @param uint32_t number of regions
+ * @param swd_host_stream_consumer_t receives the file in ascending offsets. Memory comes in
+ *          chunks of up to SWD_HOST_STREAM_CHUNK_BYTES, each only valid during the call
+ * @param void* context passed to the consumer. Can be NULL
+ * @param uint64_t* size of the core file. Can be NULL
+ */
+swd_err_t swd_coredump_write(swd_host_t *host, const swd_coredump_region_t *regions,
+                             uint32_t cnt, swd_host_stream_consumer_t consumer,
+                             void *_Nullable ctx, uint64_t *_Nullable size);
+
+#ifdef SWD_COREDUMP_ENABLE_MMAP
+/*
+ * @brief Save an ELF core file of the halted target, see `swd_coredump_write`. The file is
+ *          mapped and written in place, so the kernel writes the pages back while the next
+ *          chunks are read from the target
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param char* path of the file, created or replaced. It is removed again on an error
+ * @param swd_coredump_region_t* memory to save, ex. every RAM bank
+ * @param uint32_t number of regions
+ * @param uint64_t* size of the core file. Can be NULL
+ */
+swd_err_t swd_coredump_save(swd_host_t *host, const char *path,
+                            const swd_coredump_region_t *regions, uint32_t cnt,
+                            uint64_t *_Nullable size);
+#endif // SWD_COREDUMP_ENABLE_MMAP
+
+#endif // __SWD_COREDUMP_H
\ No newline at end of file
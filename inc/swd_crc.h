@@ -0,0 +1,26 @@
+
+#ifndef __SWD_CRC_H
+#define __SWD_CRC_H
+
+#include <stdint.h>
+
+#include "swd_conf.h"
+
+/*
+ * @brief Continue a CRC32 (IEEE 802.3, reflected, as in zlib) over `len` bytes
+ * @param uint32_t CRC of the preceding data, 0 to start
+ * @param uint8_t* data
+ * @param uint32_t number of bytes
+ * @return CRC of the preceding data followed by `data`
+ */
+uint32_t swd_crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Continue a CRC32 over `len` bytes of `value`, ex. erased flash
+ * @param uint32_t CRC of the preceding data, 0 to start
+ * @param uint8_t value of every byte
+ * @param uint32_t number of bytes
+ */
+uint32_t swd_crc32_fill(uint32_t crc, uint8_t value, uint32_t len);
+
+#endif // __SWD_CRC_H
\ No newline at end of file
@@ -0,0 +1,51 @@
+
+#ifndef __SWD_CRC_TARGET_H
+#define __SWD_CRC_TARGET_H
+
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/* Target memory used by `swd_crc32_target_load`: a BKPT trap and the CRC routine */
+#define SWD_CRC32_TARGET_SIZE (44)
+
+/*
+ * @brief CRC routine loaded into target SRAM
+ */
+typedef struct _swd_crc32_target_t {
+    swd_host_t *host;
+    /*
+     * Address of the BKPT trap the routine returns to, the routine follows it
+     */
+    uint32_t trap;
+    uint32_t code;
+    uint32_t sp;
+} swd_crc32_target_t;
+
+/*
+ * @brief Copy a Thumb-1 CRC32 routine to SRAM of the halted target, so memory can be hashed
+ *          without reading it over the wire
+ * @param swd_crc32_target_t* reference of the routine structure to initialize
+ * @param swd_host_t* started host of a halted target
+ * @param uint32_t word aligned address of SWD_CRC32_TARGET_SIZE bytes of SRAM
+ * @param uint32_t stack pointer given to the routine, 8 byte aligned. The routine does not push,
+ *          but the exception entry of a fault would
+ */
+swd_err_t swd_crc32_target_load(swd_crc32_target_t *tgt, swd_host_t *host, uint32_t addr,
+                                uint32_t sp);
+
+/*
+ * @brief CRC32 of target memory computed by the loaded routine, same result as
+ *          `swd_crc32_update(0, ...)` over the memory
+ * @param swd_crc32_target_t* reference of the loaded routine
+ * @param uint32_t address of the memory
+ * @param uint32_t number of bytes
+ * @param uint32_t* CRC of the memory
+ * @note The core registers are lost
+ */
+swd_err_t swd_crc32_target(const swd_crc32_target_t *tgt, uint32_t addr, uint32_t len,
+                           uint32_t *crc);
+
+#endif // __SWD_CRC_TARGET_H
\ No newline at end of file
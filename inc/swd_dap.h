@@ -23,6 +23,11 @@ typedef struct _swd_dap_t {
      *          error has ocurred
      */
     bool _ap_error;
+    /*
+     * @brief Internal flag which lets DB0-DB3 through even if SWD_DISABLE_UNDEFINED_PORT
+     *          is set. Only set by users which keep CSW.Size at word
+     */
+    bool _bd_allowed;
 } swd_dap_t;
 
 /*
@@ -74,4 +79,49 @@ swd_err_t swd_dap_port_read(swd_dap_t *dap, swd_dap_port_t port, uint32_t *data)
  */
 swd_err_t swd_dap_port_write(swd_dap_t *dap, swd_dap_port_t port, uint32_t data);
 
+/*
+ * @brief Perform `cnt` consecutive reads of the same DP/AP port. AP reads are pipelined,
+ *          so only one extra RDBUFF read is needed for the whole block
+ * @param swd_dap_t* reference of dap structure to read form
+ * @param swd_dap_port_t DP/AP port name
+ * @param uint32_t* data buffer of at least `cnt` words
+ * @param uint32_t number of reads to perform
+ * @return status of dap read
+ * @note On failure the contents of `data` are undefined
+ */
+swd_err_t swd_dap_port_read_block(swd_dap_t *dap, swd_dap_port_t port, uint32_t *data,
+                                  uint32_t cnt);
+
+/*
+ * @brief Perform `cnt` consecutive writes to the same DP/AP port
+ * @param swd_dap_t* reference of dap structure to write to
+ * @param swd_dap_port_t DP/AP port name
+ * @param uint32_t* data to be written, one word per write
+ * @param uint32_t number of writes to perform
+ * @return status of dap write
+ */
+swd_err_t swd_dap_port_write_block(swd_dap_t *dap, swd_dap_port_t port, const uint32_t *data,
+                                   uint32_t cnt);
+
+/*
+ * @brief Perform a pipelined sequence of reads over different AP ports
+ * @param swd_dap_t* reference of dap structure to read form
+ * @param swd_dap_port_t* AP ports to read, in order. All must share the same APBANKSEL
+ * @param uint32_t* data buffer of at least `cnt` words
+ * @param uint32_t number of ports to read
+ * @return status of dap read
+ */
+swd_err_t swd_dap_port_read_multi(swd_dap_t *dap, const swd_dap_port_t *ports, uint32_t *data,
+                                  uint32_t cnt);
+
+/*
+ * @brief Allow access to the banked data ports (DB0-DB3) when SWD_DISABLE_UNDEFINED_PORT
+ *          is set
+ * @param swd_dap_t* reference of dap structure
+ * @param bool whether or not banked data ports can be accessed
+ * @note Banked data accesses are only defined while CSW.Size is set to word. The caller
+ *          is responsible for keeping it that way
+ */
+void swd_dap_allow_banked_data(swd_dap_t *dap, bool allow);
+
 #endif // __SWD_DAP_H
\ No newline at end of file
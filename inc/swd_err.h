@@ -24,6 +24,16 @@
 
 #endif // defined(SWD_DO_RUNTIME_ASSERT)
 
+/*
+ * Error checking is done multiple times. Can only be used if the function returns a swd_err_t
+ */
+#define SWD_RETURN_IF_NON_OK(err)                                                                  \
+    do {                                                                                           \
+        if ((err) != SWD_OK) {                                                                     \
+            return err;                                                                            \
+        }                                                                                          \
+    } while (0)
+
 typedef enum _swd_err_t {
     SWD_OK = 0,
     SWD_ERR,
@@ -36,6 +46,13 @@ typedef enum _swd_err_t {
     SWD_TARGET_INVALID_ADDR,
     SWD_TARGET_NO_MORE_BKPT,
     SWD_HOST_INVALID_REGISTER,
+    SWD_HOST_TABLE_FULL,
+    SWD_HOST_XFER_CANCELLED,
+    SWD_TARGET_NOT_SUPPORTED,
+    SWD_FLASH_ALGO_FAILED,
+    SWD_IMAGE_INVALID,
+    SWD_HOST_STEP_LIMIT,
+    SWD_CHECKPOINT_INVALID,
 
 #ifdef SWD_DISABLE_UNDEFINED_PORT
     SWD_DAP_UNDEFINED_PORT,
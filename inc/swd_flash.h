@@ -0,0 +1,200 @@
+
+#ifndef __SWD_FLASH_H
+#define __SWD_FLASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_crc_target.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/* Offset of a function the flash algorithm does not implement */
+#define SWD_FLASH_NO_FUNC ((uint32_t)0xFFFFFFFF)
+
+/* Geometry of the stub algorithm returned by `swd_flash_stub_algo` */
+#define SWD_FLASH_STUB_PAGE_SIZE (256)
+#define SWD_FLASH_STUB_SECTOR_SIZE (1024)
+
+/*
+ * @brief Operation passed to the algorithm's Init and UnInit, as in CMSIS-Pack flash algorithms
+ */
+typedef enum _swd_flash_fnc_t {
+    SWD_FLASH_FNC_NONE = 0,
+    SWD_FLASH_FNC_ERASE = 1,
+    SWD_FLASH_FNC_PROGRAM = 2,
+    SWD_FLASH_FNC_VERIFY = 3,
+} swd_flash_fnc_t;
+
+/*
+ * @brief Position independent flash algorithm, ex. the PrgCode and PrgData sections of a
+ *          CMSIS-Pack FLM file. Every function returns 0 on success in R0
+ */
+typedef struct _swd_flash_algo_t {
+    /*
+     * Code and static data, copied as is to SRAM
+     */
+    const uint8_t *code;
+    uint32_t code_size;
+    /*
+     * Offsets of the functions within `code`, SWD_FLASH_NO_FUNC for the optional ones.
+     *  int Init(uint32_t adr, uint32_t clk, uint32_t fnc)
+     *  int UnInit(uint32_t fnc)
+     *  int EraseSector(uint32_t adr)
+     *  int EraseChip(void), optional
+     *  int ProgramPage(uint32_t adr, uint32_t sz, uint8_t *buf)
+     */
+    uint32_t init;
+    uint32_t uninit;
+    uint32_t erase_sector;
+    uint32_t erase_chip;
+    uint32_t program_page;
+    /*
+     * Offset of the static data within `code`, passed in R9
+     */
+    uint32_t static_base;
+    /*
+     * Flash device described by the algorithm. The page size is the data handed to one
+     *  ProgramPage call
+     */
+    uint32_t flash_base;
+    uint32_t flash_size;
+    uint32_t sector_size;
+    uint32_t page_size;
+    uint8_t erased_value;
+} swd_flash_algo_t;
+
+typedef struct _swd_flash_t {
+    /*
+     * @brief Host of the target being programmed
+     */
+    swd_host_t *host;
+    swd_flash_algo_t algo;
+    /*
+     * SRAM layout: BKPT trap and CRC routine, code, two page buffers, stack
+     */
+    uint32_t _trap;
+    swd_crc32_target_t _crc;
+    uint32_t _code;
+    uint32_t _bufs[2];
+    uint32_t _sp;
+    /*
+     * Operation Init was called for, SWD_FLASH_FNC_NONE before Init and after UnInit
+     */
+    swd_flash_fnc_t _fnc;
+} swd_flash_t;
+
+/*
+ * @brief Outcome of a differential programming call
+ */
+typedef struct _swd_flash_diff_stats_t {
+    /*
+     * Sectors covered by the image
+     */
+    uint32_t sectors;
+    /*
+     * Sectors whose content differed from the image
+     */
+    uint32_t changed;
+    /*
+     * Changed sectors which were only erased since the image leaves them erased
+     */
+    uint32_t blank;
+    /*
+     * Whether the whole chip was erased instead of the changed sectors
+     */
+    bool chip_erase;
+} swd_flash_diff_stats_t;
+
+/*
+ * @brief Copy a flash algorithm to SRAM of the halted target
+ * @param swd_flash_t* reference of the flash structure to initialize
+ * @param swd_host_t* started host of a halted target
+ * @param swd_flash_algo_t* algorithm, copied into the flash structure
+ * @param uint32_t start of the SRAM given to the algorithm, word aligned
+ * @param uint32_t size of the SRAM. It holds a 4 byte trap, a 40 byte CRC routine, the code,
+ *          two pages and the stack
+ * @return SWD_TARGET_INVALID_ADDR if the algorithm does not fit
+ * @note The SRAM content and the core registers are lost
+ */
+swd_err_t swd_flash_load(swd_flash_t *flash, swd_host_t *host, const swd_flash_algo_t *algo,
+                         uint32_t ram_start, uint32_t ram_size);
+
+/*
+ * @brief Erase the sector holding `addr`
+ * @param swd_flash_t* reference of the loaded flash structure
+ * @param uint32_t address within the sector
+ * @return SWD_FLASH_ALGO_FAILED if EraseSector reported an error
+ */
+swd_err_t swd_flash_erase_sector(swd_flash_t *flash, uint32_t addr);
+
+/*
+ * @brief Erase the whole flash, sector by sector when the algorithm has no EraseChip
+ * @param swd_flash_t* reference of the loaded flash structure
+ * @return SWD_FLASH_ALGO_FAILED if the algorithm reported an error
+ */
+swd_err_t swd_flash_erase_chip(swd_flash_t *flash);
+
+/*
+ * @brief Program erased flash. The pages are double buffered: while ProgramPage writes one
+ *          SRAM buffer, the next page is uploaded to the other one
+ * @param swd_flash_t* reference of the loaded flash structure
+ * @param uint32_t flash address of the data
+ * @param uint8_t* data to program
+ * @param uint32_t number of bytes. Partially covered pages are padded with the erased value
+ * @return SWD_FLASH_ALGO_FAILED if ProgramPage reported an error
+ */
+swd_err_t swd_flash_program(swd_flash_t *flash, uint32_t addr, const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Erase and program only the sectors whose content differs from the image. The CRC32 of
+ *          every covered sector is computed on the host and on the target, then compared. When
+ *          at least SWD_FLASH_CHIP_ERASE_PERCENT of the flash's sectors changed and the algorithm
+ *          has EraseChip, the chip is erased and every sector of the image is programmed
+ * @param swd_flash_t* reference of the loaded flash structure
+ * @param uint32_t flash address of the image
+ * @param uint8_t* image
+ * @param uint32_t number of bytes. Bytes of the covered sectors outside of the image are
+ *          expected to be erased
+ * @param bool whether the chip may be erased, which also erases flash outside of the image
+ * @param swd_flash_diff_stats_t* what was done. Can be NULL
+ * @return SWD_TARGET_NOT_SUPPORTED if the image covers more than SWD_FLASH_DIFF_MAX_SECTORS
+ *          sectors
+ */
+swd_err_t swd_flash_program_diff(swd_flash_t *flash, uint32_t addr, const uint8_t *data,
+                                 uint32_t len, bool allow_chip_erase,
+                                 swd_flash_diff_stats_t *_Nullable stats);
+
+/*
+ * @brief Verify flash content without reading it back. The CRC32 of every block of
+ *          SWD_FLASH_VERIFY_BLOCK bytes is computed by a routine running on the target and
+ *          compared with the host's. Only blocks with a mismatching CRC are read back
+ * @param swd_flash_t* reference of the loaded flash structure
+ * @param uint32_t address of the data
+ * @param uint8_t* expected data
+ * @param uint32_t number of bytes
+ * @param bool* true if the target memory matches `data`
+ * @param uint32_t* address of the first differing byte when not equal. Can be NULL
+ * @note Any target memory can be verified, not only the algorithm's flash
+ */
+swd_err_t swd_flash_verify(swd_flash_t *flash, uint32_t addr, const uint8_t *data, uint32_t len,
+                           bool *equal, uint32_t *_Nullable bad_addr);
+
+/*
+ * @brief Call the algorithm's UnInit once done with the flash
+ * @param swd_flash_t* reference of the loaded flash structure
+ */
+swd_err_t swd_flash_finish(swd_flash_t *flash);
+
+/*
+ * @brief Describe a stub algorithm which "programs" target RAM, so the engine can be tested
+ *          without a flash device. EraseSector fills a SWD_FLASH_STUB_SECTOR_SIZE sector with
+ *          0xFF and ProgramPage copies the page buffer. Thumb-1 only, runs on any Cortex-M
+ * @param swd_flash_algo_t* algorithm to fill
+ * @param uint32_t start of the RAM acting as flash, sector aligned
+ * @param uint32_t size of the RAM acting as flash, a multiple of the sector size
+ */
+void swd_flash_stub_algo(swd_flash_algo_t *algo, uint32_t base, uint32_t size);
+
+#endif // __SWD_FLASH_H
\ No newline at end of file
@@ -0,0 +1,95 @@
+
+#ifndef __SWD_GCOV_H
+#define __SWD_GCOV_H
+
+#include <stdint.h>
+
+#ifdef SWD_GCOV_ENABLE_FILES
+#include <stdio.h>
+#endif // SWD_GCOV_ENABLE_FILES
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_image.h"
+
+/* Section of the pointers to every `struct gcov_info`, emitted by GCC's -fprofile-info-section */
+#define SWD_GCOV_INFO_SECTION ".gcov_info"
+
+/* Symbols bounding the pointer array when the linker script places it in another section */
+#define SWD_GCOV_INFO_START "__gcov_info_start"
+#define SWD_GCOV_INFO_END "__gcov_info_end"
+
+/*
+ * @brief Receives the .gcda files, one after the other
+ * @param void* context given to `swd_gcov_dump`
+ * @param char* file name compiled into the firmware, usually an absolute path
+ * @param uint32_t offset of `data` within the file, 0 for the start of a new file
+ * @param uint8_t* file content
+ * @param uint32_t number of bytes, 0 once the file is complete
+ * @return Anything other than SWD_OK aborts the dump with that error
+ */
+typedef swd_err_t (*swd_gcov_sink_t)(void *_Nullable ctx, const char *filename, uint32_t offset,
+                                     const uint8_t *_Nullable data, uint32_t len);
+
+typedef struct _swd_gcov_stats_t {
+    /*
+     * .gcda files written, one per instrumented object
+     */
+    uint32_t files;
+    uint32_t functions;
+    /*
+     * Counter values read from the target
+     */
+    uint32_t counters;
+    /*
+     * Scatter-gather reads, more than one only when the work buffer can not hold every counter
+     */
+    uint32_t reads;
+} swd_gcov_stats_t;
+
+#ifdef SWD_GCOV_ENABLE_FILES
+/*
+ * @brief State of `swd_gcov_sink_files`
+ */
+typedef struct _swd_gcov_files_t {
+    /*
+     * Prepended to every file name, as GCOV_PREFIX does. Can be NULL
+     */
+    const char *_Nullable prefix;
+    FILE *_Nullable _file;
+} swd_gcov_files_t;
+#endif // SWD_GCOV_ENABLE_FILES
+
+/*
+ * @brief Write the .gcda files of firmware built with -fprofile-arcs -fprofile-info-section.
+ *          The `struct gcov_info` lists and the tables they point to are taken from the ELF
+ *          image, only the counter arrays are read from the target, all of them with one
+ *          coalesced scatter-gather read
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param swd_image_t* ELF image of the running firmware
+ * @param void* work buffer, pointer aligned, holding the read list and the counters
+ * @param uint32_t size of the work buffer. The counters of one object file have to fit, else
+ *          the objects are read in several passes
+ * @param swd_gcov_sink_t receives the files
+ * @param void* context passed to the sink. Can be NULL
+ * @param swd_gcov_stats_t* what was written. Can be NULL
+ * @return SWD_TARGET_NOT_SUPPORTED if the image has no gcov info list or was built by a GCC
+ *          older than 11
+ * @note Every file holds a single run. Runs are accumulated by merging the files, ex. with
+ *          gcov-tool merge
+ */
+swd_err_t swd_gcov_dump(swd_host_t *host, const swd_image_t *elf, void *work, uint32_t work_size,
+                        swd_gcov_sink_t sink, void *_Nullable ctx,
+                        swd_gcov_stats_t *_Nullable stats);
+
+#ifdef SWD_GCOV_ENABLE_FILES
+/*
+ * @brief Sink writing each .gcda file with stdio, creating or replacing it
+ * @param void* the `swd_gcov_files_t*` of the sink, zero initialized except for the prefix
+ */
+swd_err_t swd_gcov_sink_files(void *_Nullable ctx, const char *filename, uint32_t offset,
+                              const uint8_t *_Nullable data, uint32_t len);
+#endif // SWD_GCOV_ENABLE_FILES
+
+#endif // __SWD_GCOV_H
\ No newline at end of file
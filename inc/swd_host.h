@@ -12,6 +12,254 @@
 #define _Nullable
 #endif // _Nullable
 
+/*
+ * @brief Kind of memory a region maps to
+ */
+typedef enum _swd_host_region_type_t {
+    SWD_REGION_FLASH,
+    SWD_REGION_RAM,
+    SWD_REGION_PERIPHERAL,
+    SWD_REGION_PPB,
+} swd_host_region_type_t;
+
+// Access widths a region can be accessed with
+#define SWD_REGION_ACCESS_BYTE ((uint8_t)0x1)
+#define SWD_REGION_ACCESS_HALFWORD ((uint8_t)0x2)
+#define SWD_REGION_ACCESS_WORD ((uint8_t)0x4)
+#define SWD_REGION_ACCESS_ANY                                                                      \
+    (SWD_REGION_ACCESS_BYTE | SWD_REGION_ACCESS_HALFWORD | SWD_REGION_ACCESS_WORD)
+
+/*
+ * @brief Access policy for a range of target memory
+ */
+typedef struct _swd_host_region_t {
+    /*
+     * First address of the region
+     */
+    uint32_t start;
+    /*
+     * Last address of the region (inclusive)
+     */
+    uint32_t end;
+    swd_host_region_type_t type;
+    /*
+     * Mask of SWD_REGION_ACCESS_* widths which the region supports
+     */
+    uint8_t access;
+    /*
+     * Whether or not reads can be served from the host while the target is halted
+     */
+    bool cacheable;
+    /*
+     * Whether or not reading can change the state of the target (ex. FIFO registers).
+     *  Such regions are never read speculatively
+     */
+    bool read_side_effects;
+} swd_host_region_t;
+
+/*
+ * @brief Software breakpoint. The original halfword is restored when it is removed
+ */
+typedef struct _swd_host_sw_bkpt_t {
+    uint32_t addr;
+    uint16_t orig;
+    bool used;
+} swd_host_sw_bkpt_t;
+
+/*
+ * @brief What a flash patch replaces. Instruction fetches are remapped by code comparators,
+ *          literal loads by literal comparators
+ */
+typedef enum _swd_host_patch_kind_t {
+    SWD_PATCH_CODE,
+    SWD_PATCH_LITERAL,
+} swd_host_patch_kind_t;
+
+/*
+ * @brief Flash patch applied through the FPB remap table
+ */
+typedef struct _swd_host_patch_t {
+    /*
+     * Word aligned address of the patched word
+     */
+    uint32_t addr;
+    /*
+     * Word seen by the core instead of the flash contents
+     */
+    uint32_t data;
+    swd_host_patch_kind_t kind;
+} swd_host_patch_t;
+
+/*
+ * @brief Accesses a watchpoint halts on. Values are the ARMv7-M DWT_FUNCTION encodings
+ */
+typedef enum _swd_host_watch_kind_t {
+    SWD_WATCH_READ = 5,
+    SWD_WATCH_WRITE = 6,
+    SWD_WATCH_ACCESS = 7,
+} swd_host_watch_kind_t;
+
+/*
+ * @brief DWT data watchpoint
+ */
+typedef struct _swd_host_watchpoint_t {
+    /*
+     * Watched address, aligned to `size`
+     */
+    uint32_t addr;
+    /*
+     * Size of the watched range in bytes, a power of two
+     */
+    uint32_t size;
+    swd_host_watch_kind_t kind;
+    /*
+     * Only halt when the accessed data equals `value`. Needs a comparator with data value
+     *  matching and a second, linked comparator for the address
+     */
+    bool match_value;
+    uint32_t value;
+    /*
+     * Size of the matched value in bytes: 1, 2 or 4
+     */
+    uint8_t value_size;
+    /*
+     * Comparator reporting the watchpoint in the halt reason, set by the host
+     */
+    uint8_t cmp;
+} swd_host_watchpoint_t;
+
+#if SWD_HOST_MEM_CACHE_LINES > 0
+typedef struct _swd_host_cache_line_t {
+    uint32_t addr;
+    bool valid;
+    uint32_t data[SWD_HOST_MEM_CACHE_LINE_WORDS];
+} swd_host_cache_line_t;
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+typedef struct _swd_host_cache_range_t {
+    /*
+     * First and last line address written
+     */
+    uint32_t start;
+    uint32_t last;
+} swd_host_cache_range_t;
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+
+struct _swd_host_t;
+
+/*
+ * @brief Debug events reported by the event monitor
+ */
+typedef enum _swd_host_event_t {
+    SWD_EVENT_HALTED,
+    SWD_EVENT_RESUMED,
+    SWD_EVENT_RESET,
+    SWD_EVENT_LOCKUP,
+} swd_host_event_t;
+
+// Reasons of a SWD_EVENT_HALTED event. Several can be set at once
+#define SWD_HALT_REASON_REQUEST ((uint32_t)0x01)  // Halt request (C_HALT)
+#define SWD_HALT_REASON_BKPT ((uint32_t)0x02)     // Breakpoint
+#define SWD_HALT_REASON_WATCH ((uint32_t)0x04)    // DWT watchpoint
+#define SWD_HALT_REASON_VCATCH ((uint32_t)0x08)   // Vector catch
+#define SWD_HALT_REASON_EXTERNAL ((uint32_t)0x10) // External debug request
+#define SWD_HALT_REASON_STEP ((uint32_t)0x20)     // Step issued by the host
+// With SWD_HALT_REASON_WATCH, which DWT comparators matched
+#define SWD_HALT_REASON_WATCH_CMP(n) ((uint32_t)0x100 << (n))
+
+/*
+ * @brief Limits of an instruction trace
+ */
+typedef struct _swd_host_trace_cfg_t {
+    /*
+     * Maximum number of instructions to step
+     */
+    uint32_t max_steps;
+    /*
+     * Stop once the PC enters [stop_addr, stop_addr + stop_len). A length of 0 disables it
+     */
+    uint32_t stop_addr;
+    uint32_t stop_len;
+    /*
+     * Keep PendSV, SysTick and external interrupts masked (C_MASKINTS) while stepping
+     */
+    bool mask_ints;
+} swd_host_trace_cfg_t;
+
+/*
+ * @brief Code region timed by `swd_host_cycles_measure`
+ */
+typedef struct _swd_host_cycles_cfg_t {
+    /*
+     * Address of the first instruction of the region
+     */
+    uint32_t start;
+    /*
+     * Address at which the region is left, its instruction is not counted
+     */
+    uint32_t end;
+    /*
+     * Number of times the region is timed
+     */
+    uint32_t iterations;
+    /*
+     * Cycles subtracted from every sample: stepping off the start breakpoint and entering
+     *  debug state at the end. Core specific, measure it once with an empty region
+     */
+    uint32_t overhead;
+    /*
+     * DHCSR polls to wait for each halt
+     */
+    uint32_t max_polls;
+} swd_host_cycles_cfg_t;
+
+/*
+ * @brief Cycle counts of the timed iterations, after the overhead was subtracted
+ */
+typedef struct _swd_host_cycle_stats_t {
+    uint32_t cnt;
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+} swd_host_cycle_stats_t;
+
+/*
+ * @brief Function of the target called by `swd_host_call_start`, AAPCS calling convention
+ */
+typedef struct _swd_host_call_t {
+    /*
+     * Address of the Thumb function, bit 0 is ignored
+     */
+    uint32_t entry;
+    /*
+     * Arguments passed in R0-R3
+     */
+    uint32_t args[4];
+    /*
+     * Initial SP, 8-byte aligned
+     */
+    uint32_t sp;
+    /*
+     * Address of a BKPT instruction the function returns to through LR
+     */
+    uint32_t trap;
+    /*
+     * Static base passed in R9 to position independent code
+     */
+    uint32_t sb;
+} swd_host_call_t;
+
+/*
+ * @brief Called by the event monitor for every detected event
+ * @param swd_host_t* host which detected the event
+ * @param swd_host_event_t event
+ * @param uint32_t SWD_HALT_REASON_* bits for SWD_EVENT_HALTED, 0 otherwise
+ * @param void* context given to `swd_host_monitor_set_callback`
+ */
+typedef void (*swd_host_event_cb_t)(struct _swd_host_t *host, swd_host_event_t event,
+                                    uint32_t reason, void *_Nullable ctx);
+
 typedef struct _swd_host_t {
     /*
      * @brief DAP to communicate to the target with
@@ -31,8 +279,159 @@ typedef struct _swd_host_t {
      * FPB unit version
      */
     uint8_t _fpb_version;
+    /*
+     * Number of literal comparators (FP Remaps) supported
+     */
+    uint8_t _lit_cmp_cnt;
+    /*
+     * Shadow of FP_COMPn, code comparators first followed by the literal comparators. Only the
+     *  host changes them, so it is read once when the host starts
+     */
+    uint32_t _fp_comp[SWD_HOST_MAX_FPB_COMPARATORS];
+    /*
+     * Flash patches indexed by comparator, `_patch_mask` tells which comparators hold one
+     */
+    swd_host_patch_t _patches[SWD_HOST_MAX_FPB_COMPARATORS];
+    uint32_t _patch_mask;
+    /*
+     * SRAM address of the remap table, 0 when not set
+     */
+    uint32_t _remap_table;
+    bool _remap_supported;
+    /*
+     * Number of DWT comparators, the largest supported address mask and the comparators which
+     *  can match data values against a linked address comparator
+     */
+    uint8_t _dwt_cmp_cnt;
+    uint8_t _dwt_max_mask;
+    uint32_t _dwt_datav_mask;
+    /*
+     * Watchpoints indexed by the comparator reporting them. `_dwt_used` also covers the address
+     *  comparators linked to data value watchpoints and comparators in use by the firmware.
+     *  `_dwt_func` shadows the DWT_FUNCTIONn registers
+     */
+    swd_host_watchpoint_t _watches[SWD_HOST_MAX_DWT_COMPARATORS];
+    uint32_t _watch_mask;
+    uint32_t _dwt_used;
+    uint32_t _dwt_func[SWD_HOST_MAX_DWT_COMPARATORS];
+    /*
+     * Software breakpoints, open addressing keyed by address
+     */
+    swd_host_sw_bkpt_t _sw_bkpts[SWD_HOST_SW_BKPT_SLOTS];
+    uint32_t _sw_bkpt_cnt;
+    /*
+     * Last value written to the AP's CSW register
+     */
+    uint32_t _csw;
+    /*
+     * Last known value of the AP's TAR register. Only meaningful when `_tar_valid` is set
+     */
+    uint32_t _tar;
+    bool _tar_valid;
+    /*
+     * Whether or not the target was halted the last time it was checked
+     */
+    bool _target_halted;
+    /*
+     * Whether or not the target has an FPU (and S0-S31, FPSCR)
+     */
+    bool _has_fpu;
+    /*
+     * Register values read or staged while the target is halted. Dirty registers still have to
+     * be written to the target
+     */
+    uint32_t _regs[REG_CNT];
+    swd_target_register_set_t _regs_valid;
+    swd_target_register_set_t _regs_dirty;
+    /*
+     * Sticky DHCSR bits seen by any DHCSR read since the monitor last consumed them
+     */
+    uint32_t _dhcsr_sticky;
+    /*
+     * Event monitor state
+     */
+    swd_host_event_cb_t _Nullable _mon_cb;
+    void *_Nullable _mon_ctx;
+    uint32_t _mon_status;
+    uint32_t _mon_interval;
+    uint32_t _mon_next;
+    bool _mon_poll_now;
+    bool _mon_stepping;
+    /*
+     * Memory regions sorted by start address
+     */
+    swd_host_region_t _regions[SWD_HOST_MAX_REGIONS];
+    uint8_t _region_cnt;
+#if SWD_HOST_MEM_CACHE_LINES > 0
+    swd_host_cache_line_t _cache[SWD_HOST_MEM_CACHE_LINES];
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    /*
+     * Caches of the core, `_cm_line` is the smallest line size in bytes and 0 without caches.
+     *  The D-cache geometry is used to maintain it by set and way
+     */
+    uint32_t _cm_line;
+    uint32_t _cm_sets;
+    uint32_t _cm_ways;
+    uint8_t _cm_set_shift;
+    uint8_t _cm_way_shift;
+    /*
+     * Memory changed since the core last ran, still to be made visible to its caches
+     */
+    swd_host_cache_range_t _cm_ranges[SWD_HOST_CACHE_MAINT_RANGES];
+    uint32_t _cm_range_cnt;
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
 } swd_host_t;
 
+/*
+ * @brief A single segment of a scatter-gather memory transfer
+ */
+typedef struct _swd_host_iovec_t {
+    /*
+     * Target address of the first byte
+     */
+    uint32_t addr;
+    /*
+     * Number of bytes to transfer
+     */
+    uint32_t len;
+    /*
+     * Host buffer of at least `len` bytes
+     */
+    uint8_t *buf;
+} swd_host_iovec_t;
+
+/*
+ * @brief Receives data read by a streaming transfer
+ * @param void* user context given to the transfer
+ * @param uint64_t offset of `data` from the start of the transfer
+ * @param uint8_t* chunk of read data. Only valid during the call
+ * @param uint32_t number of bytes in `data`
+ * @return Anything other than SWD_OK aborts the transfer with that error
+ */
+typedef swd_err_t (*swd_host_stream_consumer_t)(void *_Nullable ctx, uint64_t offset,
+                                                const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Supplies data for a streaming write
+ * @param void* user context given to the transfer
+ * @param uint64_t offset of `data` from the start of the transfer
+ * @param uint8_t* chunk to fill
+ * @param uint32_t number of bytes to place in `data`
+ * @return Anything other than SWD_OK aborts the transfer with that error
+ */
+typedef swd_err_t (*swd_host_stream_producer_t)(void *_Nullable ctx, uint64_t offset,
+                                                uint8_t *data, uint32_t len);
+
+/*
+ * @brief Reports the progress of a streaming transfer after every chunk
+ * @param void* user context given to the transfer
+ * @param uint64_t number of bytes transferred so far
+ * @param uint64_t total number of bytes of the transfer
+ * @return false to cancel the transfer
+ */
+typedef bool (*swd_host_stream_progress_t)(void *_Nullable ctx, uint64_t done, uint64_t total);
+
 /*
  * @brief Initialize the host structure for it to function
  * @param swd_host_t* reference of the host structure to initialize
@@ -83,6 +482,124 @@ swd_err_t swd_host_step_target(swd_host_t *host);
  */
 swd_err_t swd_host_continue_target(swd_host_t *host);
 
+/*
+ * @brief Single step the halted target and record the address of every executed instruction.
+ *          Each step costs the DHCSR step write and one pipelined PC read, breakpoints under
+ *          the PC are stepped over
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_trace_cfg_t* when to stop
+ * @param uint32_t* buffer of `cfg->max_steps` words receiving the PCs
+ * @param uint32_t* number of instructions stepped. Less than `cfg->max_steps` when the stop
+ *          range was reached
+ * @note The target is left halted on the first instruction which was not executed
+ */
+swd_err_t swd_host_trace_steps(swd_host_t *host, const swd_host_trace_cfg_t *cfg, uint32_t *pcs,
+                               uint32_t *cnt);
+
+/*
+ * @brief Same as `swd_host_trace_steps`, but the PCs are streamed to `consumer` in a compact
+ *          form: every PC is the LEB128 varint of the zigzag encoded halfword distance to the
+ *          previous PC (0 for the first one). Sequential Thumb code costs one byte per step
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_trace_cfg_t* when to stop
+ * @param swd_host_stream_consumer_t receives the encoded trace in chunks of up to
+ *          SWD_HOST_STREAM_CHUNK_BYTES
+ * @param void* context passed to the consumer. Can be NULL
+ * @param uint32_t* number of instructions stepped
+ */
+swd_err_t swd_host_trace_steps_encoded(swd_host_t *host, const swd_host_trace_cfg_t *cfg,
+                                       swd_host_stream_consumer_t consumer, void *_Nullable ctx,
+                                       uint32_t *cnt);
+
+/*
+ * @brief Single step the halted target until the PC leaves [start, end). Used to step over a
+ *          source line, the core is not checked or resumed between steps
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t first address of the range
+ * @param uint32_t address following the range
+ * @param uint32_t* number of instructions stepped. Can be NULL
+ * @return SWD_TARGET_INVALID_ADDR if the range is empty, SWD_HOST_STEP_LIMIT if the PC is still
+ *          in the range after SWD_HOST_STEP_RANGE_MAX_STEPS steps
+ */
+swd_err_t swd_host_step_range(swd_host_t *host, uint32_t start, uint32_t end,
+                              uint32_t *_Nullable steps);
+
+/*
+ * @brief Run the target until it reaches `addr`. A free FPB comparator (or a software
+ *          breakpoint in RAM) is borrowed for the duration of the call
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t address to stop at
+ * @param uint32_t number of DHCSR polls to wait for the halt
+ * @return SWD_TARGET_NOT_HALTED if the core did not halt in time, it is then halted wherever
+ *          it is. SWD_TARGET_NO_MORE_BKPT if no breakpoint can be placed at `addr`
+ * @note The core also stops at any other breakpoint on the way
+ */
+swd_err_t swd_host_run_to(swd_host_t *host, uint32_t addr, uint32_t max_polls);
+
+/*
+ * @brief Enable the DWT cycle counter (DWT_CTRL.CYCCNTENA)
+ * @param swd_host_t* reference of the host structure 
+ */
+swd_err_t swd_host_cycles_enable(swd_host_t *host);
+
+/*
+ * @brief Read the DWT cycle counter
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t* cycle count
+ * @note CYCCNT does not count while the core is halted
+ */
+swd_err_t swd_host_cycles_read(swd_host_t *host, uint32_t *cyccnt);
+
+/*
+ * @brief Time a code region with the cycle counter. Breakpoints are placed at the start and the
+ *          end once and stay armed for every iteration. CYCCNT is read at each halt and the
+ *          target is resumed until `iterations` samples were taken
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_cycles_cfg_t* region to time
+ * @param swd_host_cycle_stats_t* statistics of the iterations
+ * @return SWD_TARGET_NOT_HALTED if a breakpoint was not reached within `max_polls` polls, the
+ *          target is then halted wherever it is. SWD_ERR if the core halted elsewhere or
+ *          reached the start twice without passing the end
+ * @note The target is left halted at the end of the region. Breakpoints which did not exist
+ *          before the call are removed
+ */
+swd_err_t swd_host_cycles_measure(swd_host_t *host, const swd_host_cycles_cfg_t *cfg,
+                                  swd_host_cycle_stats_t *stats);
+
+/*
+ * @brief Start a function of the halted target. The arguments, SP, R9, LR (the trap) and PC are
+ *          staged through the register cache and the core runs with interrupts masked
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_call_t* function to call
+ * @note The host may access memory while the function runs, ex. to upload the next data block
+ * @note xPSR is staged with only the Thumb bit and the exception number of the halted core, a
+ *          core halted in Handler mode runs the function in the same mode
+ */
+swd_err_t swd_host_call_start(swd_host_t *host, const swd_host_call_t *call);
+
+/*
+ * @brief Wait for the function started by `swd_host_call_start` to return to its trap
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t trap address given to `swd_host_call_start`
+ * @param uint32_t DHCSR polls to wait for the halt
+ * @param uint32_t* value returned in R0. Can be NULL
+ * @return SWD_TARGET_NOT_HALTED if the function did not return in time, the core is then halted
+ *          wherever it is. SWD_ERR if the core locked up or halted outside of the trap
+ */
+swd_err_t swd_host_call_wait(swd_host_t *host, uint32_t trap, uint32_t max_polls,
+                             uint32_t *_Nullable ret);
+
+/*
+ * @brief Call a function of the halted target and wait for it to return
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_call_t* function to call
+ * @param uint32_t DHCSR polls to wait for the return
+ * @param uint32_t* value returned in R0. Can be NULL
+ * @note See `swd_host_call_start` and `swd_host_call_wait`
+ */
+swd_err_t swd_host_call(swd_host_t *host, const swd_host_call_t *call, uint32_t max_polls,
+                        uint32_t *_Nullable ret);
+
 /*
  * @brief Send a signal to perform a software reset
  * @param swd_host_t* reference of the host structure 
@@ -141,8 +658,9 @@ swd_err_t swd_host_memory_write_word_block(swd_host_t *host, uint32_t start_addr
  * @note Because some DAPs might not support byte transfers, transfers are done one word at a time.
  *          This means that addresses `start_addr & ~3` to `start_addr + buf) & ~3` must exist.
  */
-swd_err_t swd_host_memory_write_byte_block(swd_host_t *host, uint32_t start_addr, uint8_t *data_buf,
-                                           uint32_t bufsz, uint32_t* _Nullable w_cnt);
+swd_err_t swd_host_memory_write_byte_block(swd_host_t *host, uint32_t start_addr,
+                                           const uint8_t *data_buf, uint32_t bufsz,
+                                           uint32_t* _Nullable w_cnt);
 
 /*
  * @brief Read a single word of data
@@ -176,6 +694,189 @@ swd_err_t swd_host_memory_read_word_block(swd_host_t *host, uint32_t start_addr,
 swd_err_t swd_host_memory_read_byte_block(swd_host_t *host, uint32_t start_addr, uint8_t *data_buf,
                                           uint32_t bufsz, uint32_t* _Nullable rd_cnt);
 
+/*
+ * @brief Read the same word `cnt` times in one pipelined transfer, as used for sampling
+ *          registers and FIFOs. TAR is left pointing at `addr`, so back to back calls on the
+ *          same address only transfer data
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t word aligned address to read
+ * @param uint32_t* buffer of at least `cnt` words
+ * @param uint32_t number of reads
+ * @note The host memory cache is bypassed
+ */
+swd_err_t swd_host_memory_read_repeat(swd_host_t *host, uint32_t addr, uint32_t *data_buf,
+                                      uint32_t cnt);
+
+/*
+ * @brief Read `len` bytes starting at `start_addr`, handing them to `consumer` in chunks of
+ *          up to SWD_HOST_STREAM_CHUNK_BYTES bytes
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address
+ * @param uint64_t number of bytes to read. `start_addr + len` can not go past the end of the
+ *          address space
+ * @param swd_host_stream_consumer_t callback receiving the data
+ * @param swd_host_stream_progress_t called after each chunk. Can be NULL
+ * @param void* context passed to the callbacks. Can be NULL
+ * @param uint64_t* number of bytes handed to `consumer`. Can be NULL
+ * @return SWD_HOST_XFER_CANCELLED if `progress` cancelled the transfer
+ * @note Chunks are read into a buffer on the stack, which the next chunk overwrites. A consumer
+ *          which hands data to an asynchronous write has to copy it first
+ */
+swd_err_t swd_host_memory_read_stream(swd_host_t *host, uint32_t start_addr, uint64_t len,
+                                      swd_host_stream_consumer_t consumer,
+                                      swd_host_stream_progress_t _Nullable progress,
+                                      void *_Nullable ctx, uint64_t *_Nullable rd_cnt);
+
+/*
+ * @brief Write `len` bytes starting at `start_addr`, pulling them from `producer` in chunks of
+ *          up to SWD_HOST_STREAM_CHUNK_BYTES bytes
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address
+ * @param uint64_t number of bytes to write. `start_addr + len` can not go past the end of the
+ *          address space
+ * @param swd_host_stream_producer_t callback supplying the data
+ * @param swd_host_stream_progress_t called after each chunk. Can be NULL
+ * @param void* context passed to the callbacks. Can be NULL
+ * @param uint64_t* number of bytes written to the target. Can be NULL
+ * @return SWD_HOST_XFER_CANCELLED if `progress` cancelled the transfer
+ * @note Transfers are synchronous, `producer` runs between the writes of two chunks
+ */
+swd_err_t swd_host_memory_write_stream(swd_host_t *host, uint32_t start_addr, uint64_t len,
+                                       swd_host_stream_producer_t producer,
+                                       swd_host_stream_progress_t _Nullable progress,
+                                       void *_Nullable ctx, uint64_t *_Nullable w_cnt);
+
+/*
+ * @brief Fill `len` bytes starting at `start_addr` by repeating `pattern`
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address
+ * @param uint32_t number of bytes to fill
+ * @param uint8_t* pattern to repeat. The first pattern byte lands on `start_addr`
+ * @param uint32_t length of the pattern. Must not be 0
+ */
+swd_err_t swd_host_memory_fill(swd_host_t *host, uint32_t start_addr, uint32_t len,
+                               const uint8_t *pattern, uint32_t pattern_len);
+
+/*
+ * @brief Compare target memory against a host buffer. The comparison stops at the first chunk
+ *          holding a difference
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address
+ * @param uint8_t* expected data
+ * @param uint32_t number of bytes to compare
+ * @param bool* true if the target memory matches `expected`
+ * @param uint32_t* offset of the first differing byte when not equal. Can be NULL
+ */
+swd_err_t swd_host_memory_compare(swd_host_t *host, uint32_t start_addr, const uint8_t *expected,
+                                  uint32_t len, bool *is_equal, uint32_t *_Nullable mismatch);
+
+/*
+ * @brief Search `len` bytes of target memory starting at `start_addr` for `pattern`
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address
+ * @param uint32_t number of bytes to search
+ * @param uint8_t* pattern to look for
+ * @param uint32_t length of the pattern. At most SWD_HOST_FIND_MAX_PATTERN
+ * @param bool* true if the pattern was found
+ * @param uint32_t* target address of the first match. Can be NULL
+ * @note Memory is streamed chunk by chunk, so no more than a chunk and the pattern length is
+ *          kept on the host
+ */
+swd_err_t swd_host_memory_find(swd_host_t *host, uint32_t start_addr, uint32_t len,
+                               const uint8_t *pattern, uint32_t pattern_len, bool *found,
+                               uint32_t *_Nullable match_addr);
+
+/*
+ * @brief Read several disjoint memory ranges in one call. Segments are sorted by address and
+ *          nearby segments are merged into a single pipelined transfer, sharing one CSW setup
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_iovec_t* array of segments to fill
+ * @param uint32_t number of segments
+ * @note Gaps of up to SWD_HOST_IOV_COALESCE_GAP bytes between segments are also read. Segments
+ *          should not be placed next to registers with read side effects
+ */
+swd_err_t swd_host_memory_readv(swd_host_t *host, const swd_host_iovec_t *iov, uint32_t iovcnt);
+
+/*
+ * @brief Write several disjoint memory ranges in one call. Segments are sorted by address and
+ *          adjacent segments are merged into a single auto-incremented transfer
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_iovec_t* array of segments to write
+ * @param uint32_t number of segments
+ * @note Segments which do not start or end on a word boundary cause a read-modify-write of
+ *          the surrounding word. The order in which overlapping segments are written is unspecified
+ */
+swd_err_t swd_host_memory_writev(swd_host_t *host, const swd_host_iovec_t *iov, uint32_t iovcnt);
+
+/*
+ * @brief Note memory changed other than by the host's writes, ex. flash programmed by an
+ *          algorithm running on the target. The host memory cache drops the range and the
+ *          core's caches are maintained for it before the core runs again
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t start address
+ * @param uint32_t number of bytes
+ */
+void swd_host_memory_changed(swd_host_t *host, uint32_t start_addr, uint32_t len);
+
+/*
+ * @brief Add a region to the host's memory map
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_region_t* region to add. The data is copied
+ * @return SWD_TARGET_INVALID_ADDR if the region overlaps with an existing one and
+ *          SWD_HOST_TABLE_FULL if there is no more space
+ */
+swd_err_t swd_host_region_add(swd_host_t *host, const swd_host_region_t *region);
+
+/*
+ * @brief Remove every region from the host's memory map. Unmapped memory is accessed as
+ *          non-cacheable with word accesses
+ * @param swd_host_t* reference of the host structure 
+ */
+void swd_host_region_clear(swd_host_t *host);
+
+/*
+ * @brief Populate the memory map with the ARMv7-M default memory regions
+ * @param swd_host_t* reference of the host structure 
+ * @note This is done by `swd_host_init`
+ */
+void swd_host_region_add_defaults(swd_host_t *host);
+
+/*
+ * @brief Find the region an address belongs to
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t address to look up
+ * @return The matching region, or NULL if the address is not mapped
+ */
+const swd_host_region_t *swd_host_region_find(swd_host_t *host, uint32_t addr);
+
+/*
+ * @brief Read a word through the AP's banked data registers. TAR is only written when `addr`
+ *          is outside of the 16-byte aligned window TAR currently points to, so repeated
+ *          accesses to a register cluster (ex. DHCSR/DCRSR/DCRDR/DEMCR) need no TAR traffic
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t word aligned address to read from
+ * @param uint32_t* buffer to write to
+ * @note The sticky bits of a DHCSR read are kept for the event monitor
+ */
+swd_err_t swd_host_window_read(swd_host_t *host, uint32_t addr, uint32_t *data);
+
+/*
+ * @brief Write a word through the AP's banked data registers
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t word aligned address to write to
+ * @param uint32_t word data
+ * @note See `swd_host_window_read`
+ */
+swd_err_t swd_host_window_write(swd_host_t *host, uint32_t addr, uint32_t data);
+
+/*
+ * @brief Read all four words of a 16-byte window with one pipelined sequence
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t base address of the window. Must be 16-byte aligned
+ * @param uint32_t* buffer of 4 words to write to
+ */
+swd_err_t swd_host_window_read_all(swd_host_t *host, uint32_t base, uint32_t *data);
+
 /*
  * @brief Read data present from one of the core's registers. The core must be halted 
  *          for the transaction to complete
@@ -195,21 +896,199 @@ swd_err_t swd_host_register_read(swd_host_t *host, swd_target_register_t reg, ui
 swd_err_t swd_host_register_write(swd_host_t *host, swd_target_register_t reg, uint32_t data);
 
 /*
- * @brief Add a hardware breakpoint at the specified address
+ * @brief Set the callback of the debug event monitor
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_event_cb_t callback to dispatch events to. NULL to only track the state
+ * @param void* context passed to the callback. Can be NULL
+ */
+void swd_host_monitor_set_callback(swd_host_t *host, swd_host_event_cb_t _Nullable cb,
+                                   void *_Nullable ctx);
+
+/*
+ * @brief Run the debug event monitor. DHCSR is only read once the polling interval has elapsed,
+ *          DFSR is only read when the core halted since the previous poll
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t current time, in any tick unit which wraps around at 2^32
+ * @param uint32_t* time at which the monitor wants to be called next. Can be NULL
+ * @note The interval doubles up to SWD_HOST_MONITOR_MAX_INTERVAL while nothing happens and
+ *          drops back to SWD_HOST_MONITOR_MIN_INTERVAL on any event or host-issued resume,
+ *          so halts are seen quickly after a resume while idle targets cost little bus time
+ */
+swd_err_t swd_host_monitor_poll(swd_host_t *host, uint32_t now, uint32_t *_Nullable next);
+
+/*
+ * @brief Read a set of core registers. Registers already known since the target halted are not
+ *          read again, the rest are read back to back with one pipelined DHCSR/DCRDR read each
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_target_register_set_t registers to read
+ * @param uint32_t* array of REG_CNT words, indexed by register, receiving the values
+ * @param swd_target_register_set_t* registers actually placed in `out`. Can be NULL
+ * @note FPSCR and S0-S31 are skipped when the target has no FPU or CONTROL.FPCA shows that no
+ *          floating-point context is active
+ * @note Staged values are returned for registers which have not been committed yet
+ */
+swd_err_t swd_host_registers_fetch(swd_host_t *host, swd_target_register_set_t set,
+                                   uint32_t *out, swd_target_register_set_t *_Nullable fetched);
+
+/*
+ * @brief Stage a new register value. It is only written to the target by
+ *          `swd_host_registers_commit`
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_target_register_t register to write
+ * @param uint32_t value to write
+ * @note Staging SP, MSP, PSP or CFBP drops what is known about the other stack pointers, as
+ *          they alias each other
+ */
+swd_err_t swd_host_registers_stage(swd_host_t *host, swd_target_register_t reg, uint32_t data);
+
+/*
+ * @brief Write every staged register to the target
+ * @param swd_host_t* reference of the host structure 
+ * @note Called by `swd_host_step_target` and `swd_host_continue_target` before the core runs
+ */
+swd_err_t swd_host_registers_commit(swd_host_t *host);
+
+/*
+ * @brief Add a breakpoint at the specified address. Once the hardware comparators are used up,
+ *          or the FPB can not reach the address, RAM addresses get a software breakpoint
  * @param swd_host_t* reference of the host structure 
  * @param uint32_t address of breakpoint
  */
 swd_err_t swd_host_add_breakpoint(swd_host_t *host, uint32_t addr);
 
 /*
- * @brief Delete a hardware breakpoint at the specified address
+ * @brief Delete a hardware or software breakpoint at the specified address
  * @param swd_host_t* reference of the host structure 
  * @param uint32_t address of breakpoint
  */
 swd_err_t swd_host_remove_breakpoint(swd_host_t *host, uint32_t addr);
 
 /*
- * @brief Zero out the entire hardware breakpoint address range
+ * @brief Replace every breakpoint with `addrs`. The comparators are updated with a single
+ *          auto-increment block write covering only the ones which change. Addresses which do
+ *          not fit in the comparators become software breakpoints
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t* breakpoint addresses. Duplicates share a comparator
+ * @param uint32_t number of addresses
+ * @return SWD_TARGET_NO_MORE_BKPT if an address fits neither a comparator nor a software
+ *          breakpoint. The breakpoints are left untouched in that case
+ */
+swd_err_t swd_host_set_breakpoints(swd_host_t *host, const uint32_t *addrs, uint32_t cnt);
+
+/*
+ * @brief Add software breakpoints by patching a BKPT instruction over the halfword at each
+ *          address. The original halfwords are read with one `swd_host_memory_readv` and the
+ *          BKPTs are written with one `swd_host_memory_writev` per batch
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t* halfword aligned addresses in RAM regions. Existing ones are skipped
+ * @param uint32_t number of addresses
+ * @note Stepping or continuing from a software breakpoint transparently restores the
+ *          original instruction for one step
+ * @note Code copied into RAM again (ex. by a reset) overwrites the BKPTs, remove the
+ *          breakpoints before that happens
+ */
+swd_err_t swd_host_add_sw_breakpoints(swd_host_t *host, const uint32_t *addrs, uint32_t cnt);
+
+/*
+ * @brief Remove software breakpoints, restoring the original halfwords in batched writes
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t* addresses of the breakpoints. Unknown addresses are skipped
+ * @param uint32_t number of addresses
+ */
+swd_err_t swd_host_remove_sw_breakpoints(swd_host_t *host, const uint32_t *addrs,
+                                         uint32_t cnt);
+
+/*
+ * @brief Set where the FPB remap table lives and point FP_REMAP at it
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t 32-byte aligned SRAM address with room for one word per comparator. The
+ *          firmware must not use this memory
+ * @return SWD_TARGET_NOT_SUPPORTED if the FPB can not remap (FPB v2 or RMPSPT clear)
+ * @note Existing patches are moved to the new table
+ */
+swd_err_t swd_host_patch_set_table(swd_host_t *host, uint32_t table_addr);
+
+/*
+ * @brief Patch a halfword or word of flash without reprogramming it. The replacement word is
+ *          placed in the remap table and a comparator redirects accesses of the word to it
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t address to patch, in the code region and aligned to `size`
+ * @param uint32_t replacement data
+ * @param uint8_t 2 or 4 bytes. The other half of a halfword patch keeps its flash contents
+ * @param swd_host_patch_kind_t whether instructions or literal data are patched
+ * @return SWD_TARGET_NO_MORE_BKPT if no comparator of the required kind is free
+ * @note swd_host_patch_set_table must have been called. Patching the same word again updates
+ *          the existing patch
+ */
+swd_err_t swd_host_patch_add(swd_host_t *host, uint32_t addr, uint32_t data, uint8_t size,
+                             swd_host_patch_kind_t kind);
+
+/*
+ * @brief Remove the patch covering `addr`
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t patched address
+ * @param swd_host_patch_kind_t kind of the patch
+ */
+swd_err_t swd_host_patch_remove(swd_host_t *host, uint32_t addr, swd_host_patch_kind_t kind);
+
+/*
+ * @brief List the active patches
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_patch_t* buffer receiving the patches
+ * @param uint32_t array size of the buffer
+ * @param uint32_t* number of patches written to the buffer
+ */
+swd_err_t swd_host_patch_list(swd_host_t *host, swd_host_patch_t *buf, uint32_t bufsz,
+                              uint32_t *cnt);
+
+/*
+ * @brief Write the remap table, FP_REMAP and the comparators again. Use after a reset or power
+ *          cycle cleared the SRAM table or the FPB
+ * @param swd_host_t* reference of the host structure 
+ */
+swd_err_t swd_host_patch_reapply(swd_host_t *host);
+
+/*
+ * @brief Set a DWT data watchpoint
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_watchpoint_t* watchpoint description. `cmp` is ignored
+ * @param uint8_t* comparator reported in the halt reason when the watchpoint fires. Can be NULL
+ * @return SWD_TARGET_NO_MORE_BKPT if no suitable comparator is free, SWD_TARGET_NOT_SUPPORTED
+ *          if the size or value match can not be done by this DWT
+ * @note A halt caused by a watchpoint is reported by the event monitor with
+ *          SWD_HALT_REASON_WATCH and SWD_HALT_REASON_WATCH_CMP(cmp)
+ */
+swd_err_t swd_host_add_watchpoint(swd_host_t *host, const swd_host_watchpoint_t *wp,
+                                  uint8_t *_Nullable cmp);
+
+/*
+ * @brief Remove the watchpoint set on `addr` for `kind` accesses
+ * @param swd_host_t* reference of the host structure 
+ * @param uint32_t watched address
+ * @param swd_host_watch_kind_t watched accesses
+ */
+swd_err_t swd_host_remove_watchpoint(swd_host_t *host, uint32_t addr,
+                                     swd_host_watch_kind_t kind);
+
+/*
+ * @brief Disable every DWT comparator used by a watchpoint
+ * @param swd_host_t* reference of the host structure 
+ */
+swd_err_t swd_host_clear_watchpoints(swd_host_t *host);
+
+/*
+ * @brief List the active watchpoints, from the host's shadow of the DWT
+ * @param swd_host_t* reference of the host structure 
+ * @param swd_host_watchpoint_t* buffer receiving the watchpoints
+ * @param uint32_t array size of the buffer
+ * @param uint32_t* number of watchpoints written to the buffer
+ */
+swd_err_t swd_host_get_watchpoints(swd_host_t *host, swd_host_watchpoint_t *buf, uint32_t bufsz,
+                                   uint32_t *cnt);
+
+/*
+ * @brief Zero out the entire hardware breakpoint address range and remove every software
+ *          breakpoint. Comparators used by flash patches are kept
  * @param swd_host_t* reference of the host structure 
  */
 swd_err_t swd_host_clear_breakpoints(swd_host_t *host);
@@ -222,7 +1101,7 @@ swd_err_t swd_host_clear_breakpoints(swd_host_t *host);
 swd_err_t swd_host_get_breakpoint_count(swd_host_t *host, uint32_t *bkpt_cnt);
 
 /*
- * @brief Read out all enabled hardware breakpoints
+ * @brief Read out all enabled hardware breakpoints followed by the software breakpoints
  * @param swd_host_t* reference of the host structure 
  * @param uint32_t* reference of read buffer
  * @param uint32_t array size of read buffer
@@ -0,0 +1,191 @@
+
+#ifndef __SWD_IMAGE_H
+#define __SWD_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+typedef enum _swd_image_format_t {
+    /*
+     * Raw bytes loaded at a given address
+     */
+    SWD_IMAGE_BIN = 0,
+    /*
+     * 32-bit little endian ELF, the PT_LOAD segments are loaded at their physical address
+     */
+    SWD_IMAGE_ELF,
+    /*
+     * Intel HEX text. Data records have to be in ascending address order, as written by
+     *  objcopy and most other tools
+     */
+    SWD_IMAGE_HEX,
+} swd_image_format_t;
+
+/*
+ * @brief Receives the image in blocks of ascending, merged address ranges. Gaps within a
+ *          chunk are filled with SWD_IMAGE_GAP_FILL, so a block only ends off a multiple of
+ *          SWD_IMAGE_CHUNK_BYTES where the image has a gap reaching into the next chunk
+ * @param void* context given to `swd_image_load`
+ * @param uint32_t target address of the block
+ * @param uint8_t* data of the block. Points into the image when it can be used as is
+ * @param uint32_t number of bytes
+ * @return Anything other than SWD_OK aborts the load with that error
+ */
+typedef swd_err_t (*swd_image_sink_t)(void *_Nullable ctx, uint32_t addr, const uint8_t *data,
+                                      uint32_t len);
+
+/*
+ * @brief Time source of the throughput statistics
+ * @param void* context given to `swd_image_load`
+ * @return current time in microseconds, wrapping around at 2^32
+ */
+typedef uint32_t (*swd_image_clock_t)(void *_Nullable ctx);
+
+/*
+ * @brief Image held in host memory, parsed in place
+ */
+typedef struct _swd_image_t {
+    const uint8_t *data;
+    size_t size;
+    swd_image_format_t format;
+    /*
+     * Load address of a binary image
+     */
+    uint32_t bin_base;
+    /*
+     * Entry point given by the ELF header or the HEX start address record
+     */
+    uint32_t entry;
+    bool has_entry;
+    /*
+     * Whether `data` was mapped by `swd_image_map`
+     */
+    bool _mapped;
+} swd_image_t;
+
+typedef struct _swd_image_stats_t {
+    /*
+     * Bytes handed to the sink
+     */
+    uint64_t bytes;
+    /*
+     * Contiguous address ranges after merging
+     */
+    uint32_t ranges;
+    /*
+     * Load time in microseconds and bytes per second, 0 without a clock
+     */
+    uint32_t elapsed_us;
+    uint32_t rate;
+} swd_image_stats_t;
+
+/*
+ * @brief Detect the format of an image in host memory and check its headers. Nothing is copied,
+ *          the memory has to stay valid while the image is used
+ * @param swd_image_t* reference of the image structure to initialize
+ * @param uint8_t* image file content, ex. a memory mapped file
+ * @param size_t size of the content
+ * @param uint32_t load address used if the content is neither ELF nor Intel HEX
+ * @return SWD_IMAGE_INVALID if the ELF headers are inconsistent
+ */
+swd_err_t swd_image_open(swd_image_t *img, const uint8_t *data, size_t size, uint32_t bin_base);
+
+#ifdef SWD_IMAGE_ENABLE_MMAP
+/*
+ * @brief Map a file read-only and open it as an image. Pages are only read from the file when
+ *          the loader reaches them, so the image may be larger than the host's RAM
+ * @param swd_image_t* reference of the image structure to initialize
+ * @param char* path of the file
+ * @param uint32_t load address used if the file is neither ELF nor Intel HEX
+ */
+swd_err_t swd_image_map(swd_image_t *img, const char *path, uint32_t bin_base);
+
+/*
+ * @brief Unmap an image opened by `swd_image_map`
+ * @param swd_image_t* reference of the image structure
+ */
+void swd_image_unmap(swd_image_t *img);
+#endif // SWD_IMAGE_ENABLE_MMAP
+
+/*
+ * @brief Hand the loadable content of the image to `sink` in ascending address order. ELF
+ *          segments are sorted by address. HEX records are taken in file order, which has to be
+ *          ascending. Adjacent or chunk sharing segments and records are merged, so a flash sink
+ *          never sees a page twice
+ * @param swd_image_t* reference of the opened image
+ * @param swd_image_sink_t receives the blocks, ex. `swd_image_sink_ram` or `swd_image_sink_flash`
+ * @param void* context passed to the sink. Can be NULL
+ * @param swd_image_clock_t time source of the throughput. Can be NULL
+ * @param void* context passed to the clock. Can be NULL
+ * @param swd_image_stats_t* load statistics. Can be NULL
+ * @return SWD_IMAGE_INVALID on a malformed HEX record, overlapping ELF segments or HEX records
+ *          out of ascending order
+ */
+swd_err_t swd_image_load(const swd_image_t *img, swd_image_sink_t sink, void *_Nullable ctx,
+                         swd_image_clock_t _Nullable clock, void *_Nullable clock_ctx,
+                         swd_image_stats_t *_Nullable stats);
+
+/*
+ * @brief Copy initialized content of an ELF image by link address, ex. constant tables the
+ *          firmware points to
+ * @param swd_image_t* reference of the opened ELF image
+ * @param uint32_t virtual address of the content
+ * @param uint8_t* buffer receiving the content
+ * @param uint32_t number of bytes
+ * @return SWD_TARGET_INVALID_ADDR if the range is not file content of a single loadable segment
+ */
+swd_err_t swd_image_elf_read(const swd_image_t *img, uint32_t addr, uint8_t *buf, uint32_t len);
+
+/*
+ * @brief Find a section of an ELF image by name
+ * @param swd_image_t* reference of the opened ELF image
+ * @param char* section name, ex. ".gcov_info"
+ * @param bool* true if the section exists
+ * @param uint32_t* its address. Can be NULL
+ * @param uint32_t* its size. Can be NULL
+ * @return SWD_TARGET_NOT_SUPPORTED if the image is not an ELF image
+ */
+swd_err_t swd_image_elf_section(const swd_image_t *img, const char *name, bool *found,
+                                uint32_t *_Nullable addr, uint32_t *_Nullable size);
+
+/*
+ * @brief Find a symbol of an ELF image by name
+ * @param swd_image_t* reference of the opened ELF image
+ * @param char* symbol name
+ * @param bool* true if the symbol exists
+ * @param uint32_t* its value. Can be NULL
+ * @return SWD_TARGET_NOT_SUPPORTED if the image is not an ELF image
+ */
+swd_err_t swd_image_elf_symbol(const swd_image_t *img, const char *name, bool *found,
+                               uint32_t *_Nullable value);
+
+/*
+ * @brief Sink writing target RAM with pipelined block writes
+ * @param void* the `swd_host_t*` of the target
+ */
+swd_err_t swd_image_sink_ram(void *_Nullable ctx, uint32_t addr, const uint8_t *data,
+                             uint32_t len);
+
+/*
+ * @brief Sink programming erased flash through a loaded flash algorithm
+ * @param void* the `swd_flash_t*` of the flash
+ */
+swd_err_t swd_image_sink_flash(void *_Nullable ctx, uint32_t addr, const uint8_t *data,
+                               uint32_t len);
+
+/*
+ * @brief Start an image loaded into RAM: VTOR is pointed at its vector table, MSP and PC are
+ *          taken from the table's first two entries and the target is resumed
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param uint32_t address of the vector table, 128 byte aligned
+ * @return SWD_TARGET_NOT_SUPPORTED if the core is halted in Handler mode, the image starts in
+ *          Thread mode so the target has to be reset first, ex. halted out of reset
+ */
+swd_err_t swd_image_run(swd_host_t *host, uint32_t vector_table);
+
+#endif // __SWD_IMAGE_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+
+#ifndef __SWD_MEMTEST_H
+#define __SWD_MEMTEST_H
+
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/* Smallest scratch SRAM which lets `swd_memtest_run` run the march elements on the target */
+#define SWD_MEMTEST_SCRATCH_SIZE (112)
+
+typedef enum _swd_memtest_algo_t {
+    /*
+     * March C-: up(w0) up(r0,w1) up(r1,w0) down(r0,w1) down(r1,w0) up(r0), with all-zero and
+     *  all-one words. Finds stuck-at, transition and most coupling faults
+     */
+    SWD_MEMTEST_MARCH_C_MINUS = 0,
+    /*
+     * Every word holds a walking one, then a walking zero, through all 32 bit positions. Finds
+     *  shorted and stuck data lines
+     */
+    SWD_MEMTEST_WALKING,
+    /*
+     * Every word holds its own address, then its inverse. Finds shorted and stuck address lines
+     */
+    SWD_MEMTEST_ADDRESS,
+} swd_memtest_algo_t;
+
+typedef struct _swd_memtest_fail_t {
+    uint32_t addr;
+    uint32_t expected;
+    /*
+     * Value read, the failing bits are `expected ^ actual`
+     */
+    uint32_t actual;
+} swd_memtest_fail_t;
+
+typedef struct _swd_memtest_report_t {
+    /*
+     * Caller supplied log of the first `fails_size` failing reads. Can be NULL
+     */
+    swd_memtest_fail_t *_Nullable fails;
+    uint32_t fails_size;
+    /*
+     * Failing reads, including those which did not fit in the log
+     */
+    uint32_t fail_cnt;
+    /*
+     * Every bit which failed at least once
+     */
+    uint32_t fail_mask;
+    /*
+     * March elements run, each being one pass over the memory
+     */
+    uint32_t elements;
+} swd_memtest_report_t;
+
+/*
+ * @brief Test target memory with a march algorithm. The patterns are generated while they are
+ *          transferred. On the host every element reads a block of SWD_MEMTEST_BLOCK_BYTES
+ *          with a pipelined read, checks it and writes the block's next value before the next
+ *          block, so a descending element walks the blocks downwards but each block upwards.
+ *          Within a block all reads come before all writes instead of a read and a write per
+ *          word, so on the host March C- only guarantees the detection of stuck-at, transition
+ *          and address decoder faults. Coupling faults need the elements to run on the target
+ * @param swd_host_t* reference of the host structure of the halted target
+ * @param uint32_t word aligned start of the memory to test
+ * @param uint32_t number of bytes, a multiple of 4
+ * @param swd_memtest_algo_t algorithm to run
+ * @param uint32_t start of SRAM outside of the tested memory whose content may be lost, word
+ *          aligned. The elements run word by word on the target with a routine copied there
+ * @param uint32_t size of that SRAM. Below SWD_MEMTEST_SCRATCH_SIZE, ex. 0, the elements are
+ *          run from the host
+ * @param swd_memtest_report_t* receives the failures, `fails` and `fails_size` are set by the
+ *          caller
+ * @return SWD_OK when the test ran, whether or not the memory passed
+ * @note The memory content is lost. On the target the core registers are lost as well
+ */
+swd_err_t swd_memtest_run(swd_host_t *host, uint32_t addr, uint32_t len, swd_memtest_algo_t algo,
+                          uint32_t scratch, uint32_t scratch_size, swd_memtest_report_t *report);
+
+#endif // __SWD_MEMTEST_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+
+#ifndef __SWD_PROFILE_H
+#define __SWD_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+/*
+ * @brief Time source of the profiler
+ * @param void* context given to `swd_profile_init`
+ * @return current time in microseconds, wrapping around at 2^32
+ */
+typedef uint32_t (*swd_profile_clock_t)(void *_Nullable ctx);
+
+/*
+ * @brief Optional symbolizer used by the collapsed export
+ * @param void* context given to `swd_profile_export_collapsed`
+ * @param uint32_t sampled PC
+ * @return name of the function holding the PC, NULL to print the PC itself
+ */
+typedef const char *_Nullable (*swd_profile_symbolize_t)(void *_Nullable ctx, uint32_t pc);
+
+/*
+ * @brief Number of samples taken at a PC
+ */
+typedef struct _swd_profile_bucket_t {
+    uint32_t pc;
+    uint32_t hits;
+} swd_profile_bucket_t;
+
+/*
+ * @brief Profiler counters
+ */
+typedef struct _swd_profile_stats_t {
+    /*
+     * Samples placed in the histogram
+     */
+    uint64_t samples;
+    /*
+     * Samples taken while the core was halted
+     */
+    uint64_t halted;
+    /*
+     * Samples of new PCs lost because the histogram was full
+     */
+    uint64_t dropped;
+    /*
+     * Achieved samples per second, 0 without a clock
+     */
+    uint32_t rate;
+    /*
+     * Share of the sampling time the core was stopped by the profiler, in parts per million.
+     *  Always 0 when sampling DWT_PCSR
+     */
+    uint32_t overhead_ppm;
+    /*
+     * Whether DWT_PCSR is sampled or the core is halted for each sample
+     */
+    bool uses_pcsr;
+} swd_profile_stats_t;
+
+typedef struct _swd_profile_t {
+    /*
+     * @brief Host of the profiled target
+     */
+    swd_host_t *host;
+    /*
+     * @brief Histogram, open addressing keyed by PC. A bucket is empty when it has no hits
+     */
+    swd_profile_bucket_t _buckets[SWD_PROFILE_BUCKETS];
+    uint32_t _used;
+    uint64_t _samples;
+    uint64_t _halted;
+    uint64_t _dropped;
+    /*
+     * Time spent sampling and time the core was held halted, in microseconds
+     */
+    uint64_t _elapsed_us;
+    uint64_t _stopped_us;
+    swd_profile_clock_t _clock;
+    void *_clock_ctx;
+    bool _use_pcsr;
+} swd_profile_t;
+
+/*
+ * @brief Initialize the profiler and find out if the core implements DWT_PCSR
+ * @param swd_profile_t* reference of the profiler structure to initialize
+ * @param swd_host_t* started host of a running target
+ * @param swd_profile_clock_t time source for the rate and overhead statistics. Can be NULL
+ * @param void* context passed to the clock. Can be NULL
+ * @note Without DWT_PCSR every sample halts the core, reads the PC and resumes it
+ */
+swd_err_t swd_profile_init(swd_profile_t *prof, swd_host_t *host,
+                           swd_profile_clock_t _Nullable clock, void *_Nullable clock_ctx);
+
+/*
+ * @brief Forget every sample
+ * @param swd_profile_t* reference of the profiler structure
+ */
+void swd_profile_reset(swd_profile_t *prof);
+
+/*
+ * @brief Take `cnt` PC samples of the running target. DWT_PCSR is read in pipelined batches of
+ *          SWD_PROFILE_BATCH reads through a fixed TAR, so the sample rate is bound by the wire
+ * @param swd_profile_t* reference of the profiler structure
+ * @param uint32_t number of samples
+ */
+swd_err_t swd_profile_sample(swd_profile_t *prof, uint32_t cnt);
+
+/*
+ * @brief Get the profiler counters
+ * @param swd_profile_t* reference of the profiler structure
+ * @param swd_profile_stats_t* counters
+ */
+void swd_profile_stats(const swd_profile_t *prof, swd_profile_stats_t *stats);
+
+/*
+ * @brief Get the most sampled PCs, hottest first
+ * @param swd_profile_t* reference of the profiler structure
+ * @param swd_profile_bucket_t* buffer receiving the hot spots
+ * @param uint32_t array size of the buffer
+ * @param uint32_t* number of hot spots written to the buffer
+ */
+void swd_profile_hotspots(const swd_profile_t *prof, swd_profile_bucket_t *buf, uint32_t bufsz,
+                          uint32_t *cnt);
+
+/*
+ * @brief Export the histogram in the collapsed stack format read by flame graph tools, one
+ *          "<frame> <count>" line per sampled PC. The frame is the symbolizer's name followed by
+ *          the PC, or only the PC
+ * @param swd_profile_t* reference of the profiler structure
+ * @param swd_profile_symbolize_t maps PCs to function names. Can be NULL
+ * @param void* context passed to the symbolizer. Can be NULL
+ * @param swd_host_stream_consumer_t receives the text in chunks of up to
+ *          SWD_HOST_STREAM_CHUNK_BYTES
+ * @param void* context passed to the consumer. Can be NULL
+ */
+swd_err_t swd_profile_export_collapsed(const swd_profile_t *prof,
+                                       swd_profile_symbolize_t _Nullable symbolize,
+                                       void *_Nullable sym_ctx,
+                                       swd_host_stream_consumer_t consumer,
+                                       void *_Nullable ctx);
+
+#endif // __SWD_PROFILE_H
\ No newline at end of file
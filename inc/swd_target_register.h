@@ -3,6 +3,7 @@
 #define __SWD_TARGET_REGISTER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define DCRSR_REGSEL_ERR ((uint32_t)(-1))
 
@@ -74,8 +75,23 @@ typedef enum _swd_target_register_t {
     REG_S29,
     REG_S30,
     REG_S31,
+
+    // Number of registers, not a register itself
+    REG_CNT,
 } swd_target_register_t;
 
+/*
+ * Set of registers where bit `n` selects register `n`
+ */
+typedef uint64_t swd_target_register_set_t;
+
+#define SWD_REG_SET(reg) ((swd_target_register_set_t)1 << (reg))
+// R0-R12, SP, LR, PC, XPSR, MSP, PSP and CFBP
+#define SWD_REG_SET_CORE (SWD_REG_SET(REG_FPSCR) - 1)
+// FPSCR and S0-S31
+#define SWD_REG_SET_FP (SWD_REG_SET(REG_CNT) - SWD_REG_SET(REG_FPSCR))
+#define SWD_REG_SET_ALL (SWD_REG_SET(REG_CNT) - 1)
+
 /*
  * @brief Converts a swd_target_register_t register into the required REGSEL bits
  * to be provided to DCRSR. In addition to the REGSEL bits, the  REG_RW bit is set
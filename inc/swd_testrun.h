@@ -0,0 +1,116 @@
+
+#ifndef __SWD_TESTRUN_H
+#define __SWD_TESTRUN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_conf.h"
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_image.h"
+
+/* Symbol of the mailbox in the firmware test binary */
+#define SWD_TESTRUN_MAILBOX_SYMBOL "swd_test_mailbox"
+
+/* "SWDT" in little endian, set by the firmware once it waits for the doorbell */
+#define SWD_TESTRUN_MAGIC ((uint32_t)0x54445753)
+
+/*
+ * Mailbox layout, word aligned:
+ *  magic       SWD_TESTRUN_MAGIC, written by the firmware when it is ready
+ *  test id     written by the host
+ *  doorbell    written by the host after the test id, a new non-zero 16-bit sequence number
+ *              for each test
+ *  status      written by the firmware last, the doorbell's sequence number in the upper half
+ *              and the number of record bytes in the lower half
+ *  result      written by the firmware, 0 when the test passed
+ *  records     written by the firmware, free form result records
+ */
+#define SWD_TESTRUN_MAGIC_OFFSET (0x00)
+#define SWD_TESTRUN_TEST_ID_OFFSET (0x04)
+#define SWD_TESTRUN_DOORBELL_OFFSET (0x08)
+#define SWD_TESTRUN_STATUS_OFFSET (0x0C)
+#define SWD_TESTRUN_RESULT_OFFSET (0x10)
+#define SWD_TESTRUN_RECORDS_OFFSET (0x14)
+
+typedef enum _swd_testrun_done_t {
+    /*
+     * The firmware writes the status word and goes back to waiting for the doorbell. The host
+     *  polls the status word with repeated reads, which only transfer data
+     */
+    SWD_TESTRUN_DONE_STATUS = 0,
+    /*
+     * The firmware writes the status word and executes a BKPT, the host polls DHCSR. The host
+     *  steps over the BKPT when it starts the next test
+     */
+    SWD_TESTRUN_DONE_BKPT,
+} swd_testrun_done_t;
+
+typedef struct _swd_testrun_t {
+    swd_host_t *host;
+    /*
+     * Address of the mailbox
+     */
+    uint32_t mailbox;
+    swd_testrun_done_t done;
+    /*
+     * Reads of the status word, or of DHCSR, to wait for a test
+     */
+    uint32_t max_polls;
+    uint16_t _seq;
+    /*
+     * Whether the target halted on the BKPT of the previous test
+     */
+    bool _at_bkpt;
+} swd_testrun_t;
+
+typedef struct _swd_testrun_result_t {
+    /*
+     * Caller supplied buffer receiving the records. Can be NULL
+     */
+    uint8_t *_Nullable records;
+    uint32_t records_size;
+    /*
+     * Result word of the firmware, 0 when the test passed
+     */
+    uint32_t result;
+    /*
+     * Record bytes written by the firmware, only the first `records_size` are copied
+     */
+    uint32_t records_len;
+    /*
+     * Reads spent waiting for the test
+     */
+    uint32_t polls;
+} swd_testrun_result_t;
+
+/*
+ * @brief Find the mailbox of a firmware test binary and wait for the firmware to be ready. The
+ *          target is left running
+ * @param swd_testrun_t* reference of the runner structure to initialize
+ * @param swd_host_t* reference of the host structure
+ * @param swd_image_t* ELF image of the firmware test binary
+ * @param swd_testrun_done_t how the firmware signals that a test is done
+ * @param uint32_t reads of the status word, or of DHCSR, to wait for a test, ex.
+ *          SWD_TESTRUN_MAX_POLLS
+ * @return SWD_TARGET_NOT_SUPPORTED if the image has no SWD_TESTRUN_MAILBOX_SYMBOL,
+ *          SWD_TARGET_NOT_HALTED if the firmware did not get ready within `max_polls` reads
+ */
+swd_err_t swd_testrun_open(swd_testrun_t *run, swd_host_t *host, const swd_image_t *elf,
+                           swd_testrun_done_t done, uint32_t max_polls);
+
+/*
+ * @brief Run one test: write the test id and the doorbell, let the target run, wait for the
+ *          status word and read the result and the records with one block read
+ * @param swd_testrun_t* reference of the runner structure
+ * @param uint32_t id of the test, meaning is left to the firmware
+ * @param swd_testrun_result_t* receives the outcome, `records` and `records_size` are set by
+ *          the caller
+ * @return SWD_OK when the test completed, whether or not it passed. SWD_TARGET_NOT_HALTED if it
+ *          did not complete within `max_polls` reads, SWD_ERR if the core halted or locked up
+ *          elsewhere, ex. on a fault. The target is then left halted
+ */
+swd_err_t swd_testrun_run(swd_testrun_t *run, uint32_t test_id, swd_testrun_result_t *result);
+
+#endif // __SWD_TESTRUN_H
\ No newline at end of file
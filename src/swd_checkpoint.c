@@ -0,0 +1,404 @@
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "swd_checkpoint.h"
+#include "swd_crc.h"
+#include "swd_crc_target.h"
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_log.h"
+#include "swd_target_register.h"
+
+// Header of the stored form
+#define CP_HDR_MAGIC (0)
+#define CP_HDR_VERSION (4)
+#define CP_HDR_TOTAL (8)
+#define CP_HDR_CRC (12)
+#define CP_HDR_PAGE_SIZE (16) // CRC covered from here on
+#define CP_HDR_REGION_CNT (20)
+#define CP_HDR_REG_CNT (24)
+#define CP_HDR_REG_SET (32)
+#define CP_HDR_SIZE (40)
+
+// Region entry: start, length, first page. Page entry: CRC32, content offset or fill value
+#define CP_REGION_ENTRY (12)
+#define CP_PAGE_ENTRY (8)
+
+// Pages hashed before the dirty ones are written back, one bit each
+#define CP_BATCH_PAGES (32)
+
+typedef struct _swd_checkpoint_hash_ctx_t {
+    const swd_checkpoint_t *cp;
+    uint32_t page_size;
+    uint32_t len;
+    uint32_t first_page;
+    uint32_t crc;
+    uint32_t dirty;
+} _swd_checkpoint_hash_ctx_t;
+
+void _swd_checkpoint_put32(uint8_t *p, uint32_t v);
+uint32_t _swd_checkpoint_get32(const uint8_t *p);
+
+/*
+ * @brief Offset of the page table within the stored form
+ */
+uint32_t _swd_checkpoint_table(const swd_checkpoint_t *cp);
+
+/*
+ * @brief Whether every byte of `data` has the value of the first one
+ */
+bool _swd_checkpoint_is_fill(const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Hash a streamed batch of pages and flag those differing from the checkpoint
+ */
+swd_err_t _swd_checkpoint_hash_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                       uint32_t len);
+
+/*
+ * @brief Write the checkpoint content of page `page` to `addr`
+ */
+swd_err_t _swd_checkpoint_write_page(const swd_checkpoint_t *cp, swd_host_t *host,
+                                     uint32_t page, uint32_t addr, uint32_t len);
+
+swd_err_t swd_checkpoint_capture(swd_checkpoint_t *cp, swd_host_t *host,
+                                 const swd_checkpoint_region_t *regions, uint32_t cnt,
+                                 uint8_t *buf, uint32_t bufsz) {
+    SWD_ASSERT(cp != NULL);
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(regions != NULL || cnt == 0);
+    SWD_ASSERT(buf != NULL);
+
+    cp->data = buf;
+    cp->size = 0;
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    uint64_t pages = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        if ((uint64_t)regions[i].start + regions[i].len > (uint64_t)UINT32_MAX + 1) {
+            return SWD_TARGET_INVALID_ADDR;
+        }
+        pages += (regions[i].len + (uint64_t)SWD_CHECKPOINT_PAGE_SIZE - 1) /
+                 SWD_CHECKPOINT_PAGE_SIZE;
+    }
+
+    uint64_t table = CP_HDR_SIZE + 4 * REG_CNT + (uint64_t)CP_REGION_ENTRY * cnt;
+    uint64_t offset = table + CP_PAGE_ENTRY * pages;
+    if (offset > bufsz) {
+        SWD_LOGE("Checkpoint tables need more than %" PRIu32 " bytes", bufsz);
+        return SWD_HOST_TABLE_FULL;
+    }
+
+    uint32_t regs[REG_CNT];
+    swd_target_register_set_t fetched;
+    err = swd_host_registers_fetch(host, SWD_REG_SET_ALL, regs, &fetched);
+    SWD_RETURN_IF_NON_OK(err);
+
+    memset(buf, 0, (size_t)table);
+    _swd_checkpoint_put32(&buf[CP_HDR_MAGIC], SWD_CHECKPOINT_MAGIC);
+    _swd_checkpoint_put32(&buf[CP_HDR_VERSION], SWD_CHECKPOINT_VERSION);
+    _swd_checkpoint_put32(&buf[CP_HDR_PAGE_SIZE], SWD_CHECKPOINT_PAGE_SIZE);
+    _swd_checkpoint_put32(&buf[CP_HDR_REGION_CNT], cnt);
+    _swd_checkpoint_put32(&buf[CP_HDR_REG_CNT], REG_CNT);
+    _swd_checkpoint_put32(&buf[CP_HDR_REG_SET], (uint32_t)fetched);
+    _swd_checkpoint_put32(&buf[CP_HDR_REG_SET + 4], (uint32_t)(fetched >> 32));
+    for (uint32_t reg = 0; reg < REG_CNT; reg++) {
+        if (fetched & SWD_REG_SET(reg)) {
+            _swd_checkpoint_put32(&buf[CP_HDR_SIZE + 4 * reg], regs[reg]);
+        }
+    }
+
+    uint32_t page = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        uint8_t *entry = &buf[CP_HDR_SIZE + 4 * REG_CNT + CP_REGION_ENTRY * i];
+        _swd_checkpoint_put32(&entry[0], regions[i].start);
+        _swd_checkpoint_put32(&entry[4], regions[i].len);
+        _swd_checkpoint_put32(&entry[8], page);
+
+        for (uint32_t pos = 0; pos < regions[i].len; page++) {
+            uint32_t n = regions[i].len - pos;
+            n = (n < SWD_CHECKPOINT_PAGE_SIZE) ? n : SWD_CHECKPOINT_PAGE_SIZE;
+            if (offset + n > bufsz) {
+                SWD_LOGE("Checkpoint needs more than %" PRIu32 " bytes", bufsz);
+                return SWD_HOST_TABLE_FULL;
+            }
+
+            // Read in place, a single valued page is dropped again
+            uint8_t *content = &buf[offset];
+            err = swd_host_memory_read_byte_block(host, regions[i].start + pos, content, n,
+                                                  NULL);
+            SWD_RETURN_IF_NON_OK(err);
+
+            uint8_t *page_entry = &buf[table + CP_PAGE_ENTRY * page];
+            _swd_checkpoint_put32(&page_entry[0], swd_crc32_update(0, content, n));
+            if (_swd_checkpoint_is_fill(content, n)) {
+                _swd_checkpoint_put32(&page_entry[4], SWD_CHECKPOINT_PAGE_FILL | content[0]);
+            } else {
+                _swd_checkpoint_put32(&page_entry[4], (uint32_t)offset);
+                offset += n;
+            }
+            pos += n;
+        }
+    }
+
+    cp->size = (uint32_t)offset;
+    _swd_checkpoint_put32(&buf[CP_HDR_TOTAL], cp->size);
+    uint32_t crc = swd_crc32_update(0, &buf[CP_HDR_PAGE_SIZE], cp->size - CP_HDR_PAGE_SIZE);
+    _swd_checkpoint_put32(&buf[CP_HDR_CRC], crc);
+
+    SWD_LOGI("Checkpoint of %" PRIu32 " pages in %" PRIu32 " bytes", page, cp->size);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_checkpoint_open(swd_checkpoint_t *cp, uint8_t *data, uint32_t size) {
+    SWD_ASSERT(cp != NULL);
+    SWD_ASSERT(data != NULL || size == 0);
+
+    cp->data = data;
+    cp->size = size;
+
+    if (size < CP_HDR_SIZE || _swd_checkpoint_get32(&data[CP_HDR_MAGIC]) != SWD_CHECKPOINT_MAGIC) {
+        return SWD_CHECKPOINT_INVALID;
+    }
+    if (_swd_checkpoint_get32(&data[CP_HDR_VERSION]) != SWD_CHECKPOINT_VERSION) {
+        SWD_LOGE("Checkpoint version %" PRIu32 " is not supported",
+                 _swd_checkpoint_get32(&data[CP_HDR_VERSION]));
+        return SWD_CHECKPOINT_INVALID;
+    }
+    if (_swd_checkpoint_get32(&data[CP_HDR_TOTAL]) != size ||
+        _swd_checkpoint_get32(&data[CP_HDR_CRC]) !=
+            swd_crc32_update(0, &data[CP_HDR_PAGE_SIZE], size - CP_HDR_PAGE_SIZE)) {
+        SWD_LOGE("Checkpoint is truncated or corrupted");
+        return SWD_CHECKPOINT_INVALID;
+    }
+
+    uint32_t page_size = _swd_checkpoint_get32(&data[CP_HDR_PAGE_SIZE]);
+    uint32_t cnt = _swd_checkpoint_get32(&data[CP_HDR_REGION_CNT]);
+    if (page_size == 0 || _swd_checkpoint_get32(&data[CP_HDR_REG_CNT]) != REG_CNT ||
+        CP_HDR_SIZE + 4 * REG_CNT + (uint64_t)CP_REGION_ENTRY * cnt > size) {
+        return SWD_CHECKPOINT_INVALID;
+    }
+
+    // Regions may not wrap past 4 GB, their pages follow each other in the page table
+    uint64_t table = _swd_checkpoint_table(cp);
+    uint64_t pages = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        const uint8_t *entry = &data[CP_HDR_SIZE + 4 * REG_CNT + CP_REGION_ENTRY * i];
+        uint64_t len = _swd_checkpoint_get32(&entry[4]);
+        if (_swd_checkpoint_get32(&entry[0]) + len > ((uint64_t)1 << 32) ||
+            _swd_checkpoint_get32(&entry[8]) != pages) {
+            return SWD_CHECKPOINT_INVALID;
+        }
+        pages += (len + page_size - 1) / page_size;
+    }
+
+    // Every page has to lie within the stored form, after the tables
+    uint64_t content = table + CP_PAGE_ENTRY * pages;
+    if (content > size) {
+        return SWD_CHECKPOINT_INVALID;
+    }
+    uint32_t page = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        const uint8_t *entry = &data[CP_HDR_SIZE + 4 * REG_CNT + CP_REGION_ENTRY * i];
+        uint32_t len = _swd_checkpoint_get32(&entry[4]);
+        for (uint64_t pos = 0; pos < len; pos += page_size, page++) {
+            uint32_t ref = _swd_checkpoint_get32(&data[table + CP_PAGE_ENTRY * page + 4]);
+            uint64_t n = (len - pos < page_size) ? len - pos : page_size;
+            if (!(ref & SWD_CHECKPOINT_PAGE_FILL) && (ref < content || ref + n > size)) {
+                return SWD_CHECKPOINT_INVALID;
+            }
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_checkpoint_restore(const swd_checkpoint_t *cp, swd_host_t *host, uint32_t scratch,
+                                 uint32_t scratch_size, swd_checkpoint_stats_t *_Nullable stats) {
+    SWD_ASSERT(cp != NULL && cp->data != NULL);
+    SWD_ASSERT(host != NULL);
+
+    const uint8_t *data = cp->data;
+    uint32_t page_size = _swd_checkpoint_get32(&data[CP_HDR_PAGE_SIZE]);
+    uint32_t cnt = _swd_checkpoint_get32(&data[CP_HDR_REGION_CNT]);
+    bool on_target = scratch_size >= SWD_CHECKPOINT_SCRATCH_SIZE;
+    swd_checkpoint_stats_t st = {0};
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    swd_crc32_target_t tgt;
+    if (on_target) {
+        // The routine must survive the pages written back
+        for (uint32_t i = 0; i < cnt; i++) {
+            const uint8_t *entry = &data[CP_HDR_SIZE + 4 * REG_CNT + CP_REGION_ENTRY * i];
+            uint64_t start = _swd_checkpoint_get32(&entry[0]);
+            uint64_t end = start + _swd_checkpoint_get32(&entry[4]);
+            if (scratch < end && start < (uint64_t)scratch + scratch_size) {
+                SWD_LOGE("Checkpoint scratch at 0x%08" PRIx32 " overlaps a region", scratch);
+                return SWD_TARGET_INVALID_ADDR;
+            }
+        }
+
+        err = swd_crc32_target_load(&tgt, host, scratch, scratch + scratch_size);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    uint32_t table = _swd_checkpoint_table(cp);
+    for (uint32_t i = 0; i < cnt; i++) {
+        const uint8_t *entry = &data[CP_HDR_SIZE + 4 * REG_CNT + CP_REGION_ENTRY * i];
+        uint32_t start = _swd_checkpoint_get32(&entry[0]);
+        uint32_t len = _swd_checkpoint_get32(&entry[4]);
+        uint32_t page = _swd_checkpoint_get32(&entry[8]);
+
+        for (uint64_t pos = 0; pos < len;) {
+            uint64_t batch = (uint64_t)page_size * CP_BATCH_PAGES;
+            batch = (len - pos < batch) ? len - pos : batch;
+            uint32_t batch_pages = (uint32_t)((batch + page_size - 1) / page_size);
+
+            _swd_checkpoint_hash_ctx_t hash = {
+                .cp = cp,
+                .page_size = page_size,
+                .len = (uint32_t)batch,
+                .first_page = page,
+                .crc = 0,
+                .dirty = 0,
+            };
+            if (on_target) {
+                for (uint32_t p = 0; p < batch_pages; p++) {
+                    uint32_t off = p * page_size;
+                    uint32_t n = (hash.len - off < page_size) ? hash.len - off : page_size;
+                    uint32_t crc;
+                    err = swd_crc32_target(&tgt, start + (uint32_t)pos + off, n, &crc);
+                    SWD_RETURN_IF_NON_OK(err);
+                    if (crc != _swd_checkpoint_get32(&data[table + CP_PAGE_ENTRY *
+                                                                       (page + p)])) {
+                        hash.dirty |= (uint32_t)0x1 << p;
+                    }
+                }
+            } else {
+                err = swd_host_memory_read_stream(host, start + (uint32_t)pos, batch,
+                                                  _swd_checkpoint_hash_consume, NULL, &hash,
+                                                  NULL);
+                SWD_RETURN_IF_NON_OK(err);
+            }
+
+            for (uint32_t p = 0; p < batch_pages; p++) {
+                if (!(hash.dirty & ((uint32_t)0x1 << p))) {
+                    continue;
+                }
+                uint32_t off = p * page_size;
+                uint32_t n = (hash.len - off < page_size) ? hash.len - off : page_size;
+                err = _swd_checkpoint_write_page(cp, host, page + p, start + (uint32_t)pos + off,
+                                                 n);
+                SWD_RETURN_IF_NON_OK(err);
+                st.dirty++;
+                st.bytes_written += n;
+            }
+
+            st.pages += batch_pages;
+            page += batch_pages;
+            pos += batch;
+        }
+    }
+
+    // SP is one of MSP and PSP depending on CONTROL, both of which are restored
+    swd_target_register_set_t set = _swd_checkpoint_get32(&data[CP_HDR_REG_SET]);
+    set |= (swd_target_register_set_t)_swd_checkpoint_get32(&data[CP_HDR_REG_SET + 4]) << 32;
+    set &= ~SWD_REG_SET(REG_SP);
+    for (uint32_t reg = 0; reg < REG_CNT; reg++) {
+        if (set & SWD_REG_SET(reg)) {
+            err = swd_host_registers_stage(host, (swd_target_register_t)reg,
+                                           _swd_checkpoint_get32(&data[CP_HDR_SIZE + 4 * reg]));
+            SWD_RETURN_IF_NON_OK(err);
+        }
+    }
+    err = swd_host_registers_commit(host);
+    SWD_RETURN_IF_NON_OK(err);
+
+    SWD_LOGI("Restored %" PRIu32 " of %" PRIu32 " pages, %" PRIu64 " bytes", st.dirty, st.pages,
+             st.bytes_written);
+    if (stats != NULL) {
+        *stats = st;
+    }
+
+    return SWD_OK;
+}
+
+void _swd_checkpoint_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t _swd_checkpoint_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+uint32_t _swd_checkpoint_table(const swd_checkpoint_t *cp) {
+    return CP_HDR_SIZE + 4 * REG_CNT +
+           CP_REGION_ENTRY * _swd_checkpoint_get32(&cp->data[CP_HDR_REGION_CNT]);
+}
+
+bool _swd_checkpoint_is_fill(const uint8_t *data, uint32_t len) {
+    return len > 0 && data[0] == data[len - 1] && memcmp(data, &data[1], len - 1) == 0;
+}
+
+swd_err_t _swd_checkpoint_hash_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                       uint32_t len) {
+    _swd_checkpoint_hash_ctx_t *hash = ctx;
+    uint32_t table = _swd_checkpoint_table(hash->cp);
+
+    while (len > 0) {
+        uint32_t p = (uint32_t)(offset / hash->page_size);
+        uint32_t page_end = (p + 1) * hash->page_size;
+        page_end = (page_end < hash->len) ? page_end : hash->len;
+        uint32_t n = page_end - (uint32_t)offset;
+        n = (n < len) ? n : len;
+
+        hash->crc = swd_crc32_update(hash->crc, data, n);
+        offset += n;
+        data += n;
+        len -= n;
+
+        if (offset == page_end) {
+            const uint8_t *page_entry =
+                &hash->cp->data[table + CP_PAGE_ENTRY * (hash->first_page + p)];
+            if (hash->crc != _swd_checkpoint_get32(page_entry)) {
+                hash->dirty |= (uint32_t)0x1 << p;
+            }
+            hash->crc = 0;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_checkpoint_write_page(const swd_checkpoint_t *cp, swd_host_t *host,
+                                     uint32_t page, uint32_t addr, uint32_t len) {
+    const uint8_t *page_entry = &cp->data[_swd_checkpoint_table(cp) + CP_PAGE_ENTRY * page];
+    uint32_t ref = _swd_checkpoint_get32(&page_entry[4]);
+
+    if (ref & SWD_CHECKPOINT_PAGE_FILL) {
+        uint8_t value = (uint8_t)ref;
+        return swd_host_memory_fill(host, addr, len, &value, 1);
+    }
+
+    return swd_host_memory_write_byte_block(host, addr, &cp->data[ref], len, NULL);
+}
\ No newline at end of file
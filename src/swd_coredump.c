@@ -0,0 +1,282 @@
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef SWD_COREDUMP_ENABLE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // SWD_COREDUMP_ENABLE_MMAP
+
+#include "swd_coredump.h"
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_log.h"
+#include "swd_target_register.h"
+
+// ELF32 core file layout
+#define ELF_EHDR_SIZE (52)
+#define ELF_PHDR_SIZE (32)
+#define ELF_ET_CORE (4)
+#define ELF_EM_ARM (40)
+#define ELF_PT_LOAD (1)
+#define ELF_PT_NOTE (4)
+#define ELF_PF_RWX (7)
+
+// Note header (namesz, descsz, type) followed by the name padded to 4 bytes
+#define NOTE_HDR_SIZE (12)
+#define NOTE_NAME_SIZE (8)
+
+// struct elf_prstatus of 32-bit ARM Linux, which GDB expects in NT_PRSTATUS
+#define NT_PRSTATUS (1)
+#define PRSTATUS_SIZE (148)
+#define PRSTATUS_CURSIG (12)
+#define PRSTATUS_PID (24)
+#define PRSTATUS_REG (72) // r0-r15, cpsr, orig_r0
+#define PRSTATUS_SIGTRAP (5)
+
+// struct user_vfp: d0-d31 then fpscr
+#define NT_ARM_VFP (0x400)
+#define VFP_SIZE (260)
+#define VFP_FPSCR (256)
+
+typedef struct _swd_coredump_offset_ctx_t {
+    swd_host_stream_consumer_t consumer;
+    void *ctx;
+    uint64_t base;
+} _swd_coredump_offset_ctx_t;
+
+void _swd_coredump_put16(uint8_t *p, uint32_t v);
+void _swd_coredump_put32(uint8_t *p, uint32_t v);
+
+/*
+ * @brief Fill `note` with a note header and name, returns the offset of the descriptor
+ */
+uint32_t _swd_coredump_note(uint8_t *note, const char *name, uint32_t descsz, uint32_t type);
+
+/*
+ * @brief Shift the offsets of a memory stream to its place in the file
+ */
+swd_err_t _swd_coredump_offset_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                       uint32_t len);
+
+#ifdef SWD_COREDUMP_ENABLE_MMAP
+typedef struct _swd_coredump_map_ctx_t {
+    uint8_t *map;
+    uint64_t size;
+} _swd_coredump_map_ctx_t;
+
+/*
+ * @brief Copy a piece of the core file to its place in the mapping
+ */
+swd_err_t _swd_coredump_map_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                    uint32_t len);
+#endif // SWD_COREDUMP_ENABLE_MMAP
+
+swd_err_t swd_coredump_write(swd_host_t *host, const swd_coredump_region_t *regions,
+                             uint32_t cnt, swd_host_stream_consumer_t consumer,
+                             void *_Nullable ctx, uint64_t *_Nullable size) {
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(regions != NULL || cnt == 0);
+    SWD_ASSERT(consumer != NULL);
+
+    // Every register is read up front, so a failure leaves no partial file behind
+    uint32_t regs[REG_CNT];
+    swd_target_register_set_t fetched;
+    swd_target_register_set_t set = SWD_REG_SET(REG_DEBUG_RETURN_ADDRESS + 1) - 1;
+    set |= SWD_REG_SET(REG_XPSR) | SWD_REG_SET_FP;
+    swd_err_t err = swd_host_registers_fetch(host, set, regs, &fetched);
+    SWD_RETURN_IF_NON_OK(err);
+    bool has_vfp = (fetched & SWD_REG_SET(REG_FPSCR)) != 0;
+
+    uint32_t phnum = 1 + cnt;
+    uint32_t note_off = ELF_EHDR_SIZE + ELF_PHDR_SIZE * phnum;
+    uint32_t prstatus_size = NOTE_HDR_SIZE + NOTE_NAME_SIZE + PRSTATUS_SIZE;
+    uint32_t vfp_size = has_vfp ? NOTE_HDR_SIZE + NOTE_NAME_SIZE + VFP_SIZE : 0;
+    uint64_t offset = 0;
+
+    uint8_t ehdr[ELF_EHDR_SIZE] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    _swd_coredump_put16(&ehdr[16], ELF_ET_CORE);
+    _swd_coredump_put16(&ehdr[18], ELF_EM_ARM);
+    _swd_coredump_put32(&ehdr[20], 1);
+    _swd_coredump_put32(&ehdr[28], ELF_EHDR_SIZE);
+    _swd_coredump_put16(&ehdr[40], ELF_EHDR_SIZE);
+    _swd_coredump_put16(&ehdr[42], ELF_PHDR_SIZE);
+    _swd_coredump_put16(&ehdr[44], phnum);
+    err = consumer(ctx, offset, ehdr, sizeof(ehdr));
+    SWD_RETURN_IF_NON_OK(err);
+    offset += sizeof(ehdr);
+
+    uint8_t phdr[ELF_PHDR_SIZE] = {0};
+    _swd_coredump_put32(&phdr[0], ELF_PT_NOTE);
+    _swd_coredump_put32(&phdr[4], note_off);
+    _swd_coredump_put32(&phdr[16], prstatus_size + vfp_size);
+    _swd_coredump_put32(&phdr[28], 4);
+    err = consumer(ctx, offset, phdr, sizeof(phdr));
+    SWD_RETURN_IF_NON_OK(err);
+    offset += sizeof(phdr);
+
+    uint64_t data_off = (uint64_t)note_off + prstatus_size + vfp_size;
+    for (uint32_t i = 0; i < cnt; i++) {
+        memset(phdr, 0, sizeof(phdr));
+        _swd_coredump_put32(&phdr[0], ELF_PT_LOAD);
+        _swd_coredump_put32(&phdr[4], (uint32_t)data_off);
+        _swd_coredump_put32(&phdr[8], regions[i].start);
+        _swd_coredump_put32(&phdr[12], regions[i].start);
+        _swd_coredump_put32(&phdr[16], regions[i].len);
+        _swd_coredump_put32(&phdr[20], regions[i].len);
+        _swd_coredump_put32(&phdr[24], ELF_PF_RWX);
+        _swd_coredump_put32(&phdr[28], 1);
+        err = consumer(ctx, offset, phdr, sizeof(phdr));
+        SWD_RETURN_IF_NON_OK(err);
+        offset += sizeof(phdr);
+        data_off += regions[i].len;
+    }
+    if (data_off > UINT32_MAX) {
+        SWD_LOGE("Core file would be larger than 4GB");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    uint8_t note[NOTE_HDR_SIZE + NOTE_NAME_SIZE + VFP_SIZE];
+    memset(note, 0, sizeof(note));
+    uint32_t desc = _swd_coredump_note(note, "CORE", PRSTATUS_SIZE, NT_PRSTATUS);
+    _swd_coredump_put16(&note[desc + PRSTATUS_CURSIG], PRSTATUS_SIGTRAP);
+    _swd_coredump_put32(&note[desc + PRSTATUS_PID], 1);
+    for (uint32_t reg = REG_R0; reg <= REG_DEBUG_RETURN_ADDRESS; reg++) {
+        _swd_coredump_put32(&note[desc + PRSTATUS_REG + 4 * reg], regs[reg]);
+    }
+    _swd_coredump_put32(&note[desc + PRSTATUS_REG + 4 * 16], regs[REG_XPSR]);
+    _swd_coredump_put32(&note[desc + PRSTATUS_REG + 4 * 17], regs[REG_R0]);
+    err = consumer(ctx, offset, note, prstatus_size);
+    SWD_RETURN_IF_NON_OK(err);
+    offset += prstatus_size;
+
+    if (has_vfp) {
+        // S2n and S2n+1 form Dn, the upper 16 D registers do not exist on M-profile
+        memset(note, 0, sizeof(note));
+        desc = _swd_coredump_note(note, "LINUX", VFP_SIZE, NT_ARM_VFP);
+        for (uint32_t s = 0; s < 32; s++) {
+            _swd_coredump_put32(&note[desc + 4 * s], regs[REG_S0 + s]);
+        }
+        _swd_coredump_put32(&note[desc + VFP_FPSCR], regs[REG_FPSCR]);
+        err = consumer(ctx, offset, note, vfp_size);
+        SWD_RETURN_IF_NON_OK(err);
+        offset += vfp_size;
+    }
+
+    _swd_coredump_offset_ctx_t shift = {.consumer = consumer, .ctx = ctx};
+    for (uint32_t i = 0; i < cnt; i++) {
+        shift.base = offset;
+        err = swd_host_memory_read_stream(host, regions[i].start, regions[i].len,
+                                          _swd_coredump_offset_consume, NULL, &shift, NULL);
+        SWD_RETURN_IF_NON_OK(err);
+        offset += regions[i].len;
+    }
+
+    SWD_LOGI("Core dump of %" PRIu32 " regions, %" PRIu64 " bytes", cnt, offset);
+    if (size != NULL) {
+        *size = offset;
+    }
+
+    return SWD_OK;
+}
+
+void _swd_coredump_put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+void _swd_coredump_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t _swd_coredump_note(uint8_t *note, const char *name, uint32_t descsz, uint32_t type) {
+    uint32_t namesz = (uint32_t)strlen(name) + 1;
+    _swd_coredump_put32(&note[0], namesz);
+    _swd_coredump_put32(&note[4], descsz);
+    _swd_coredump_put32(&note[8], type);
+    memcpy(&note[NOTE_HDR_SIZE], name, namesz);
+
+    return NOTE_HDR_SIZE + NOTE_NAME_SIZE;
+}
+
+swd_err_t _swd_coredump_offset_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                       uint32_t len) {
+    _swd_coredump_offset_ctx_t *shift = ctx;
+    return shift->consumer(shift->ctx, shift->base + offset, data, len);
+}
+
+#ifdef SWD_COREDUMP_ENABLE_MMAP
+swd_err_t swd_coredump_save(swd_host_t *host, const char *path,
+                            const swd_coredump_region_t *regions, uint32_t cnt,
+                            uint64_t *_Nullable size) {
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(path != NULL);
+    SWD_ASSERT(regions != NULL || cnt == 0);
+
+    // Largest file, with the VFP note. It is cut to the written size afterwards
+    uint64_t max_size = ELF_EHDR_SIZE + ELF_PHDR_SIZE * (1 + (uint64_t)cnt) +
+                        2 * (NOTE_HDR_SIZE + NOTE_NAME_SIZE) + PRSTATUS_SIZE + VFP_SIZE;
+    for (uint32_t i = 0; i < cnt; i++) {
+        max_size += regions[i].len;
+    }
+    if (max_size > UINT32_MAX) {
+        SWD_LOGE("Core file would be larger than 4GB");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        SWD_LOGE("Failed to create %s", path);
+        return SWD_ERR;
+    }
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)max_size) == 0) {
+        map = mmap(NULL, (size_t)max_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        SWD_LOGE("Failed to map %s", path);
+        close(fd);
+        unlink(path);
+        return SWD_ERR;
+    }
+    madvise(map, (size_t)max_size, MADV_SEQUENTIAL);
+
+    _swd_coredump_map_ctx_t out = {.map = map, .size = max_size};
+    uint64_t written = 0;
+    swd_err_t err =
+        swd_coredump_write(host, regions, cnt, _swd_coredump_map_consume, &out, &written);
+    munmap(map, (size_t)max_size);
+    if (err == SWD_OK && ftruncate(fd, (off_t)written) != 0) {
+        SWD_LOGE("Failed to set the size of %s", path);
+        err = SWD_ERR;
+    }
+    close(fd);
+    if (err != SWD_OK) {
+        unlink(path);
+        return err;
+    }
+
+    if (size != NULL) {
+        *size = written;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_coredump_map_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                    uint32_t len) {
+    _swd_coredump_map_ctx_t *out = ctx;
+    if (offset + len > out->size) {
+        return SWD_ERR;
+    }
+
+    memcpy(&out->map[offset], data, len);
+    return SWD_OK;
+}
+#endif // SWD_COREDUMP_ENABLE_MMAP
\ No newline at end of file
@@ -0,0 +1,100 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "swd_crc.h"
+#include "swd_err.h"
+
+#if defined(SWD_CRC32_HW_FUNC)
+extern uint32_t SWD_CRC32_HW_FUNC(uint32_t crc, const uint8_t *buf, uint32_t len);
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+// Reflected IEEE 802.3 polynomial
+#define CRC32_POLY ((uint32_t)0xEDB88320)
+
+// Bytes of `value` hashed at once by `swd_crc32_fill`
+#define CRC32_FILL_CHUNK (64)
+
+#if !defined(SWD_CRC32_HW_FUNC) && !defined(__ARM_FEATURE_CRC32)
+/*
+ * Slicing-by-4 tables, built on first use
+ */
+static uint32_t _swd_crc32_table[4][256];
+static bool _swd_crc32_table_ready = false;
+
+void _swd_crc32_table_init(void);
+#endif
+
+uint32_t swd_crc32_update(uint32_t crc, const uint8_t *data, uint32_t len) {
+    SWD_ASSERT(data != NULL || len == 0);
+
+#if defined(SWD_CRC32_HW_FUNC)
+    return SWD_CRC32_HW_FUNC(crc, data, len);
+#elif defined(__ARM_FEATURE_CRC32)
+    crc = ~crc;
+    while (len > 0 && ((uintptr_t)data & 0x3)) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+    for (; len >= 4; len -= 4, data += 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = __crc32w(crc, word);
+    }
+    while (len-- > 0) {
+        crc = __crc32b(crc, *data++);
+    }
+    return ~crc;
+#else
+    if (!_swd_crc32_table_ready) {
+        _swd_crc32_table_init();
+    }
+
+    crc = ~crc;
+    for (; len >= 4; len -= 4, data += 4) {
+        crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+               ((uint32_t)data[3] << 24);
+        crc = _swd_crc32_table[3][crc & 0xFF] ^ _swd_crc32_table[2][(crc >> 8) & 0xFF] ^
+              _swd_crc32_table[1][(crc >> 16) & 0xFF] ^ _swd_crc32_table[0][crc >> 24];
+    }
+    while (len-- > 0) {
+        crc = _swd_crc32_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+#endif
+}
+
+uint32_t swd_crc32_fill(uint32_t crc, uint8_t value, uint32_t len) {
+    uint8_t chunk[CRC32_FILL_CHUNK];
+    memset(chunk, value, sizeof(chunk));
+
+    while (len > 0) {
+        uint32_t n = (len < CRC32_FILL_CHUNK) ? len : CRC32_FILL_CHUNK;
+        crc = swd_crc32_update(crc, chunk, n);
+        len -= n;
+    }
+
+    return crc;
+}
+
+#if !defined(SWD_CRC32_HW_FUNC) && !defined(__ARM_FEATURE_CRC32)
+void _swd_crc32_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLY : crc >> 1;
+        }
+        _swd_crc32_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (uint32_t t = 1; t < 4; t++) {
+            uint32_t prev = _swd_crc32_table[t - 1][i];
+            _swd_crc32_table[t][i] = _swd_crc32_table[0][prev & 0xFF] ^ (prev >> 8);
+        }
+    }
+    _swd_crc32_table_ready = true;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+
+#include <stdint.h>
+
+#include "swd_crc_target.h"
+#include "swd_err.h"
+#include "swd_host.h"
+
+// BKPT #0 followed by B . in case the core is not halted by the BKPT
+#define CRC32_TARGET_TRAP ((uint32_t)0xE7FEBE00)
+
+/*
+ * uint32_t crc32(uint32_t crc, const uint8_t *buf, uint32_t len), zlib compatible and bitwise to
+ *  stay small. Thumb-1 halfwords in little endian, must be loaded word aligned
+ */
+static const uint8_t _swd_crc32_target_code[SWD_CRC32_TARGET_SIZE - 4] = {
+    0xC0, 0x43, // mvns r0, r0
+    0x08, 0x4B, // ldr r3, =0xEDB88320
+    0x00, 0x2A, // byte: cmp r2, #0
+    0x0A, 0xD0, // beq done
+    0x0C, 0x78, // ldrb r4, [r1]
+    0x60, 0x40, // eors r0, r4
+    0x01, 0x31, // adds r1, #1
+    0x01, 0x3A, // subs r2, #1
+    0x08, 0x24, // movs r4, #8
+    0x40, 0x08, // bit: lsrs r0, r0, #1
+    0x00, 0xD3, // bcc next
+    0x58, 0x40, // eors r0, r3
+    0x01, 0x3C, // next: subs r4, #1
+    0xFA, 0xD1, // bne bit
+    0xF2, 0xE7, // b byte
+    0xC0, 0x43, // done: mvns r0, r0
+    0x70, 0x47, // bx lr
+    0x00, 0xBF, // nop
+    0x20, 0x83, 0xB8, 0xED, // .word 0xEDB88320
+};
+
+swd_err_t swd_crc32_target_load(swd_crc32_target_t *tgt, swd_host_t *host, uint32_t addr,
+                                uint32_t sp) {
+    SWD_ASSERT(tgt != NULL);
+    SWD_ASSERT(host != NULL);
+
+    if (addr & 0x3) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    tgt->host = host;
+    tgt->trap = addr;
+    tgt->code = addr + 4;
+    tgt->sp = sp & ~(uint32_t)0x7;
+
+    swd_err_t err = swd_host_memory_write_word(host, tgt->trap, CRC32_TARGET_TRAP);
+    SWD_RETURN_IF_NON_OK(err);
+
+    return swd_host_memory_write_byte_block(host, tgt->code, _swd_crc32_target_code,
+                                            sizeof(_swd_crc32_target_code), NULL);
+}
+
+swd_err_t swd_crc32_target(const swd_crc32_target_t *tgt, uint32_t addr, uint32_t len,
+                           uint32_t *crc) {
+    SWD_ASSERT(tgt != NULL);
+    SWD_ASSERT(crc != NULL);
+
+    swd_host_call_t call = {
+        .entry = tgt->code,
+        .args = {0, addr, len, 0},
+        .sp = tgt->sp,
+        .trap = tgt->trap,
+        .sb = 0,
+    };
+
+    return swd_host_call(tgt->host, &call, SWD_CRC32_TARGET_MAX_POLLS, crc);
+}
\ No newline at end of file
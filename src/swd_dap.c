@@ -23,9 +23,10 @@
 #define SELECT_APBANKSEL_MASK (0xF0)
 
 #ifdef SWD_DISABLE_UNDEFINED_PORT
-#define BLOCK_UNDEFINED_PORT(port)                                                                 \
+#define BLOCK_UNDEFINED_PORT(dap, port)                                                            \
     do {                                                                                           \
-        if (port == AP_DB0 || port == AP_DB1 || port == AP_DB2 || port == AP_DB3 ||                \
+        if (((port == AP_DB0 || port == AP_DB1 || port == AP_DB2 || port == AP_DB3) &&             \
+             !dap->_bd_allowed) ||                                                                 \
             port == AP_BASE) {                                                                     \
             SWD_LOGE("**************************************************************************"  \
                      "*****");                                                                     \
@@ -40,7 +41,7 @@
         }                                                                                          \
     } while (0)
 #else
-#define BLOCK_UNDEFINED_PORT(port)
+#define BLOCK_UNDEFINED_PORT(dap, port)
 
 #endif // SWD_DISABLE_UNDEFINED_PORT
 
@@ -89,6 +90,16 @@ static swd_err_t _swd_dap_port_write_dp(swd_dap_t *dap, swd_dap_port_t port, uin
 static swd_err_t _swd_dap_port_read_ap(swd_dap_t *dap, swd_dap_port_t port, uint32_t *data);
 static swd_err_t _swd_dap_port_write_ap(swd_dap_t *dap, swd_dap_port_t port, uint32_t data);
 
+/*
+ * @brief Block variants of the AP wrappers. APBANKSEL is only selected once, and reads
+ *          are pipelined so each posted request returns the result of the previous one
+ */
+
+static swd_err_t _swd_dap_port_read_ap_block(swd_dap_t *dap, const swd_dap_port_t *ports,
+                                             uint32_t port_cnt, uint32_t *data, uint32_t cnt);
+static swd_err_t _swd_dap_port_write_ap_block(swd_dap_t *dap, swd_dap_port_t port,
+                                              const uint32_t *data, uint32_t cnt);
+
 /*
  * @brief Low level read and write operations to communicate with the dap. In order to try
  *          and complete a read/write in the same function call, a retry count is used
@@ -118,6 +129,7 @@ void swd_dap_init(swd_dap_t *dap) {
 
     dap->is_stopped = true;
     dap->_ap_error = false;
+    dap->_bd_allowed = false;
 }
 
 void swd_dap_set_driver(swd_dap_t *dap, swd_driver_t *driver) {
@@ -179,7 +191,7 @@ swd_err_t swd_dap_port_read(swd_dap_t *dap, swd_dap_port_t port, uint32_t *data)
         return SWD_DAP_INVALID_PORT_OP;
     }
 
-    BLOCK_UNDEFINED_PORT(port);
+    BLOCK_UNDEFINED_PORT(dap, port);
 
     // SWD_LOGV("Reading port %s", swd_dap_port_as_str(port));
 
@@ -203,7 +215,7 @@ swd_err_t swd_dap_port_write(swd_dap_t *dap, swd_dap_port_t port, uint32_t data)
         return SWD_DAP_INVALID_PORT_OP;
     }
 
-    BLOCK_UNDEFINED_PORT(port);
+    BLOCK_UNDEFINED_PORT(dap, port);
 
     // SWD_LOGV("Writing 0x%08" PRIx32 " to %s", data, swd_dap_port_as_str(port));
 
@@ -214,6 +226,113 @@ swd_err_t swd_dap_port_write(swd_dap_t *dap, swd_dap_port_t port, uint32_t data)
     }
 }
 
+swd_err_t swd_dap_port_read_block(swd_dap_t *dap, swd_dap_port_t port, uint32_t *data,
+                                  uint32_t cnt) {
+    SWD_ASSERT(dap != NULL);
+    SWD_ASSERT(data != NULL || cnt == 0);
+
+    if (dap->is_stopped) {
+        SWD_LOGW("Attempting to read from a stopped DAP");
+        return SWD_DAP_NOT_STARTED;
+    }
+
+    if (!swd_dap_port_is_a_read_port(port)) {
+        SWD_LOGW("Requested port (%s) is not allowed to be read from", swd_dap_port_as_str(port));
+        return SWD_DAP_INVALID_PORT_OP;
+    }
+
+    BLOCK_UNDEFINED_PORT(dap, port);
+
+    if (cnt == 0) {
+        return SWD_OK;
+    }
+
+    // DP reads are not posted, so there is nothing to pipeline
+    if (swd_dap_port_is_DP(port)) {
+        swd_err_t err;
+        for (uint32_t i = 0; i < cnt; i++) {
+            if ((err = _swd_dap_port_read_dp(dap, port, data + i)) != SWD_OK) {
+                return err;
+            }
+        }
+        return SWD_OK;
+    }
+
+    return _swd_dap_port_read_ap_block(dap, &port, 1, data, cnt);
+}
+
+swd_err_t swd_dap_port_read_multi(swd_dap_t *dap, const swd_dap_port_t *ports, uint32_t *data,
+                                  uint32_t cnt) {
+    SWD_ASSERT(dap != NULL);
+    SWD_ASSERT(ports != NULL || cnt == 0);
+    SWD_ASSERT(data != NULL || cnt == 0);
+
+    if (dap->is_stopped) {
+        SWD_LOGW("Attempting to read from a stopped DAP");
+        return SWD_DAP_NOT_STARTED;
+    }
+
+    if (cnt == 0) {
+        return SWD_OK;
+    }
+
+    uint32_t apbanksel = swd_dap_port_as_apbanksel_bits(ports[0]);
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (!swd_dap_port_is_AP(ports[i]) || !swd_dap_port_is_a_read_port(ports[i])) {
+            SWD_LOGW("Requested port (%s) cannot be part of a pipelined AP read",
+                     swd_dap_port_as_str(ports[i]));
+            return SWD_DAP_INVALID_PORT_OP;
+        }
+        if (swd_dap_port_as_apbanksel_bits(ports[i]) != apbanksel) {
+            SWD_LOGW("Pipelined AP reads must all be in the same APBANKSEL");
+            return SWD_DAP_INVALID_PORT_OP;
+        }
+        BLOCK_UNDEFINED_PORT(dap, ports[i]);
+    }
+
+    return _swd_dap_port_read_ap_block(dap, ports, cnt, data, cnt);
+}
+
+void swd_dap_allow_banked_data(swd_dap_t *dap, bool allow) {
+    SWD_ASSERT(dap != NULL);
+
+    dap->_bd_allowed = allow;
+}
+
+swd_err_t swd_dap_port_write_block(swd_dap_t *dap, swd_dap_port_t port, const uint32_t *data,
+                                   uint32_t cnt) {
+    SWD_ASSERT(dap != NULL);
+    SWD_ASSERT(data != NULL || cnt == 0);
+
+    if (dap->is_stopped) {
+        SWD_LOGW("Attempting to write to a stopped DAP");
+        return SWD_DAP_NOT_STARTED;
+    }
+
+    if (!swd_dap_port_is_a_write_port(port)) {
+        SWD_LOGW("Requested port (%s) is not allowed to be written to", swd_dap_port_as_str(port));
+        return SWD_DAP_INVALID_PORT_OP;
+    }
+
+    BLOCK_UNDEFINED_PORT(dap, port);
+
+    if (cnt == 0) {
+        return SWD_OK;
+    }
+
+    if (swd_dap_port_is_DP(port)) {
+        swd_err_t err;
+        for (uint32_t i = 0; i < cnt; i++) {
+            if ((err = _swd_dap_port_write_dp(dap, port, data[i])) != SWD_OK) {
+                return err;
+            }
+        }
+        return SWD_OK;
+    }
+
+    return _swd_dap_port_write_ap_block(dap, port, data, cnt);
+}
+
 /*                                    */
 /* PRIVATE FUCNTION DEFINITIONS BEGIN */
 /*                                    */
@@ -397,6 +516,63 @@ static swd_err_t _swd_dap_port_write_ap(swd_dap_t *dap, swd_dap_port_t port, uin
     return SWD_OK;
 }
 
+static swd_err_t _swd_dap_port_read_ap_block(swd_dap_t *dap, const swd_dap_port_t *ports,
+                                             uint32_t port_cnt, uint32_t *data, uint32_t cnt) {
+    if (_swd_dap_port_set_banksel(dap, ports[0]) != SWD_OK) {
+        SWD_LOGE("Could not update APBANKSEL");
+        return SWD_ERR;
+    }
+
+    // The first response belongs to whatever was posted before. Every following
+    // response is the data of the previous request
+    uint32_t buf;
+    uint8_t packet = swd_dap_port_as_packet(ports[0], true);
+    swd_err_t err = _swd_dap_port_read_from_packet(dap, packet, &buf, RW_RETRY_COUNT);
+    for (uint32_t i = 1; i < cnt && err == SWD_OK && !dap->_ap_error; i++) {
+        packet = swd_dap_port_as_packet(ports[i % port_cnt], true);
+        err = _swd_dap_port_read_from_packet(dap, packet, data + i - 1, RW_RETRY_COUNT);
+    }
+    if (err == SWD_OK && !dap->_ap_error) {
+        // Collect the last posted result
+        err = _swd_dap_port_read_dp(dap, DP_RDBUFF, data + cnt - 1);
+    }
+
+    if (dap->_ap_error) {
+        dap->_ap_error = false;
+        return SWD_ERR;
+    }
+
+    return err;
+}
+
+static swd_err_t _swd_dap_port_write_ap_block(swd_dap_t *dap, swd_dap_port_t port,
+                                              const uint32_t *data, uint32_t cnt) {
+    if (_swd_dap_port_set_banksel(dap, port) != SWD_OK) {
+        SWD_LOGE("Could not update APBANKSEL");
+        return SWD_ERR;
+    }
+
+    uint8_t packet = swd_dap_port_as_packet(port, false);
+
+    swd_err_t err;
+    for (uint32_t i = 0; i < cnt; i++) {
+        err = _swd_dap_port_write_from_packet(dap, packet, data[i], RW_RETRY_COUNT);
+        if (dap->_ap_error) {
+            dap->_ap_error = false;
+            return SWD_ERR;
+        }
+        if (err != SWD_OK) {
+            return err;
+        }
+    }
+
+    // Delay for AP to process the last write
+    _swd_dap_idle_short(dap);
+    _swd_dap_idle_short(dap);
+
+    return SWD_OK;
+}
+
 static swd_err_t _swd_dap_port_read_from_packet(swd_dap_t *dap, uint8_t packet, uint32_t *data,
                                                 uint32_t retry_count) {
     if (retry_count == 0) {
@@ -26,6 +26,20 @@ const char *swd_err_as_str(swd_err_t err) {
         return "SWD Target No More Breakpoints";
         case SWD_HOST_INVALID_REGISTER:
         return "SWD Host Invalid Register";
+    case SWD_HOST_TABLE_FULL:
+        return "SWD Host Table Full";
+    case SWD_HOST_XFER_CANCELLED:
+        return "SWD Host Transfer Cancelled";
+    case SWD_TARGET_NOT_SUPPORTED:
+        return "SWD Target Feature Not Supported";
+    case SWD_FLASH_ALGO_FAILED:
+        return "SWD Flash Algorithm Failed";
+    case SWD_IMAGE_INVALID:
+        return "SWD Image Malformed";
+    case SWD_HOST_STEP_LIMIT:
+        return "SWD Host Step Limit Reached";
+    case SWD_CHECKPOINT_INVALID:
+        return "SWD Checkpoint Malformed";
 
 #ifdef SWD_DISABLE_UNDEFINED_PORT
     case SWD_DAP_UNDEFINED_PORT:
@@ -0,0 +1,498 @@
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "swd_crc.h"
+#include "swd_crc_target.h"
+#include "swd_err.h"
+#include "swd_flash.h"
+#include "swd_host.h"
+#include "swd_log.h"
+
+// Smallest stack left to the algorithm
+#define FLASH_MIN_STACK (256)
+
+// Per sector flags of differential programming
+#define DIFF_MAP_WORDS ((SWD_FLASH_DIFF_MAX_SECTORS + 31) / 32)
+#define DIFF_MAP_GET(map, i) (((map)[(i) / 32] >> ((i) % 32)) & 0x1)
+#define DIFF_MAP_SET(map, i) ((map)[(i) / 32] |= (uint32_t)0x1 << ((i) % 32))
+
+// Offsets of the stub algorithm's functions
+#define STUB_INIT (0)
+#define STUB_ERASE_SECTOR (4)
+#define STUB_PROGRAM_PAGE (28)
+
+/*
+ * Stub algorithm, Thumb-1 halfwords in little endian
+ */
+static const uint8_t _swd_flash_stub_code[] = {
+    // Init, UnInit
+    0x00, 0x20, // movs r0, #0
+    0x70, 0x47, // bx lr
+    // EraseSector
+    0x01, 0x21, // movs r1, #1
+    0x89, 0x02, // lsls r1, r1, #10
+    0xFF, 0x22, // movs r2, #0xFF
+    0x00, 0x29, // cmp r1, #0
+    0x03, 0xD0, // beq done
+    0x02, 0x70, // strb r2, [r0]
+    0x01, 0x30, // adds r0, #1
+    0x01, 0x39, // subs r1, #1
+    0xF9, 0xE7, // b cmp
+    0x00, 0x20, // done: movs r0, #0
+    0x70, 0x47, // bx lr
+    0x00, 0xBF, // nop
+    // ProgramPage
+    0x00, 0x29, // cmp r1, #0
+    0x05, 0xD0, // beq done
+    0x13, 0x78, // ldrb r3, [r2]
+    0x03, 0x70, // strb r3, [r0]
+    0x01, 0x30, // adds r0, #1
+    0x01, 0x32, // adds r2, #1
+    0x01, 0x39, // subs r1, #1
+    0xF7, 0xE7, // b cmp
+    0x00, 0x20, // done: movs r0, #0
+    0x70, 0x47, // bx lr
+};
+
+/*
+ * @brief Start an algorithm function, `func` is its offset within the code
+ */
+swd_err_t _swd_flash_start(swd_flash_t *flash, uint32_t func, uint32_t r0, uint32_t r1,
+                           uint32_t r2);
+
+/*
+ * @brief Wait for the running algorithm function and check its result
+ */
+swd_err_t _swd_flash_wait(swd_flash_t *flash);
+
+swd_err_t _swd_flash_call(swd_flash_t *flash, uint32_t func, uint32_t r0, uint32_t r1,
+                          uint32_t r2);
+
+/*
+ * @brief Call UnInit for the current operation and Init for `fnc`, unless already done
+ */
+swd_err_t _swd_flash_enter(swd_flash_t *flash, swd_flash_fnc_t fnc);
+
+/*
+ * @brief Write the page at `page_addr` to an SRAM buffer. The part of the page outside of
+ *          [addr, addr + len) is filled with the erased value
+ */
+swd_err_t _swd_flash_upload(swd_flash_t *flash, uint32_t buf, uint32_t page_addr, uint32_t addr,
+                            const uint8_t *data, uint32_t len);
+
+/*
+ * @brief CRC32 of flash content, computed by the CRC routine on the target
+ */
+swd_err_t _swd_flash_target_crc(swd_flash_t *flash, uint32_t addr, uint32_t len, uint32_t *crc);
+
+swd_err_t swd_flash_load(swd_flash_t *flash, swd_host_t *host, const swd_flash_algo_t *algo,
+                         uint32_t ram_start, uint32_t ram_size) {
+    SWD_ASSERT(flash != NULL);
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(algo != NULL);
+    SWD_ASSERT(algo->page_size > 0 && algo->sector_size > 0);
+
+    flash->host = host;
+    flash->algo = *algo;
+    flash->_fnc = SWD_FLASH_FNC_NONE;
+
+    if (ram_start & 0x3) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    uint32_t code_words = (algo->code_size + 3) / 4;
+    uint32_t page_words = (algo->page_size + 3) / 4;
+    uint64_t used = SWD_CRC32_TARGET_SIZE + 4 * ((uint64_t)code_words + 2 * (uint64_t)page_words);
+    if (used + FLASH_MIN_STACK > ram_size) {
+        SWD_LOGE("Flash algorithm needs more than %" PRIu32 " bytes of SRAM", ram_size);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    flash->_trap = ram_start;
+    flash->_code = ram_start + SWD_CRC32_TARGET_SIZE;
+    flash->_bufs[0] = flash->_code + 4 * code_words;
+    flash->_bufs[1] = flash->_bufs[0] + 4 * page_words;
+    flash->_sp = (ram_start + ram_size) & ~(uint32_t)0x7;
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    // The CRC routine's trap is shared with the algorithm
+    err = swd_crc32_target_load(&flash->_crc, host, flash->_trap, flash->_sp);
+    SWD_RETURN_IF_NON_OK(err);
+
+    err = swd_host_memory_write_byte_block(host, flash->_code, algo->code, algo->code_size, NULL);
+    SWD_RETURN_IF_NON_OK(err);
+
+    SWD_LOGI("Flash algorithm loaded at 0x%08" PRIx32 ", page buffers at 0x%08" PRIx32
+             " and 0x%08" PRIx32,
+             flash->_code, flash->_bufs[0], flash->_bufs[1]);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_flash_erase_sector(swd_flash_t *flash, uint32_t addr) {
+    SWD_ASSERT(flash != NULL);
+
+    if (addr - flash->algo.flash_base >= flash->algo.flash_size) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_err_t err = _swd_flash_enter(flash, SWD_FLASH_FNC_ERASE);
+    SWD_RETURN_IF_NON_OK(err);
+
+    uint32_t sector = addr - (addr - flash->algo.flash_base) % flash->algo.sector_size;
+    err = _swd_flash_call(flash, flash->algo.erase_sector, sector, 0, 0);
+    swd_host_memory_changed(flash->host, sector, flash->algo.sector_size);
+
+    return err;
+}
+
+swd_err_t swd_flash_erase_chip(swd_flash_t *flash) {
+    SWD_ASSERT(flash != NULL);
+
+    swd_err_t err = _swd_flash_enter(flash, SWD_FLASH_FNC_ERASE);
+    SWD_RETURN_IF_NON_OK(err);
+
+    // Even a failed erase may have changed the flash
+    if (flash->algo.erase_chip != SWD_FLASH_NO_FUNC) {
+        err = _swd_flash_call(flash, flash->algo.erase_chip, 0, 0, 0);
+        swd_host_memory_changed(flash->host, flash->algo.flash_base, flash->algo.flash_size);
+        return err;
+    }
+
+    for (uint32_t offset = 0; offset < flash->algo.flash_size;
+         offset += flash->algo.sector_size) {
+        err = _swd_flash_call(flash, flash->algo.erase_sector, flash->algo.flash_base + offset,
+                              0, 0);
+        swd_host_memory_changed(flash->host, flash->algo.flash_base + offset,
+                                flash->algo.sector_size);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_flash_program(swd_flash_t *flash, uint32_t addr, const uint8_t *data,
+                            uint32_t len) {
+    SWD_ASSERT(flash != NULL);
+    SWD_ASSERT(data != NULL || len == 0);
+
+    const swd_flash_algo_t *algo = &flash->algo;
+    if (addr - algo->flash_base >= algo->flash_size ||
+        len > algo->flash_size - (addr - algo->flash_base)) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+    if (len == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = _swd_flash_enter(flash, SWD_FLASH_FNC_PROGRAM);
+    SWD_RETURN_IF_NON_OK(err);
+
+    uint32_t first = addr - (addr - algo->flash_base) % algo->page_size;
+    uint32_t pages = (uint32_t)(((uint64_t)addr + len - first + algo->page_size - 1) /
+                                algo->page_size);
+
+    err = _swd_flash_upload(flash, flash->_bufs[0], first, addr, data, len);
+    SWD_RETURN_IF_NON_OK(err);
+
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t page_addr = first + i * algo->page_size;
+        err = _swd_flash_start(flash, algo->program_page, page_addr, algo->page_size,
+                               flash->_bufs[i & 1]);
+        SWD_RETURN_IF_NON_OK(err);
+
+        // The next page goes to the other buffer while this one is being programmed
+        swd_err_t upload_err = SWD_OK;
+        if (i + 1 < pages) {
+            upload_err = _swd_flash_upload(flash, flash->_bufs[(i + 1) & 1],
+                                           page_addr + algo->page_size, addr, data, len);
+        }
+
+        // Always wait, the core must not be left running the algorithm. The page is noted
+        // even if that failed, it may be partly programmed
+        err = _swd_flash_wait(flash);
+        swd_host_memory_changed(flash->host, page_addr, algo->page_size);
+        err = (err == SWD_OK) ? upload_err : err;
+        if (err != SWD_OK) {
+            SWD_LOGE("Programming the page at 0x%08" PRIx32 " failed", page_addr);
+            return err;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_flash_program_diff(swd_flash_t *flash, uint32_t addr, const uint8_t *data,
+                                 uint32_t len, bool allow_chip_erase,
+                                 swd_flash_diff_stats_t *_Nullable stats) {
+    SWD_ASSERT(flash != NULL);
+    SWD_ASSERT(data != NULL || len == 0);
+
+    const swd_flash_algo_t *algo = &flash->algo;
+    swd_flash_diff_stats_t local_stats;
+    stats = (stats != NULL) ? stats : &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    if (addr - algo->flash_base >= algo->flash_size ||
+        len > algo->flash_size - (addr - algo->flash_base)) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+    if (len == 0) {
+        return SWD_OK;
+    }
+
+    uint32_t first = addr - (addr - algo->flash_base) % algo->sector_size;
+    uint64_t end = (uint64_t)addr + len;
+    stats->sectors = (uint32_t)((end - first + algo->sector_size - 1) / algo->sector_size);
+    if (stats->sectors > SWD_FLASH_DIFF_MAX_SECTORS) {
+        SWD_LOGE("Image covers more than %d sectors", SWD_FLASH_DIFF_MAX_SECTORS);
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    uint32_t changed[DIFF_MAP_WORDS] = {0};
+    uint32_t blank[DIFF_MAP_WORDS] = {0};
+    for (uint32_t i = 0; i < stats->sectors; i++) {
+        uint32_t sector = first + i * algo->sector_size;
+        uint32_t lo = (addr > sector) ? addr : sector;
+        uint32_t hi = (end < (uint64_t)sector + algo->sector_size) ? (uint32_t)end
+                                                                   : sector + algo->sector_size;
+
+        // The parts of the sector outside of the image are expected erased
+        const uint8_t *part = &data[lo - addr];
+        uint32_t crc = swd_crc32_fill(0, algo->erased_value, lo - sector);
+        crc = swd_crc32_update(crc, part, hi - lo);
+        crc = swd_crc32_fill(crc, algo->erased_value, sector + algo->sector_size - hi);
+
+        bool is_blank = true;
+        for (uint32_t j = 0; j < hi - lo && is_blank; j++) {
+            is_blank = part[j] == algo->erased_value;
+        }
+        if (is_blank) {
+            DIFF_MAP_SET(blank, i);
+        }
+
+        uint32_t target_crc;
+        swd_err_t err = _swd_flash_target_crc(flash, sector, algo->sector_size, &target_crc);
+        SWD_RETURN_IF_NON_OK(err);
+        if (target_crc != crc) {
+            DIFF_MAP_SET(changed, i);
+            stats->changed++;
+            stats->blank += is_blank;
+        }
+    }
+
+    uint64_t flash_sectors = (algo->flash_size + algo->sector_size - 1) / algo->sector_size;
+    stats->chip_erase = allow_chip_erase && algo->erase_chip != SWD_FLASH_NO_FUNC &&
+                        (uint64_t)stats->changed * 100 >=
+                            flash_sectors * SWD_FLASH_CHIP_ERASE_PERCENT;
+    SWD_LOGI("%" PRIu32 " of %" PRIu32 " sectors changed, %s erase", stats->changed,
+             stats->sectors, stats->chip_erase ? "chip" : "sector");
+    if (stats->changed == 0) {
+        return SWD_OK;
+    }
+
+    // Erase everything first, so Init is called once per operation
+    swd_err_t err;
+    if (stats->chip_erase) {
+        err = swd_flash_erase_chip(flash);
+        SWD_RETURN_IF_NON_OK(err);
+    } else {
+        for (uint32_t i = 0; i < stats->sectors; i++) {
+            if (DIFF_MAP_GET(changed, i)) {
+                err = swd_flash_erase_sector(flash, first + i * algo->sector_size);
+                SWD_RETURN_IF_NON_OK(err);
+            }
+        }
+    }
+
+    // Consecutive sectors are programmed in one run to keep the page buffers busy
+    uint32_t i = 0;
+    while (i < stats->sectors) {
+        bool program = !DIFF_MAP_GET(blank, i) && (stats->chip_erase || DIFF_MAP_GET(changed, i));
+        if (!program) {
+            i++;
+            continue;
+        }
+
+        uint32_t run = i;
+        while (run < stats->sectors && !DIFF_MAP_GET(blank, run) &&
+               (stats->chip_erase || DIFF_MAP_GET(changed, run))) {
+            run++;
+        }
+
+        uint64_t lo = (uint64_t)first + (uint64_t)i * algo->sector_size;
+        uint64_t hi = (uint64_t)first + (uint64_t)run * algo->sector_size;
+        lo = (lo > addr) ? lo : addr;
+        hi = (hi < end) ? hi : end;
+        err = swd_flash_program(flash, (uint32_t)lo, &data[lo - addr], (uint32_t)(hi - lo));
+        SWD_RETURN_IF_NON_OK(err);
+
+        i = run;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_flash_verify(swd_flash_t *flash, uint32_t addr, const uint8_t *data, uint32_t len,
+                           bool *equal, uint32_t *_Nullable bad_addr) {
+    SWD_ASSERT(flash != NULL);
+    SWD_ASSERT(data != NULL || len == 0);
+    SWD_ASSERT(equal != NULL);
+
+    *equal = true;
+    for (uint32_t offset = 0; offset < len;) {
+        uint32_t n = len - offset;
+        n = (n < SWD_FLASH_VERIFY_BLOCK) ? n : SWD_FLASH_VERIFY_BLOCK;
+
+        uint32_t crc;
+        swd_err_t err = _swd_flash_target_crc(flash, addr + offset, n, &crc);
+        SWD_RETURN_IF_NON_OK(err);
+
+        if (crc != swd_crc32_update(0, &data[offset], n)) {
+            // Only a mismatching block is read back, to locate the first bad byte
+            uint32_t diff = 0;
+            err = swd_host_memory_compare(flash->host, addr + offset, &data[offset], n, equal,
+                                          &diff);
+            SWD_RETURN_IF_NON_OK(err);
+            if (!*equal) {
+                SWD_LOGE("Flash differs at 0x%08" PRIx32, addr + offset + diff);
+                if (bad_addr != NULL) {
+                    *bad_addr = addr + offset + diff;
+                }
+                return SWD_OK;
+            }
+            SWD_LOGW("CRC mismatch at 0x%08" PRIx32 " but the read back data matches",
+                     addr + offset);
+        }
+
+        offset += n;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_flash_finish(swd_flash_t *flash) {
+    SWD_ASSERT(flash != NULL);
+
+    return _swd_flash_enter(flash, SWD_FLASH_FNC_NONE);
+}
+
+void swd_flash_stub_algo(swd_flash_algo_t *algo, uint32_t base, uint32_t size) {
+    SWD_ASSERT(algo != NULL);
+
+    algo->code = _swd_flash_stub_code;
+    algo->code_size = sizeof(_swd_flash_stub_code);
+    algo->init = STUB_INIT;
+    algo->uninit = STUB_INIT;
+    algo->erase_sector = STUB_ERASE_SECTOR;
+    algo->erase_chip = SWD_FLASH_NO_FUNC;
+    algo->program_page = STUB_PROGRAM_PAGE;
+    algo->static_base = sizeof(_swd_flash_stub_code);
+    algo->flash_base = base;
+    algo->flash_size = size;
+    algo->sector_size = SWD_FLASH_STUB_SECTOR_SIZE;
+    algo->page_size = SWD_FLASH_STUB_PAGE_SIZE;
+    algo->erased_value = 0xFF;
+}
+
+swd_err_t _swd_flash_start(swd_flash_t *flash, uint32_t func, uint32_t r0, uint32_t r1,
+                           uint32_t r2) {
+    swd_host_call_t call = {
+        .entry = flash->_code + func,
+        .args = {r0, r1, r2, 0},
+        .sp = flash->_sp,
+        .trap = flash->_trap,
+        .sb = flash->_code + flash->algo.static_base,
+    };
+
+    return swd_host_call_start(flash->host, &call);
+}
+
+swd_err_t _swd_flash_wait(swd_flash_t *flash) {
+    uint32_t ret;
+    swd_err_t err = swd_host_call_wait(flash->host, flash->_trap, SWD_FLASH_MAX_POLLS, &ret);
+    SWD_RETURN_IF_NON_OK(err);
+
+    if (ret != 0) {
+        SWD_LOGE("Flash algorithm returned %" PRIu32, ret);
+        return SWD_FLASH_ALGO_FAILED;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_flash_call(swd_flash_t *flash, uint32_t func, uint32_t r0, uint32_t r1,
+                          uint32_t r2) {
+    swd_err_t err = _swd_flash_start(flash, func, r0, r1, r2);
+    SWD_RETURN_IF_NON_OK(err);
+
+    return _swd_flash_wait(flash);
+}
+
+swd_err_t _swd_flash_enter(swd_flash_t *flash, swd_flash_fnc_t fnc) {
+    if (flash->_fnc == fnc) {
+        return SWD_OK;
+    }
+
+    swd_err_t err;
+    if (flash->_fnc != SWD_FLASH_FNC_NONE) {
+        err = _swd_flash_call(flash, flash->algo.uninit, flash->_fnc, 0, 0);
+        SWD_RETURN_IF_NON_OK(err);
+        flash->_fnc = SWD_FLASH_FNC_NONE;
+    }
+
+    if (fnc != SWD_FLASH_FNC_NONE) {
+        // The clock argument is unused by most algorithms, 0 leaves it to their default
+        err = _swd_flash_call(flash, flash->algo.init, flash->algo.flash_base, 0, fnc);
+        SWD_RETURN_IF_NON_OK(err);
+        flash->_fnc = fnc;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_flash_target_crc(swd_flash_t *flash, uint32_t addr, uint32_t len, uint32_t *crc) {
+    // Some devices only map their flash for reads outside of the erase and program modes
+    swd_err_t err = _swd_flash_enter(flash, SWD_FLASH_FNC_VERIFY);
+    SWD_RETURN_IF_NON_OK(err);
+
+    return swd_crc32_target(&flash->_crc, addr, len, crc);
+}
+
+swd_err_t _swd_flash_upload(swd_flash_t *flash, uint32_t buf, uint32_t page_addr, uint32_t addr,
+                            const uint8_t *data, uint32_t len) {
+    swd_host_t *host = flash->host;
+    uint32_t page_size = flash->algo.page_size;
+    const uint8_t *erased = &flash->algo.erased_value;
+
+    // Overlap of the page with the data, relative to the page
+    uint64_t data_end = (uint64_t)addr + len;
+    uint64_t page_end = (uint64_t)page_addr + page_size;
+    uint32_t head = (addr > page_addr) ? addr - page_addr : 0;
+    uint32_t tail = (uint32_t)((data_end < page_end) ? data_end - page_addr : page_size);
+
+    swd_err_t err;
+    if (head > 0) {
+        err = swd_host_memory_fill(host, buf, head, erased, 1);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    err = swd_host_memory_write_byte_block(host, buf + head, &data[page_addr + head - addr],
+                                           tail - head, NULL);
+    SWD_RETURN_IF_NON_OK(err);
+
+    if (tail < page_size) {
+        err = swd_host_memory_fill(host, buf + tail, page_size - tail, erased, 1);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
\ No newline at end of file
@@ -0,0 +1,529 @@
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef SWD_GCOV_ENABLE_FILES
+#include <stdio.h>
+#endif // SWD_GCOV_ENABLE_FILES
+
+#include "swd_err.h"
+#include "swd_gcov.h"
+#include "swd_host.h"
+#include "swd_image.h"
+#include "swd_log.h"
+
+// .gcda records, see gcc/gcov-io.h
+#define GCOV_DATA_MAGIC ((uint32_t)0x67636461)
+#define GCOV_TAG_FUNCTION ((uint32_t)0x01000000)
+#define GCOV_TAG_COUNTER_BASE ((uint32_t)0x01A10000)
+#define GCOV_TAG_FOR_COUNTER(kind) (GCOV_TAG_COUNTER_BASE + ((uint32_t)(kind) << 17))
+#define GCOV_TAG_OBJECT_SUMMARY ((uint32_t)0xA1000000)
+
+// Counter kinds. GCC 11 to 13 have 8 of them, GCC 14 adds condition coverage as the 9th
+#define GCOV_COUNTER_ARCS (0)
+#define GCOV_COUNTER_V_TOPN (3)
+#define GCOV_COUNTER_V_INDIR (4)
+#define GCOV_MAX_COUNTERS (9)
+
+// In memory, a top-N counter is a total, a count and a pointer to a list of values
+#define GCOV_TOPN_MEM_COUNTERS (3)
+
+// Words of struct gcov_info and struct gcov_fn_info on a 32-bit target
+#define GCOV_INFO_MAX_WORDS (6 + GCOV_MAX_COUNTERS + 2)
+#define GCOV_FN_HDR_WORDS (4)
+
+// Bytes staged before handing them to the sink
+#define GCOV_OUT_BYTES (256)
+
+/*
+ * struct gcov_info of one object file
+ */
+typedef struct _swd_gcov_info_t {
+    uint32_t addr;
+    uint32_t version;
+    uint32_t stamp;
+    uint32_t checksum;
+    bool has_checksum;
+    uint32_t filename;
+    /*
+     * Bit per counter kind with a merge function, only those have counters
+     */
+    uint32_t merge;
+    uint32_t kinds;
+    uint32_t n_functions;
+    uint32_t functions;
+    /*
+     * Bytes per unit of record lengths: GCC 12 counts bytes, GCC 11 words
+     */
+    uint32_t unit;
+} _swd_gcov_info_t;
+
+/*
+ * struct gcov_fn_info, only used when the object owns the function (not a COMDAT copy)
+ */
+typedef struct _swd_gcov_fn_t {
+    bool owned;
+    uint32_t ident;
+    uint32_t lineno_checksum;
+    uint32_t cfg_checksum;
+    uint32_t num[GCOV_MAX_COUNTERS];
+    uint32_t values[GCOV_MAX_COUNTERS];
+} _swd_gcov_fn_t;
+
+/*
+ * Work buffer: the read list grows from the start, the counters from the end
+ */
+typedef struct _swd_gcov_work_t {
+    swd_host_iovec_t *iov;
+    uint32_t iov_cnt;
+    uint8_t *data;
+} _swd_gcov_work_t;
+
+typedef struct _swd_gcov_out_t {
+    swd_gcov_sink_t sink;
+    void *ctx;
+    const char *filename;
+    uint32_t offset;
+    uint32_t fill;
+    uint8_t buf[GCOV_OUT_BYTES];
+} _swd_gcov_out_t;
+
+uint32_t _swd_gcov_le32(const uint8_t *p);
+
+/*
+ * @brief Read the gcov_info at `addr` from the image
+ * @return SWD_TARGET_NOT_SUPPORTED for gcov versions older than GCC 11
+ */
+swd_err_t _swd_gcov_info_read(const swd_image_t *elf, uint32_t addr, _swd_gcov_info_t *info);
+
+/*
+ * @brief Read function `idx` of an object from the image
+ */
+swd_err_t _swd_gcov_fn_read(const swd_image_t *elf, const _swd_gcov_info_t *info, uint32_t idx,
+                            _swd_gcov_fn_t *fn);
+
+/*
+ * @brief Add the counter arrays of an object to the read list. `fits` is false, and the work
+ *          buffer left as it was, if they do not fit
+ */
+swd_err_t _swd_gcov_collect(const swd_image_t *elf, uint32_t addr, _swd_gcov_work_t *work,
+                            bool *fits);
+
+/*
+ * @brief Write the .gcda file of an object, taking its counters from the read list at `cursor`
+ */
+swd_err_t _swd_gcov_emit(const swd_image_t *elf, uint32_t addr, const _swd_gcov_work_t *work,
+                         uint32_t *cursor, swd_gcov_sink_t sink, void *_Nullable ctx,
+                         swd_gcov_stats_t *stats);
+
+swd_err_t _swd_gcov_put(_swd_gcov_out_t *out, const uint8_t *data, uint32_t len);
+swd_err_t _swd_gcov_put32(_swd_gcov_out_t *out, uint32_t value);
+swd_err_t _swd_gcov_flush(_swd_gcov_out_t *out);
+
+swd_err_t swd_gcov_dump(swd_host_t *host, const swd_image_t *elf, void *work, uint32_t work_size,
+                        swd_gcov_sink_t sink, void *_Nullable ctx,
+                        swd_gcov_stats_t *_Nullable stats) {
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(elf != NULL);
+    SWD_ASSERT(work != NULL);
+    SWD_ASSERT(sink != NULL);
+
+    swd_gcov_stats_t st = {0};
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    uint32_t list;
+    uint32_t list_size;
+    bool found;
+    err = swd_image_elf_section(elf, SWD_GCOV_INFO_SECTION, &found, &list, &list_size);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!found) {
+        uint32_t list_end;
+        err = swd_image_elf_symbol(elf, SWD_GCOV_INFO_START, &found, &list);
+        SWD_RETURN_IF_NON_OK(err);
+        if (found) {
+            err = swd_image_elf_symbol(elf, SWD_GCOV_INFO_END, &found, &list_end);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+        if (!found || list_end < list) {
+            SWD_LOGE("No gcov info list, build with -fprofile-info-section");
+            return SWD_TARGET_NOT_SUPPORTED;
+        }
+        list_size = list_end - list;
+    }
+
+    uint32_t n_infos = list_size / 4;
+    uint32_t first = 0;
+    while (first < n_infos) {
+        _swd_gcov_work_t batch = {
+            .iov = work,
+            .iov_cnt = 0,
+            .data = (uint8_t *)work + work_size,
+        };
+
+        // Take as many objects as the work buffer holds
+        uint32_t end = first;
+        for (bool fits = true; fits && end < n_infos;) {
+            uint8_t ptr[4];
+            err = swd_image_elf_read(elf, list + 4 * end, ptr, sizeof(ptr));
+            SWD_RETURN_IF_NON_OK(err);
+            err = _swd_gcov_collect(elf, _swd_gcov_le32(ptr), &batch, &fits);
+            SWD_RETURN_IF_NON_OK(err);
+            end += fits ? 1 : 0;
+        }
+        if (end == first) {
+            SWD_LOGE("The counters of an object do not fit in %" PRIu32 " bytes", work_size);
+            return SWD_HOST_TABLE_FULL;
+        }
+
+        if (batch.iov_cnt > 0) {
+            err = swd_host_memory_readv(host, batch.iov, batch.iov_cnt);
+            SWD_RETURN_IF_NON_OK(err);
+            st.reads++;
+        }
+
+        uint32_t cursor = 0;
+        for (uint32_t i = first; i < end; i++) {
+            uint8_t ptr[4];
+            err = swd_image_elf_read(elf, list + 4 * i, ptr, sizeof(ptr));
+            SWD_RETURN_IF_NON_OK(err);
+            err = _swd_gcov_emit(elf, _swd_gcov_le32(ptr), &batch, &cursor, sink, ctx, &st);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+        first = end;
+    }
+
+    SWD_LOGI("Wrote %" PRIu32 " gcda files, %" PRIu32 " counters in %" PRIu32 " reads",
+             st.files, st.counters, st.reads);
+    if (stats != NULL) {
+        *stats = st;
+    }
+
+    return SWD_OK;
+}
+
+#ifdef SWD_GCOV_ENABLE_FILES
+swd_err_t swd_gcov_sink_files(void *_Nullable ctx, const char *filename, uint32_t offset,
+                              const uint8_t *_Nullable data, uint32_t len) {
+    swd_gcov_files_t *files = ctx;
+    SWD_ASSERT(files != NULL);
+
+    if (len == 0) {
+        if (files->_file != NULL && fclose(files->_file) != 0) {
+            files->_file = NULL;
+            return SWD_ERR;
+        }
+        files->_file = NULL;
+        return SWD_OK;
+    }
+
+    if (offset == 0) {
+        if (files->_file != NULL) {
+            fclose(files->_file);
+        }
+
+        char path[SWD_GCOV_MAX_PATH];
+        int n = snprintf(path, sizeof(path), "%s%s",
+                         (files->prefix != NULL) ? files->prefix : "", filename);
+        if (n < 0 || (size_t)n >= sizeof(path)) {
+            SWD_LOGE("gcda path of %s is too long", filename);
+            return SWD_ERR;
+        }
+        files->_file = fopen(path, "wb");
+        if (files->_file == NULL) {
+            SWD_LOGE("Can not create %s", path);
+            return SWD_ERR;
+        }
+    }
+
+    if (files->_file == NULL || fwrite(data, 1, len, files->_file) != len) {
+        return SWD_ERR;
+    }
+
+    return SWD_OK;
+}
+#endif // SWD_GCOV_ENABLE_FILES
+
+uint32_t _swd_gcov_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+swd_err_t _swd_gcov_info_read(const swd_image_t *elf, uint32_t addr, _swd_gcov_info_t *info) {
+    uint8_t raw[4 * GCOV_INFO_MAX_WORDS];
+    swd_err_t err = swd_image_elf_read(elf, addr, raw, 4);
+    SWD_RETURN_IF_NON_OK(err);
+
+    // The version is the GCC release as text, ex. "B33*" for 13.3
+    info->addr = addr;
+    info->version = _swd_gcov_le32(raw);
+    uint32_t major = ((info->version >> 24) - 'A') * 10 + (((info->version >> 16) & 0xFF) - '0');
+    if ((info->version >> 24) < 'A' || major < 11) {
+        SWD_LOGE("gcov version 0x%08" PRIx32 " is older than GCC 11", info->version);
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+    info->has_checksum = major >= 12;
+    info->unit = (major >= 12) ? 4 : 1;
+    info->kinds = (major >= 14) ? 9 : 8;
+
+    // version, next, stamp, [checksum], filename, merge[kinds], n_functions, functions
+    uint32_t words = 3 + (info->has_checksum ? 1 : 0) + 1 + info->kinds + 2;
+    err = swd_image_elf_read(elf, addr, raw, 4 * words);
+    SWD_RETURN_IF_NON_OK(err);
+
+    const uint8_t *p = &raw[8];
+    info->stamp = _swd_gcov_le32(p);
+    p += 4;
+    info->checksum = 0;
+    if (info->has_checksum) {
+        info->checksum = _swd_gcov_le32(p);
+        p += 4;
+    }
+    info->filename = _swd_gcov_le32(p);
+    p += 4;
+    info->merge = 0;
+    for (uint32_t kind = 0; kind < info->kinds; kind++, p += 4) {
+        if (_swd_gcov_le32(p) != 0) {
+            info->merge |= (uint32_t)0x1 << kind;
+        }
+    }
+    info->n_functions = _swd_gcov_le32(p);
+    info->functions = _swd_gcov_le32(p + 4);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_gcov_fn_read(const swd_image_t *elf, const _swd_gcov_info_t *info, uint32_t idx,
+                            _swd_gcov_fn_t *fn) {
+    memset(fn, 0, sizeof(*fn));
+
+    uint8_t raw[4 * (GCOV_FN_HDR_WORDS + 2 * GCOV_MAX_COUNTERS)];
+    swd_err_t err = swd_image_elf_read(elf, info->functions + 4 * idx, raw, 4);
+    SWD_RETURN_IF_NON_OK(err);
+    uint32_t addr = _swd_gcov_le32(raw);
+    if (addr == 0) {
+        return SWD_OK;
+    }
+
+    // key, ident, lineno_checksum, cfg_checksum, then num and values of each merged kind
+    uint32_t words = GCOV_FN_HDR_WORDS;
+    for (uint32_t kind = 0; kind < info->kinds; kind++) {
+        words += (info->merge & ((uint32_t)0x1 << kind)) ? 2 : 0;
+    }
+    err = swd_image_elf_read(elf, addr, raw, 4 * words);
+    SWD_RETURN_IF_NON_OK(err);
+
+    // A COMDAT function is written by the object its key points to
+    fn->owned = _swd_gcov_le32(&raw[0]) == info->addr;
+    fn->ident = _swd_gcov_le32(&raw[4]);
+    fn->lineno_checksum = _swd_gcov_le32(&raw[8]);
+    fn->cfg_checksum = _swd_gcov_le32(&raw[12]);
+    const uint8_t *ctr = &raw[4 * GCOV_FN_HDR_WORDS];
+    for (uint32_t kind = 0; kind < info->kinds; kind++) {
+        if (info->merge & ((uint32_t)0x1 << kind)) {
+            fn->num[kind] = _swd_gcov_le32(ctr);
+            fn->values[kind] = _swd_gcov_le32(ctr + 4);
+            ctr += 8;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_gcov_collect(const swd_image_t *elf, uint32_t addr, _swd_gcov_work_t *work,
+                            bool *fits) {
+    _swd_gcov_info_t info;
+    swd_err_t err = _swd_gcov_info_read(elf, addr, &info);
+    SWD_RETURN_IF_NON_OK(err);
+
+    _swd_gcov_work_t saved = *work;
+    *fits = true;
+    for (uint32_t f = 0; f < info.n_functions; f++) {
+        _swd_gcov_fn_t fn;
+        err = _swd_gcov_fn_read(elf, &info, f, &fn);
+        SWD_RETURN_IF_NON_OK(err);
+        if (!fn.owned) {
+            continue;
+        }
+
+        for (uint32_t kind = 0; kind < info.kinds; kind++) {
+            if (fn.num[kind] == 0) {
+                continue;
+            }
+
+            uint64_t len = 8 * (uint64_t)fn.num[kind];
+            uint8_t *iov_end = (uint8_t *)&work->iov[work->iov_cnt + 1];
+            if (iov_end > work->data || (uint64_t)(work->data - iov_end) < len) {
+                *work = saved;
+                *fits = false;
+                return SWD_OK;
+            }
+
+            work->data -= len;
+            work->iov[work->iov_cnt] = (swd_host_iovec_t){
+                .addr = fn.values[kind],
+                .len = (uint32_t)len,
+                .buf = work->data,
+            };
+            work->iov_cnt++;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_gcov_emit(const swd_image_t *elf, uint32_t addr, const _swd_gcov_work_t *work,
+                         uint32_t *cursor, swd_gcov_sink_t sink, void *_Nullable ctx,
+                         swd_gcov_stats_t *stats) {
+    _swd_gcov_info_t info;
+    swd_err_t err = _swd_gcov_info_read(elf, addr, &info);
+    SWD_RETURN_IF_NON_OK(err);
+
+    char filename[SWD_GCOV_MAX_PATH];
+    uint32_t n = 0;
+    do {
+        if (n == sizeof(filename)) {
+            SWD_LOGE("gcda file name at 0x%08" PRIx32 " is too long", info.filename);
+            return SWD_IMAGE_INVALID;
+        }
+        err = swd_image_elf_read(elf, info.filename + n, (uint8_t *)&filename[n], 1);
+        SWD_RETURN_IF_NON_OK(err);
+    } while (filename[n++] != '\0');
+
+    // The object summary comes first, its maximum is over the arc counters
+    uint32_t pos = *cursor;
+    uint64_t sum_max = 0;
+    for (uint32_t f = 0; f < info.n_functions; f++) {
+        _swd_gcov_fn_t fn;
+        err = _swd_gcov_fn_read(elf, &info, f, &fn);
+        SWD_RETURN_IF_NON_OK(err);
+        for (uint32_t kind = 0; fn.owned && kind < info.kinds; kind++) {
+            if (fn.num[kind] == 0) {
+                continue;
+            }
+            const uint8_t *values = work->iov[pos++].buf;
+            for (uint32_t i = 0; kind == GCOV_COUNTER_ARCS && i < fn.num[kind]; i++) {
+                uint64_t value = _swd_gcov_le32(&values[8 * i]) |
+                                 ((uint64_t)_swd_gcov_le32(&values[8 * i + 4]) << 32);
+                sum_max = (value > sum_max) ? value : sum_max;
+            }
+        }
+    }
+
+    _swd_gcov_out_t out = {.sink = sink, .ctx = ctx, .filename = filename};
+    err = _swd_gcov_put32(&out, GCOV_DATA_MAGIC);
+    SWD_RETURN_IF_NON_OK(err);
+    err = _swd_gcov_put32(&out, info.version);
+    SWD_RETURN_IF_NON_OK(err);
+    err = _swd_gcov_put32(&out, info.stamp);
+    SWD_RETURN_IF_NON_OK(err);
+    if (info.has_checksum) {
+        err = _swd_gcov_put32(&out, info.checksum);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    uint32_t summary[4] = {GCOV_TAG_OBJECT_SUMMARY, 2 * info.unit, 1,
+                           (sum_max > UINT32_MAX) ? UINT32_MAX : (uint32_t)sum_max};
+    for (uint32_t i = 0; i < 4; i++) {
+        err = _swd_gcov_put32(&out, summary[i]);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    for (uint32_t f = 0; f < info.n_functions; f++) {
+        _swd_gcov_fn_t fn;
+        err = _swd_gcov_fn_read(elf, &info, f, &fn);
+        SWD_RETURN_IF_NON_OK(err);
+
+        uint32_t record[5] = {GCOV_TAG_FUNCTION, fn.owned ? 3 * info.unit : 0, fn.ident,
+                              fn.lineno_checksum, fn.cfg_checksum};
+        for (uint32_t i = 0; i < (fn.owned ? 5 : 2); i++) {
+            err = _swd_gcov_put32(&out, record[i]);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+        if (!fn.owned) {
+            continue;
+        }
+        stats->functions++;
+
+        for (uint32_t kind = 0; kind < info.kinds; kind++) {
+            if (!(info.merge & ((uint32_t)0x1 << kind))) {
+                continue;
+            }
+            uint32_t num = fn.num[kind];
+            const uint8_t *values = (num > 0) ? work->iov[(*cursor)++].buf : NULL;
+            stats->counters += num;
+
+            // Only the totals of top-N counters are kept, their value lists are host pointers
+            // of the target's libgcov allocator
+            bool topn = kind == GCOV_COUNTER_V_TOPN || kind == GCOV_COUNTER_V_INDIR;
+            uint32_t disk = topn ? 2 * (num / GCOV_TOPN_MEM_COUNTERS) : num;
+            err = _swd_gcov_put32(&out, GCOV_TAG_FOR_COUNTER(kind));
+            SWD_RETURN_IF_NON_OK(err);
+            err = _swd_gcov_put32(&out, disk * 2 * info.unit);
+            SWD_RETURN_IF_NON_OK(err);
+
+            if (!topn) {
+                err = _swd_gcov_put(&out, values, 8 * num);
+                SWD_RETURN_IF_NON_OK(err);
+                continue;
+            }
+            static const uint8_t no_values[8] = {0};
+            for (uint32_t i = 0; i < num / GCOV_TOPN_MEM_COUNTERS; i++) {
+                err = _swd_gcov_put(&out, &values[8 * GCOV_TOPN_MEM_COUNTERS * i], 8);
+                SWD_RETURN_IF_NON_OK(err);
+                err = _swd_gcov_put(&out, no_values, sizeof(no_values));
+                SWD_RETURN_IF_NON_OK(err);
+            }
+        }
+    }
+
+    err = _swd_gcov_flush(&out);
+    SWD_RETURN_IF_NON_OK(err);
+    stats->files++;
+
+    return sink(ctx, filename, out.offset, NULL, 0);
+}
+
+swd_err_t _swd_gcov_put(_swd_gcov_out_t *out, const uint8_t *data, uint32_t len) {
+    while (len > 0) {
+        uint32_t n = GCOV_OUT_BYTES - out->fill;
+        n = (len < n) ? len : n;
+        memcpy(&out->buf[out->fill], data, n);
+        out->fill += n;
+        data += n;
+        len -= n;
+
+        if (out->fill == GCOV_OUT_BYTES) {
+            swd_err_t err = _swd_gcov_flush(out);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_gcov_put32(_swd_gcov_out_t *out, uint32_t value) {
+    uint8_t word[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16),
+                       (uint8_t)(value >> 24)};
+    return _swd_gcov_put(out, word, sizeof(word));
+}
+
+swd_err_t _swd_gcov_flush(_swd_gcov_out_t *out) {
+    if (out->fill == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = out->sink(out->ctx, out->filename, out->offset, out->buf, out->fill);
+    SWD_RETURN_IF_NON_OK(err);
+    out->offset += out->fill;
+    out->fill = 0;
+
+    return SWD_OK;
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "swd_dap.h"
 #include "swd_dap_port.h"
@@ -16,6 +17,27 @@
 
 #define FPB_ADDR_ERROR ((uint32_t)-1)
 
+// Keep probe sequences short
+#define SW_BKPT_MAX_CNT ((SWD_HOST_SW_BKPT_SLOTS * 3) / 4)
+
+// CSW fields
+#define CSW_SIZE_MASK ((uint32_t)0x07)
+#define CSW_SIZE_BYTE ((uint32_t)0x00)
+#define CSW_SIZE_HALFWORD ((uint32_t)0x01)
+#define CSW_SIZE_WORD ((uint32_t)0x02)
+#define CSW_ADDRINC_MASK ((uint32_t)0x30)
+#define CSW_ADDRINC_SINGLE ((uint32_t)0x10)
+
+#define CACHE_LINE_BYTES (4 * SWD_HOST_MEM_CACHE_LINE_WORDS)
+
+// TAR auto-increment is only guaranteed within a 1KB block
+#define TAR_AUTOINC_BOUNDARY ((uint32_t)0x400)
+
+// Banked data registers map onto a 16-byte window of TAR
+#define BD_WINDOW_MASK ((uint32_t)0xF)
+
+#define TARGET_ADDR_SPACE_SIZE ((uint64_t)1 << 32)
+
 /*
  * All Host API function calls check if not null and not started
  */
@@ -37,6 +59,51 @@
         }                                                                                          \
     } while (0)
 
+/*
+ * Streaming state of the fill, compare and find helpers
+ */
+typedef struct {
+    const uint8_t *pattern;
+    uint32_t pattern_len;
+} _swd_host_fill_ctx_t;
+
+typedef struct {
+    const uint8_t *expected;
+    uint32_t mismatch;
+    bool is_equal;
+} _swd_host_compare_ctx_t;
+
+typedef struct {
+    const uint8_t *pattern;
+    uint32_t pattern_len;
+    // Horspool shift for every byte value
+    uint16_t shift[256];
+    // Tail of the previous chunk followed by the current one
+    uint8_t window[SWD_HOST_FIND_MAX_PATTERN - 1 + SWD_HOST_STREAM_CHUNK_BYTES];
+    uint32_t carry;
+    uint32_t match;
+    bool found;
+} _swd_host_find_ctx_t;
+
+/*
+ * Output state of the instruction tracer
+ */
+typedef swd_err_t (*_swd_host_trace_record_t)(void *ctx, uint32_t pc);
+
+typedef struct {
+    uint32_t *pcs;
+    uint32_t cnt;
+} _swd_host_trace_store_ctx_t;
+
+typedef struct {
+    swd_host_stream_consumer_t consumer;
+    void *_Nullable ctx;
+    uint64_t offset;
+    uint32_t prev;
+    uint32_t len;
+    uint8_t buf[SWD_HOST_STREAM_CHUNK_BYTES];
+} _swd_host_trace_encode_ctx_t;
+
 enum FPB_VERSION {
     FPB_VERSION_1 = 0x0,
     FPB_VERSION_2 = 0x1,
@@ -54,13 +121,254 @@ swd_err_t _swd_host_enable_arch_configs(swd_host_t *host);
 
 /*
  * @brief Read any detected architecture defined RO Debug attributes
- * @note Number of literal comparators is not implemented
  */
 swd_err_t _swd_host_detect_arch_configs(swd_host_t *host);
 
+/*
+ * @brief Enable trace and find the DWT comparators and their optional features
+ */
+swd_err_t _swd_host_dwt_detect(swd_host_t *host);
+
 swd_err_t _swd_host_dap_port_write_masked(swd_host_t *host, swd_dap_port_t port, uint32_t data,
                                           uint32_t mask);
 
+/*
+ * @brief Write TAR, skipping the transaction if TAR is already known to hold `addr`
+ */
+swd_err_t _swd_host_set_tar(swd_host_t *host, uint32_t addr);
+
+/*
+ * @brief Point TAR at the 16-byte window holding `addr` unless it already does. Returns the
+ *          banked data port which maps to `addr`
+ */
+swd_err_t _swd_host_set_window(swd_host_t *host, uint32_t addr, swd_dap_port_t *port);
+
+/*
+ * @brief Track TAR after `cnt` DRW transfers. Does nothing while auto-increment is disabled
+ */
+void _swd_host_tar_advance(swd_host_t *host, uint32_t cnt);
+
+/*
+ * @brief Enable or disable CSW.AddrInc. Uses the cached CSW value to avoid redundant writes
+ */
+swd_err_t _swd_host_set_addr_inc(swd_host_t *host, bool enable);
+
+/*
+ * @brief Pipelined word transfers through DRW. Auto-increment must already be enabled.
+ *          TAR is rewritten whenever the transfer crosses a 1KB boundary
+ */
+swd_err_t _swd_host_read_words(swd_host_t *host, uint32_t addr, uint32_t *buf, uint32_t cnt);
+swd_err_t _swd_host_write_words(swd_host_t *host, uint32_t addr, const uint32_t *buf,
+                                uint32_t cnt);
+
+/*
+ * @brief Write CSW unless the cached value already matches
+ */
+swd_err_t _swd_host_set_csw(swd_host_t *host, uint32_t csw);
+
+/*
+ * @brief Single byte or halfword transfers. The data is shifted in and out of its byte lane
+ * @note Leaves CSW.Size at word, so the banked data registers remain usable
+ */
+swd_err_t _swd_host_read_narrow(swd_host_t *host, uint32_t addr, uint8_t size, uint32_t *data);
+swd_err_t _swd_host_write_narrow(swd_host_t *host, uint32_t addr, uint8_t size, uint32_t data);
+
+/*
+ * @brief Transfer `cnt` bytes which all lie within the word holding `addr`. Regions with read
+ *          side effects are accessed with the narrowest width they allow, everything else
+ *          goes through a (read-modify-write) word access
+ */
+swd_err_t _swd_host_read_partial_word(swd_host_t *host, uint32_t addr, uint8_t *buf, uint32_t cnt);
+swd_err_t _swd_host_write_partial_word(swd_host_t *host, uint32_t addr, const uint8_t *buf,
+                                       uint32_t cnt);
+
+/*
+ * @brief Byte granular transfers. Auto-increment must already be enabled. The word aligned
+ *          middle is pipelined and the edges are handled by the partial word transfers.
+ *          If present, `cnt` accumulates the number of bytes transferred
+ */
+swd_err_t _swd_host_read_span(swd_host_t *host, uint32_t addr, uint8_t *buf, uint32_t len,
+                              uint32_t *_Nullable cnt);
+swd_err_t _swd_host_write_span(swd_host_t *host, uint32_t addr, const uint8_t *buf, uint32_t len,
+                               uint32_t *_Nullable cnt);
+
+/*
+ * @brief Stream callbacks of the fill, compare and find helpers
+ */
+swd_err_t _swd_host_fill_produce(void *ctx, uint64_t offset, uint8_t *data, uint32_t len);
+swd_err_t _swd_host_compare_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                    uint32_t len);
+swd_err_t _swd_host_find_consume(void *ctx, uint64_t offset, const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Length of the next streaming chunk at `addr`
+ */
+uint32_t _swd_host_stream_chunk_len(uint32_t addr, uint64_t remaining);
+
+/*
+ * @brief Host side cache of target memory. Only used for cacheable regions while the target
+ *          is known to be halted
+ */
+bool _swd_host_cache_usable(swd_host_t *host, uint32_t addr);
+swd_err_t _swd_host_cache_read_word(swd_host_t *host, uint32_t addr, uint32_t *data);
+void _swd_host_cache_invalidate_range(swd_host_t *host, uint32_t addr, uint32_t len);
+void _swd_host_cache_invalidate(swd_host_t *host);
+
+/*
+ * @brief Caches of the core (Cortex-M7). Changed memory is noted by line and, before the core
+ *          runs again, its D-cache lines are cleaned and invalidated and its I-cache lines
+ *          invalidated by address, or the whole caches when that takes fewer writes. Cleaning
+ *          publishes lines the host wrote through the D-cache, invalidating drops lines made
+ *          stale by writes which bypassed it, ex. flash programming
+ */
+swd_err_t _swd_host_cache_maint_detect(swd_host_t *host);
+void _swd_host_cache_maint_track(swd_host_t *host, uint32_t addr, uint32_t len);
+swd_err_t _swd_host_cache_maint_flush(swd_host_t *host);
+
+/*
+ * @brief Write the address of every noted line to the maintenance register `reg`
+ */
+swd_err_t _swd_host_cache_maint_lines(swd_host_t *host, uint32_t reg);
+
+/*
+ * @brief Clean and invalidate the whole D-cache by set and way
+ */
+swd_err_t _swd_host_cache_maint_dcache_all(swd_host_t *host);
+
+/*
+ * @brief Write `cnt` words to the same address in one pipelined transfer, as used for the
+ *          cache maintenance registers
+ */
+swd_err_t _swd_host_write_repeat(swd_host_t *host, uint32_t addr, const uint32_t *buf,
+                                 uint32_t cnt);
+
+/*
+ * @brief Write every remap table slot (unused ones as zero) and point FP_REMAP at the table
+ */
+swd_err_t _swd_host_patch_write_table(swd_host_t *host);
+
+/*
+ * @brief Program COMP, MASK and FUNCTION of a DWT comparator in one burst
+ */
+swd_err_t _swd_host_dwt_write_cmp(swd_host_t *host, uint32_t idx, uint32_t comp, uint32_t mask,
+                                  uint32_t func);
+
+/*
+ * @brief Lowest DWT comparator in `cmps`, the comparator count if there is none
+ */
+uint32_t _swd_host_dwt_first(swd_host_t *host, uint32_t cmps);
+
+/*
+ * @brief Read (and so clear) the MATCHED flags of every DWT comparator
+ */
+swd_err_t _swd_host_dwt_matched(swd_host_t *host, uint32_t *matched);
+
+/*
+ * @brief Called whenever the core is let go. Cached state of the target is dropped
+ */
+void _swd_host_target_resumed(swd_host_t *host);
+
+/*
+ * @brief Sort up to SWD_HOST_IOV_BATCH_SIZE segments by address into `order`
+ */
+void _swd_host_iov_sort(const swd_host_iovec_t *iov, uint16_t *order, uint32_t cnt);
+
+/*
+ * @brief Copy bytes between a word staging buffer holding [addr, addr + 4 * cnt) and every
+ *          segment of `order[first:last]` overlapping it
+ * @param bool direction of the copy. When true, the segments are filled from the words
+ */
+void _swd_host_iov_copy(const swd_host_iovec_t *iov, const uint16_t *order, uint32_t first,
+                        uint32_t last, uint32_t addr, uint32_t *words, uint32_t cnt,
+                        bool to_iov);
+
+/*
+ * @brief Write the `cnt` bytes at `addr` gathered from `order[first:last]`. All bytes must
+ *          lie within one word
+ */
+swd_err_t _swd_host_iov_write_partial(swd_host_t *host, const swd_host_iovec_t *iov,
+                                      const uint16_t *order, uint32_t first, uint32_t last,
+                                      uint32_t addr, uint32_t cnt);
+
+/*
+ * @brief Move one register through DCRSR/DCRDR, bypassing the register cache. A read also
+ *          gives the DHCSR value read along with DCRDR, if `dhcsr` is not NULL
+ */
+swd_err_t _swd_host_reg_transfer_read(swd_host_t *host, swd_target_register_t reg,
+                                      uint32_t *data, uint32_t *_Nullable dhcsr);
+swd_err_t _swd_host_reg_transfer_write(swd_host_t *host, swd_target_register_t reg,
+                                       uint32_t data);
+
+/*
+ * @brief Read a register from the register cache, filling it from the target if needed
+ */
+swd_err_t _swd_host_reg_cached_read(swd_host_t *host, swd_target_register_t reg,
+                                    uint32_t *data);
+
+/*
+ * @brief Registers whose value can change when `reg` is written
+ */
+swd_target_register_set_t _swd_host_reg_aliases(swd_target_register_t reg);
+
+/*
+ * @brief Remember the sticky DHCSR bits of a DHCSR read, reading DHCSR clears them
+ */
+void _swd_host_dhcsr_observe(swd_host_t *host, uint32_t dhcsr);
+
+/*
+ * @brief Make the event monitor poll right away and at its fastest rate
+ */
+void _swd_host_monitor_kick(swd_host_t *host);
+
+void _swd_host_monitor_dispatch(swd_host_t *host, swd_host_event_t event, uint32_t reason);
+
+/*
+ * @brief Write `cnt` comparators starting at FP_COMP`first` in one pipelined transfer. The shadow
+ *          only takes the new values once they are written
+ */
+swd_err_t _swd_host_fpb_write_bank(swd_host_t *host, uint32_t first, const uint32_t *comps,
+                                   uint32_t cnt);
+
+/*
+ * @brief Whether or not a software breakpoint can be placed at `addr`
+ */
+bool _swd_host_sw_bkpt_capable(swd_host_t *host, uint32_t addr);
+
+/*
+ * @brief Slot holding `addr` in the software breakpoint table, or the empty slot where it
+ *          would be inserted
+ */
+uint32_t _swd_host_sw_bkpt_probe(swd_host_t *host, uint32_t addr, bool *found);
+uint32_t _swd_host_sw_bkpt_hash(uint32_t addr);
+void _swd_host_sw_bkpt_delete(swd_host_t *host, uint32_t slot);
+
+/*
+ * @brief When the halted core sits on a software breakpoint, step it with the original
+ *          instruction in place and reinsert the breakpoint. `stepped` tells if that happened
+ */
+swd_err_t _swd_host_sw_bkpt_step_over(swd_host_t *host, uint32_t maskints, bool *stepped);
+
+/*
+ * @brief Whether an enabled breakpoint comparator covers the halfword at `addr`
+ */
+bool _swd_host_fpb_bkpt_at(swd_host_t *host, uint32_t addr);
+
+/*
+ * @brief Step engine of the tracers, `record` (if any) is called with the PC of every
+ *          instruction before it is stepped
+ */
+swd_err_t _swd_host_trace(swd_host_t *host, const swd_host_trace_cfg_t *cfg,
+                          _swd_host_trace_record_t _Nullable record, void *_Nullable ctx,
+                          uint32_t *cnt);
+swd_err_t _swd_host_trace_store(void *ctx, uint32_t pc);
+swd_err_t _swd_host_trace_encode(void *ctx, uint32_t pc);
+
+/*
+ * @brief Remove every software breakpoint whose address is not in `keep`
+ */
+swd_err_t _swd_host_sw_bkpt_remove_unless(swd_host_t *host, const uint32_t *_Nullable keep,
+                                          uint32_t keep_cnt);
+
 uint32_t _fpb_cmp_encode_bkpt(uint32_t addr, uint8_t fp_version);
 uint32_t _fpb_cmp_decode_bkpt(uint32_t cmp, uint8_t fp_version);
 
@@ -68,6 +376,46 @@ void swd_host_init(swd_host_t *host) {
     SWD_ASSERT(host != NULL);
 
     host->is_stopped = false;
+    host->_csw = 0;
+    host->_tar = 0;
+    host->_tar_valid = false;
+    host->_target_halted = false;
+    host->_has_fpu = false;
+    host->_regs_valid = 0;
+    host->_regs_dirty = 0;
+    _swd_host_cache_invalidate(host);
+
+    host->_dhcsr_sticky = 0;
+    host->_mon_cb = NULL;
+    host->_mon_ctx = NULL;
+    host->_mon_status = 0;
+    host->_mon_interval = SWD_HOST_MONITOR_MIN_INTERVAL;
+    host->_mon_next = 0;
+    host->_mon_poll_now = true;
+    host->_mon_stepping = false;
+
+    host->_region_cnt = 0;
+    swd_host_region_add_defaults(host);
+
+    for (uint32_t i = 0; i < SWD_HOST_SW_BKPT_SLOTS; i++) {
+        host->_sw_bkpts[i].used = false;
+    }
+    host->_sw_bkpt_cnt = 0;
+
+    host->_patch_mask = 0;
+    host->_remap_table = 0;
+    host->_remap_supported = false;
+
+    host->_dwt_cmp_cnt = 0;
+    host->_dwt_max_mask = 0;
+    host->_dwt_datav_mask = 0;
+    host->_watch_mask = 0;
+    host->_dwt_used = 0;
+
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    host->_cm_line = 0;
+    host->_cm_range_cnt = 0;
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
 }
 
 void swd_host_set_dap(swd_host_t *host, swd_dap_t *dap) {
@@ -85,6 +433,9 @@ swd_err_t swd_host_start(swd_host_t *host) {
     SWD_LOGI("Starting Host");
 
     host->is_stopped = false;
+    host->_tar_valid = false;
+    _swd_host_target_resumed(host);
+    _swd_host_monitor_kick(host);
     swd_err_t err = swd_dap_start(host->dap);
     if (err != SWD_OK) {
         SWD_LOGW("Host experienced an error starting the DAP: %s", swd_err_as_str(err));
@@ -124,6 +475,7 @@ swd_err_t swd_host_stop(swd_host_t *host) {
     SWD_ASSERT(host->dap != NULL);
 
     host->is_stopped = true;
+    _swd_host_target_resumed(host);
     swd_err_t err = swd_dap_stop(host->dap);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
@@ -135,7 +487,7 @@ swd_err_t swd_host_halt_target(swd_host_t *host) {
     SWD_HOST_CHECK_STARTED
 
     // Sent a halt signal via DHSCR
-    swd_err_t err = swd_host_memory_write_word(host, DHCSR, DBG_KEY | C_HALT | C_DEBUGEN);
+    swd_err_t err = swd_host_window_write(host, DHCSR, DBG_KEY | C_HALT | C_DEBUGEN);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     return SWD_OK;
@@ -152,6 +504,22 @@ swd_err_t swd_host_step_target(swd_host_t *host) {
         return SWD_TARGET_NOT_HALTED;
     }
 
+    // Staged registers have to reach the core before it runs
+    err = swd_host_registers_commit(host);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    _swd_host_target_resumed(host);
+    _swd_host_monitor_kick(host);
+    host->_mon_stepping = true;
+
+    // A software breakpoint under the PC is stepped with the original instruction in place
+    bool stepped;
+    err = _swd_host_sw_bkpt_step_over(host, 0, &stepped);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (stepped) {
+        return SWD_OK;
+    }
+
     // Special logging logic to indicate that a breakpoint was stepped over
 #ifdef SWD_LOG_LEVEL_INFO
     uint32_t pc;
@@ -160,8 +528,9 @@ swd_err_t swd_host_step_target(swd_host_t *host) {
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     // Send a step signal via DHSCR
-    err = swd_host_memory_write_word(host, DHCSR, DBG_KEY | C_STEP | C_DEBUGEN);
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_STEP | C_DEBUGEN);
     SWD_HOST_RETURN_IF_NON_OK(err);
+    _swd_host_target_resumed(host);
 
     err = swd_host_register_read(host, REG_DEBUG_RETURN_ADDRESS, &step_pc);
     SWD_HOST_RETURN_IF_NON_OK(err);
@@ -180,7 +549,7 @@ swd_err_t swd_host_step_target(swd_host_t *host) {
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     // Send a step signal via DHSCR
-    err = swd_host_memory_write_word(host, DHCSR, DBG_KEY | C_STEP | C_DEBUGEN);
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_STEP | C_DEBUGEN);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     // Reenable breakpoints
@@ -193,540 +562,1972 @@ swd_err_t swd_host_step_target(swd_host_t *host) {
 swd_err_t swd_host_continue_target(swd_host_t *host) {
     SWD_HOST_CHECK_STARTED
 
-    // Dont sent any signals to DHCSR to continue
-    swd_err_t err = swd_host_memory_write_word(host, DHCSR, DBG_KEY | C_DEBUGEN);
+    // Staged registers have to reach the core before it runs
+    swd_err_t err = swd_host_registers_commit(host);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_OK;
-}
-
-swd_err_t swd_host_reset_target(swd_host_t *host) {
-    SWD_HOST_CHECK_STARTED
-
-    swd_err_t err = swd_host_continue_target(host);
+    // Leave a software breakpoint under the PC without hitting it again
+    bool stepped;
+    err = _swd_host_sw_bkpt_step_over(host, 0, &stepped);
     SWD_HOST_RETURN_IF_NON_OK(err);
+    if (stepped) {
+        // The internal step is not a halt reason worth reporting
+        err = swd_host_memory_write_word(host, DFSR, DFSR_HALTED);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
 
-    // Signal to the external system to request a Local reset (core + peripherals reset)
-    err = swd_host_memory_write_word(host, AIRCR, VECTKEY | SYSRESETREQ);
+    // Dont sent any signals to DHCSR to continue
+    _swd_host_target_resumed(host);
+    _swd_host_monitor_kick(host);
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return err;
+    return SWD_OK;
 }
 
-swd_err_t swd_host_halt_reset_target(swd_host_t *host) {
+swd_err_t swd_host_trace_steps(swd_host_t *host, const swd_host_trace_cfg_t *cfg, uint32_t *pcs,
+                               uint32_t *cnt) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(cfg != NULL);
+    SWD_ASSERT(pcs != NULL || cfg->max_steps == 0);
 
-    // Ensure halting debug is enabled
-    swd_err_t err = swd_host_memory_write_word(host, DHCSR, DBG_KEY | C_DEBUGEN);
-    SWD_HOST_RETURN_IF_NON_OK(err);
-
-    // Get DEMCR to toggle bit between resets
-    uint32_t demcr;
-    err = swd_host_memory_read_word(host, DEMCR, &demcr);
-    SWD_HOST_RETURN_IF_NON_OK(err);
-
-    // Enable Reset Vector Catch
-    err = swd_host_memory_write_word(host, DEMCR, demcr | VC_CORERESET);
-    SWD_HOST_RETURN_IF_NON_OK(err);
-
-    // Signal to the external system to request a Local reset (core + peripherals reset)
-    err = swd_host_memory_write_word(host, AIRCR, VECTKEY | SYSRESETREQ);
-    SWD_HOST_RETURN_IF_NON_OK(err);
-
-    // Clear Reset Vector Catch bit
-    err = swd_host_memory_write_word(host, DEMCR, demcr & ~VC_CORERESET);
-    SWD_HOST_RETURN_IF_NON_OK(err);
-
-    return SWD_OK;
+    _swd_host_trace_store_ctx_t store = {.pcs = pcs, .cnt = 0};
+    return _swd_host_trace(host, cfg, _swd_host_trace_store, &store, cnt);
 }
 
-swd_err_t swd_host_is_target_halted(swd_host_t *host, bool *is_halted) {
+swd_err_t swd_host_trace_steps_encoded(swd_host_t *host, const swd_host_trace_cfg_t *cfg,
+                                       swd_host_stream_consumer_t consumer, void *_Nullable ctx,
+                                       uint32_t *cnt) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(cfg != NULL);
+    SWD_ASSERT(consumer != NULL);
 
-    uint32_t dhcsr;
-    swd_err_t err = swd_host_memory_read_word(host, DHCSR, &dhcsr);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+    _swd_host_trace_encode_ctx_t enc = {.consumer = consumer, .ctx = ctx};
+    swd_err_t err = _swd_host_trace(host, cfg, _swd_host_trace_encode, &enc, cnt);
 
-    *is_halted = dhcsr & S_HALTED;
-    return SWD_OK;
+    // Whatever was traced before an error is still handed out
+    if (enc.len > 0) {
+        swd_err_t flush_err = consumer(ctx, enc.offset, enc.buf, enc.len);
+        err = (err == SWD_OK) ? flush_err : err;
+    }
+
+    return err;
 }
 
-swd_err_t swd_host_memory_write_word(swd_host_t *host, uint32_t addr, uint32_t data) {
+swd_err_t swd_host_step_range(swd_host_t *host, uint32_t start, uint32_t end,
+                              uint32_t *_Nullable steps) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
 
-    if (addr & 0x3) {
-        SWD_LOGE("Word writes need to be word aligned");
+    // An empty range has no outside to stop on
+    if (start == end) {
         return SWD_TARGET_INVALID_ADDR;
     }
 
-    swd_err_t err = swd_dap_port_write(host->dap, AP_TAR, addr);
+    // Everything outside [start, end) is the wrapping range [end, start)
+    swd_host_trace_cfg_t cfg = {
+        .max_steps = SWD_HOST_STEP_RANGE_MAX_STEPS,
+        .stop_addr = end,
+        .stop_len = start - end,
+        .mask_ints = false,
+    };
+    uint32_t cnt;
+    swd_err_t err = _swd_host_trace(host, &cfg, NULL, NULL, &cnt);
+    if (steps != NULL) {
+        *steps = cnt;
+    }
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    err = swd_dap_port_write(host->dap, AP_DRW, data);
+    // The last step may have left the range right at the limit
+    uint32_t pc;
+    err = _swd_host_reg_cached_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
     SWD_HOST_RETURN_IF_NON_OK(err);
+    if (pc - start < end - start) {
+        SWD_LOGW("PC still at 0x%08" PRIx32 " after %" PRIu32 " steps", pc, cnt);
+        return SWD_HOST_STEP_LIMIT;
+    }
 
     return SWD_OK;
 }
 
-swd_err_t swd_host_memory_write_word_block(swd_host_t *host, uint32_t start_addr, uint32_t *data_buf, 
-                                           uint32_t bufsz, uint32_t* _Nullable w_cnt) {
+swd_err_t swd_host_run_to(swd_host_t *host, uint32_t addr, uint32_t max_polls) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
 
-    if (start_addr & 0x3) {
-        SWD_LOGE("Word writes need to be word aligned");
-        return SWD_TARGET_INVALID_ADDR;
+    bool exists;
+    _swd_host_sw_bkpt_probe(host, addr, &exists);
+
+    uint32_t encoded = FPB_ADDR_ERROR;
+    if (!(host->_fpb_version == FPB_VERSION_1 && addr >= SRAM_BASE_ADDR)) {
+        encoded = _fpb_cmp_encode_bkpt(addr, host->_fpb_version);
+    }
+    uint32_t free_idx = host->code_cmp_cnt;
+    for (uint32_t i = 0; i < host->code_cmp_cnt && !exists; i++) {
+        exists = encoded != FPB_ADDR_ERROR && host->_fp_comp[i] == encoded;
+        if (free_idx == host->code_cmp_cnt && !(host->_fp_comp[i] & ENABLE)) {
+            free_idx = i;
+        }
     }
 
-    // Enable Auto increment TAR
-    SWD_LOGD("Enabling auto-increment TAR");
-    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x10, 0x30);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+    // Borrow a comparator, or a software breakpoint when none can be used
+    swd_err_t err;
+    uint32_t borrowed = host->code_cmp_cnt;
+    bool borrowed_sw = false;
+    if (exists) {
+        SWD_LOGD("Breakpoint at 0x%08" PRIx32 " already exists", addr);
+    } else if (encoded != FPB_ADDR_ERROR && free_idx < host->code_cmp_cnt) {
+        err = _swd_host_fpb_write_bank(host, free_idx, &encoded, 1);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        borrowed = free_idx;
+    } else if (_swd_host_sw_bkpt_capable(host, addr)) {
+        err = swd_host_add_sw_breakpoints(host, &addr, 1);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        borrowed_sw = true;
+    } else {
+        SWD_LOGE("No breakpoint can be placed at 0x%08" PRIx32, addr);
+        return SWD_TARGET_NO_MORE_BKPT;
+    }
 
-    err = swd_dap_port_write(host->dap, AP_TAR, start_addr);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = swd_host_continue_target(host);
 
-    if (w_cnt != NULL) {
-        *w_cnt = 0;
+    bool is_halted = false;
+    for (uint32_t i = 0; i < max_polls && err == SWD_OK && !is_halted; i++) {
+        err = swd_host_is_target_halted(host, &is_halted);
     }
-    for (uint32_t i = 0; i < bufsz; i++) {
-        err = swd_dap_port_write(host->dap, AP_DRW, data_buf[i]);
-        if (err != SWD_OK) {
-            return err;
-        }
-        if (w_cnt != NULL) {
-            *w_cnt += 1;
-        }
+    if (err == SWD_OK && !is_halted) {
+        SWD_LOGW("Core did not reach 0x%08" PRIx32, addr);
+        err = swd_host_halt_target(host);
+        err = (err == SWD_OK) ? SWD_TARGET_NOT_HALTED : err;
     }
 
-    // Disable Auto increment TAR
-    SWD_LOGD("Disabling auto-increment TAR");
-    err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x00, 0x30);
+    // The borrowed breakpoint is given back whatever happened
+    swd_err_t release_err = SWD_OK;
+    if (borrowed < host->code_cmp_cnt) {
+        uint32_t disabled = 0x0;
+        release_err = _swd_host_fpb_write_bank(host, borrowed, &disabled, 1);
+    } else if (borrowed_sw) {
+        release_err = swd_host_remove_sw_breakpoints(host, &addr, 1);
+    }
+
+    return (err == SWD_OK) ? release_err : err;
+}
+
+swd_err_t swd_host_cycles_enable(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
+
+    uint32_t dwt_ctrl;
+    swd_err_t err = swd_host_memory_read_word(host, DWT_CTRL, &dwt_ctrl);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
+    if (!(dwt_ctrl & CYCCNTENA)) {
+        err = swd_host_memory_write_word(host, DWT_CTRL, dwt_ctrl | CYCCNTENA);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
     return SWD_OK;
 }
 
-swd_err_t swd_host_memory_write_byte_block(swd_host_t *host, uint32_t start_addr, uint8_t *data_buf,
-                                           uint32_t bufsz, uint32_t* _Nullable w_cnt) {
+swd_err_t swd_host_cycles_read(swd_host_t *host, uint32_t *cyccnt) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
 
-    // Enable Auto increment TAR
-    SWD_LOGD("Enabling auto-increment TAR");
-    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x10, 0x30);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+    return swd_host_memory_read_word(host, DWT_CYCCNT, cyccnt);
+}
 
-    uint32_t end_addr = start_addr + bufsz;
+swd_err_t swd_host_cycles_measure(swd_host_t *host, const swd_host_cycles_cfg_t *cfg,
+                                  swd_host_cycle_stats_t *stats) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(cfg != NULL);
+    SWD_ASSERT(stats != NULL);
 
-    if (w_cnt != NULL) {
-        *w_cnt = 0;
-    }
+    stats->cnt = 0;
+    stats->min = UINT32_MAX;
+    stats->max = 0;
+    stats->mean = 0;
 
-    uint8_t byte_offset = start_addr & 0x3;
-    if (byte_offset != 0x0) {
-        uint32_t word_buf;
-        uint32_t aligned_start = start_addr & ~0x3;
-        uint8_t shamt;
-        SWD_LOGD("Reading word 0x%08" PRIx32 " non word aligned byte transfer", aligned_start);
-        // Write the bytes which are non word aligned in the front
-        // Changes the buffer reference to a word aligned byte
-        err = swd_host_memory_read_word(host, aligned_start, &word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
+    swd_err_t err = swd_host_cycles_enable(host);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Both breakpoints stay armed for every iteration, only the ones added here are removed
+    uint32_t bkpts[SWD_HOST_MAX_FPB_COMPARATORS + SWD_HOST_SW_BKPT_SLOTS];
+    uint32_t bkpt_cnt;
+    err = swd_host_get_breakpoints(host, bkpts, sizeof(bkpts) / sizeof(bkpts[0]), &bkpt_cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-        for (uint8_t i = byte_offset; i < 4; i++) {
-            shamt = 8 * i;
-            word_buf = (word_buf & ~(0xFF << shamt)) | (*(data_buf++) << shamt);
+    const uint32_t addrs[2] = {cfg->start, cfg->end};
+    bool added[2] = {false, false};
+    for (uint32_t i = 0; i < 2 && err == SWD_OK; i++) {
+        bool exists = false;
+        for (uint32_t j = 0; j < bkpt_cnt && !exists; j++) {
+            exists = bkpts[j] == addrs[i];
         }
-        err = swd_host_memory_write_word(host, aligned_start, word_buf);
-        // Adjust new start address to write word aligned memory block
-        start_addr += (4 - byte_offset);
-        bufsz -= (4 - byte_offset);
-        if (w_cnt != NULL) {
-            *w_cnt += (4 - byte_offset);
+        if (!exists) {
+            err = swd_host_add_breakpoint(host, addrs[i]);
+            added[i] = err == SWD_OK;
         }
     }
 
+    uint64_t sum = 0;
+    uint32_t start_cnt = 0;
+    bool in_region = false;
+    bool is_halted;
+    err = (err == SWD_OK) ? swd_host_is_target_halted(host, &is_halted) : err;
+
+    while (err == SWD_OK && stats->cnt < cfg->iterations) {
+        if (is_halted) {
+            // Step off the breakpoint first, the step is part of the overhead
+            err = swd_host_step_target(host);
+            if (err == SWD_OK) {
+                err = swd_host_continue_target(host);
+            }
+            is_halted = false;
+        }
 
-    // Write as much data which is word aligned
-    swd_dap_port_write(host->dap, AP_TAR, start_addr);
-    for (uint32_t i = 0; i < bufsz / 4; i++) {
-        err = swd_dap_port_write(host->dap, AP_DRW,
-                                 data_buf[0] | (data_buf[1] << 8) | (data_buf[2] << 16) |
-                                     (data_buf[3] << 24));
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        data_buf += 4;
-        if (w_cnt != NULL) {
-            *w_cnt += 4;
+        for (uint32_t i = 0; i < cfg->max_polls && err == SWD_OK && !is_halted; i++) {
+            err = swd_host_is_target_halted(host, &is_halted);
+        }
+        if (err != SWD_OK) {
+            break;
+        }
+        if (!is_halted) {
+            SWD_LOGW("Core did not reach a breakpoint of the timed region");
+            err = swd_host_halt_target(host);
+            err = (err == SWD_OK) ? SWD_TARGET_NOT_HALTED : err;
+            break;
         }
-    }
 
-    byte_offset = end_addr & 0x3;
-    if (byte_offset != 0x0) {
-        // There isnt enough bytes at the end to make a full word
-        uint32_t word_buf;
-        uint32_t aligned_end = end_addr & ~0x3;
-        uint8_t shamt;
-        SWD_LOGD("Reading word 0x%08" PRIx32 " non word aligned byte transfer", aligned_end);
-        err = swd_host_memory_read_word(host, aligned_end, &word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        for (uint8_t i = 0; i < byte_offset; i++) {
-            shamt = 8 * i;
-            word_buf = (word_buf & ~(0xFF << shamt)) | (*(data_buf++) << shamt);
+        uint32_t pc;
+        uint32_t cyccnt;
+        err = swd_host_register_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
+        if (err == SWD_OK) {
+            err = swd_host_cycles_read(host, &cyccnt);
         }
-        err = swd_host_memory_write_word(host, aligned_end, word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        if (w_cnt != NULL) {
-            *w_cnt += byte_offset;
+        if (err != SWD_OK) {
+            break;
+        }
+
+        if (pc == cfg->start && in_region) {
+            // The end is never reached, ex. a recursive call or another exit path
+            SWD_LOGE("Timed region restarted before reaching 0x%08" PRIx32, cfg->end);
+            err = SWD_ERR;
+        } else if (pc == cfg->start) {
+            start_cnt = cyccnt;
+            in_region = true;
+        } else if (pc == cfg->end && in_region) {
+            uint32_t cycles = cyccnt - start_cnt;
+            cycles = (cycles > cfg->overhead) ? cycles - cfg->overhead : 0;
+            stats->min = (cycles < stats->min) ? cycles : stats->min;
+            stats->max = (cycles > stats->max) ? cycles : stats->max;
+            sum += cycles;
+            stats->cnt++;
+            in_region = false;
+        } else if (pc != cfg->end) {
+            SWD_LOGE("Core halted at 0x%08" PRIx32 " outside of the timed region", pc);
+            err = SWD_ERR;
         }
     }
 
+    for (uint32_t i = 0; i < 2; i++) {
+        if (added[i]) {
+            swd_err_t remove_err = swd_host_remove_breakpoint(host, addrs[i]);
+            err = (err == SWD_OK) ? remove_err : err;
+        }
+    }
 
-    // Disable Auto increment TAR
-    SWD_LOGD("Disabling auto-increment TAR");
-    err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x00, 0x30);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (stats->cnt > 0) {
+        stats->mean = (uint32_t)(sum / stats->cnt);
+    } else {
+        stats->min = 0;
+    }
 
-    return SWD_OK;
+    return err;
 }
 
-swd_err_t swd_host_memory_read_word(swd_host_t *host, uint32_t addr, uint32_t *data) {
+swd_err_t swd_host_call_start(swd_host_t *host, const swd_host_call_t *call) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(call != NULL);
 
-    if (addr & 0x3) {
-        SWD_LOGE("Word writes need to be word aligned");
-        return SWD_TARGET_INVALID_ADDR;
+    // The exception number has to keep matching the exceptions the NVIC has active
+    uint32_t xpsr;
+    swd_err_t err = swd_host_register_read(host, REG_XPSR, &xpsr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    for (uint32_t i = 0; i < 4 && err == SWD_OK; i++) {
+        err = swd_host_registers_stage(host, (swd_target_register_t)(REG_R0 + i), call->args[i]);
     }
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_R9, call->sb) : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_SP, call->sp) : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_LR, call->trap | 0x1) : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_DEBUG_RETURN_ADDRESS,
+                                                     call->entry & ~(uint32_t)0x1)
+                          : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_XPSR, XPSR_T | (xpsr & XPSR_IPSR))
+                          : err;
+    err = (err == SWD_OK) ? swd_host_registers_commit(host) : err;
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    swd_err_t err = swd_dap_port_write(host->dap, AP_TAR, addr);
+    // C_MASKINTS may only change while halted, the application's interrupts must stay quiet
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN | C_HALT | C_MASKINTS);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    err = swd_dap_port_read(host->dap, AP_DRW, data);
+    _swd_host_target_resumed(host);
+    _swd_host_monitor_kick(host);
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN | C_MASKINTS);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     return SWD_OK;
 }
 
-swd_err_t swd_host_memory_read_word_block(swd_host_t *host, uint32_t start_addr, uint32_t *data_buf,
-                                          uint32_t bufsz, uint32_t* _Nullable rd_cnt) {
+swd_err_t swd_host_call_wait(swd_host_t *host, uint32_t trap, uint32_t max_polls,
+                             uint32_t *_Nullable ret) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
 
-    if (start_addr & 0x3) {
-        SWD_LOGE("Word writes need to be word aligned");
-        return SWD_TARGET_INVALID_ADDR;
+    // One banked DHCSR read per poll, the TAR stays on the debug registers
+    uint32_t dhcsr = 0;
+    swd_err_t err = SWD_OK;
+    for (uint32_t i = 0; i < max_polls && err == SWD_OK; i++) {
+        err = swd_host_window_read(host, DHCSR, &dhcsr);
+        if (dhcsr & (S_HALTED | S_LOCKUP)) {
+            break;
+        }
     }
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    // Enable Auto increment TAR
-    SWD_LOGD("Enabling auto-increment TAR");
-    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x10, 0x30);
+    // Halting also unmasks the interrupts for whatever runs next
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN | C_HALT);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    err = swd_dap_port_write(host->dap, AP_TAR, start_addr);
+    // The memory cache is only used once DHCSR shows the core halted
+    bool is_halted;
+    err = swd_host_is_target_halted(host, &is_halted);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    if (rd_cnt != NULL) {
-        *rd_cnt = 0;
+    if (!(dhcsr & S_HALTED)) {
+        SWD_LOGW("Target function did not return");
+        return (dhcsr & S_LOCKUP) ? SWD_ERR : SWD_TARGET_NOT_HALTED;
     }
-    for (uint32_t i = 0; i < bufsz; i++) {
-        err = swd_dap_port_read(host->dap, AP_DRW, data_buf + i);
-        if (err != SWD_OK) {
-            SWD_LOGW("Read failed at data buffer index %" PRIu32, i);
-            return err;
-        }
-        if (rd_cnt != NULL) {
-            *rd_cnt += 1;
-        }
+
+    uint32_t pc;
+    err = swd_host_register_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (pc != (trap & ~(uint32_t)0x1)) {
+        SWD_LOGE("Target function halted at 0x%08" PRIx32 " instead of returning", pc);
+        return SWD_ERR;
     }
 
-    // Disable Auto increment TAR
-    SWD_LOGD("Disabling auto-increment TAR");
-    err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x00, 0x30);
+    // Returning to the trap is not a halt reason worth reporting
+    err = swd_host_memory_write_word(host, DFSR, DFSR_BKPT | DFSR_HALTED);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
+    if (ret != NULL) {
+        err = swd_host_register_read(host, REG_R0, ret);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
     return SWD_OK;
 }
 
-swd_err_t swd_host_memory_read_byte_block(swd_host_t *host, uint32_t start_addr, uint8_t *data_buf,
-                                          uint32_t bufsz, uint32_t* _Nullable rd_cnt) {
+swd_err_t swd_host_call(swd_host_t *host, const swd_host_call_t *call, uint32_t max_polls,
+                        uint32_t *_Nullable ret) {
     SWD_HOST_CHECK_STARTED
-    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(call != NULL);
 
-    // Enable Auto increment TAR
-    SWD_LOGD("Enabling auto-increment TAR");
-    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x10, 0x30);
+    swd_err_t err = swd_host_call_start(host, call);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    uint32_t end_addr = start_addr + bufsz;
-
-    if (rd_cnt != NULL) {
-        *rd_cnt = 0;
-    }
-
-    // Buffer for reads to be written to
-    uint32_t word_buf;
-    uint8_t byte_offset = start_addr & 0x3;
-    if (byte_offset != 0x0) {
-        uint8_t shamt;
-        err = swd_host_memory_read_word(host, start_addr & ~0x3, &word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        for (uint8_t i = byte_offset; i < 4; i++) {
-            shamt = 8 * i;
-            *(data_buf++) = (word_buf & (0xFF << shamt)) >> shamt;
-        }
-        start_addr += (4 - byte_offset);
-        bufsz -= (4 - byte_offset);
-        if (rd_cnt != NULL) {
-            *rd_cnt += (4 - byte_offset);
-        }
-    }
+    return swd_host_call_wait(host, call->trap, max_polls, ret);
+}
 
+swd_err_t swd_host_reset_target(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
 
-    err = swd_dap_port_write(host->dap, AP_TAR, start_addr);
+    swd_err_t err = swd_host_continue_target(host);
     SWD_HOST_RETURN_IF_NON_OK(err);
-    for (uint32_t i = 0; i < bufsz / 4; i++) {
-        uint8_t shamt;
-        err = swd_dap_port_read(host->dap, AP_DRW, &word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        for (uint8_t i = 0; i < 4; i++) {
-            shamt = 8 * i;
-            data_buf[i] = (word_buf & (0xFF << shamt)) >> shamt;
-        }
-        data_buf += 4;
-        if (rd_cnt != NULL) {
-            *rd_cnt += 4;
-        }
-    }
-
-    byte_offset = end_addr & 0x3;
-    if (byte_offset != 0x0) {
-        uint8_t shamt;
-        err = swd_host_memory_read_word(host, end_addr & ~0x3, &word_buf);
-        SWD_HOST_RETURN_IF_NON_OK(err);
-        for (uint32_t i = 0; i < byte_offset; i++) {
-            shamt = 8 * i;
-            *(data_buf++) = (word_buf & (0xFF << shamt)) >> shamt;
-        }
-        if (rd_cnt != NULL) {
-            *rd_cnt += byte_offset;
-        }
-    }
-
 
-    // Disable Auto increment TAR
-    SWD_LOGD("Disabling auto-increment TAR");
-    err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x00, 0x30);
+    // Signal to the external system to request a Local reset (core + peripherals reset)
+    err = swd_host_memory_write_word(host, AIRCR, VECTKEY | SYSRESETREQ);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_OK;
+    return err;
 }
 
-swd_err_t swd_host_register_read(swd_host_t *host, swd_target_register_t reg, uint32_t *data) {
+swd_err_t swd_host_halt_reset_target(swd_host_t *host) {
     SWD_HOST_CHECK_STARTED
 
-    bool is_halted;
-    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    // Ensure halting debug is enabled
+    _swd_host_target_resumed(host);
+    _swd_host_monitor_kick(host);
+    swd_err_t err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    if (!is_halted) {
-        return SWD_TARGET_NOT_HALTED;
-    }
+    // Get DEMCR to toggle bit between resets
+    uint32_t demcr;
+    err = swd_host_window_read(host, DEMCR, &demcr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    uint32_t regsel = swd_target_register_as_regsel(reg, true);
-    if (regsel == DCRSR_REGSEL_ERR) {
-        return SWD_HOST_INVALID_REGISTER;
-    }
-    err = swd_host_memory_write_word(host, DCRSR, regsel);
+    // Enable Reset Vector Catch
+    err = swd_host_window_write(host, DEMCR, demcr | VC_CORERESET);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    uint32_t dhcsr;
-    int32_t retry_count = REGRDY_READ_RETRY_CNT;
-    do {
-        err = swd_host_memory_read_word(host, DHCSR, &dhcsr);
-        SWD_HOST_RETURN_IF_NON_OK(err);
+    // Signal to the external system to request a Local reset (core + peripherals reset)
+    err = swd_host_memory_write_word(host, AIRCR, VECTKEY | SYSRESETREQ);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-        // Register is availible in DCRDR
-        if (dhcsr & S_REGRDY) {
-            err = swd_host_memory_read_word(host, DCRDR, data);
-            SWD_HOST_RETURN_IF_NON_OK(err);
-            return SWD_OK;
-        }
-    } while ((retry_count--) > 0);
+    // Clear Reset Vector Catch bit
+    err = swd_host_window_write(host, DEMCR, demcr & ~VC_CORERESET);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_ERR;
+    return SWD_OK;
 }
 
-swd_err_t swd_host_register_write(swd_host_t *host, swd_target_register_t reg, uint32_t data) {
+swd_err_t swd_host_is_target_halted(swd_host_t *host, bool *is_halted) {
     SWD_HOST_CHECK_STARTED
 
-    bool is_halted;
-    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    uint32_t dhcsr;
+    swd_err_t err = swd_host_window_read(host, DHCSR, &dhcsr);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    if (!is_halted) {
-        return SWD_TARGET_NOT_HALTED;
+    *is_halted = dhcsr & S_HALTED;
+    if (!*is_halted) {
+        _swd_host_target_resumed(host);
     }
+    host->_target_halted = *is_halted;
+    return SWD_OK;
+}
 
-    err = swd_host_memory_write_word(host, DCRDR, data);
-    SWD_HOST_RETURN_IF_NON_OK(err);
+swd_err_t swd_host_memory_write_word(swd_host_t *host, uint32_t addr, uint32_t data) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
 
-    uint32_t dhcsr;
-    uint32_t regsel = swd_target_register_as_regsel(reg, false);
-    if (regsel == DCRSR_REGSEL_ERR) {
-        return SWD_HOST_INVALID_REGISTER;
+    if (addr & 0x3) {
+        SWD_LOGE("Word writes need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
     }
-    int32_t retry_count = REGRDY_READ_RETRY_CNT;
-    do {
-        err = swd_host_memory_read_word(host, DHCSR, &dhcsr);
-        SWD_HOST_RETURN_IF_NON_OK(err);
 
-        // Register is availible in DCRDR
-        if (dhcsr & S_REGRDY) {
-            err = swd_host_memory_write_word(host, DCRSR, regsel);
-            SWD_HOST_RETURN_IF_NON_OK(err);
-            return SWD_OK;
-        }
-    } while ((retry_count--) > 0);
+    swd_err_t err = _swd_host_set_tar(host, addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_ERR;
+    _swd_host_cache_invalidate_range(host, addr, 4);
+    err = swd_dap_port_write(host->dap, AP_DRW, data);
+    if (err != SWD_OK) {
+        host->_tar_valid = false;
+        return err;
+    }
+    _swd_host_tar_advance(host, 1);
+
+    return SWD_OK;
 }
 
-swd_err_t swd_host_add_breakpoint(swd_host_t *host, uint32_t addr) {
+swd_err_t swd_host_memory_write_word_block(swd_host_t *host, uint32_t start_addr, uint32_t *data_buf, 
+                                           uint32_t bufsz, uint32_t* _Nullable w_cnt) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
 
-    if (host->_fpb_version == FPB_VERSION_1 && addr >= SRAM_BASE_ADDR) {
-        SWD_LOGW("FPB V1 does not breakpoint signals beyond the ROM reigon");
+    if (start_addr & 0x3) {
+        SWD_LOGE("Word writes need to be word aligned");
         return SWD_TARGET_INVALID_ADDR;
     }
 
-    // Scan all registers
-    // Find the first empty breakpoint to write to
-    // Find if the breakpoint exists
-    // Cry if there are no more breakpoints
-    swd_err_t err;
-    uint32_t fp_cmp_w_addr;
-    uint32_t fp_cmpn_addr;
-    uint32_t fp_cmpn_data;
-    uint32_t encoded_addr = _fpb_cmp_encode_bkpt(addr, host->_fpb_version);
-    bool valid_addr_found = false;
+    // Enable Auto increment TAR
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    if (encoded_addr == FPB_ADDR_ERROR) {
-        SWD_LOGE("Cannot encode 0x%08" PRIx32 " as a breakpoint address", addr);
-        return SWD_TARGET_INVALID_ADDR;
-    }
-    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
-        fp_cmpn_addr = FP_CMPN + (4 * i);
-        err = swd_host_memory_read_word(host, fp_cmpn_addr, &fp_cmpn_data);
-        SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_set_tar(host, start_addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-        // Find the first valid spot (a comparator which is disabled)
-        if (!valid_addr_found && ((fp_cmpn_data & 0x1) == 0)) {
-            valid_addr_found = true;
-            fp_cmp_w_addr = fp_cmpn_addr;
+    _swd_host_cache_invalidate_range(host, start_addr, 4 * bufsz);
+    if (w_cnt != NULL) {
+        *w_cnt = 0;
+    }
+    for (uint32_t i = 0; i < bufsz; i++) {
+        err = swd_dap_port_write(host->dap, AP_DRW, data_buf[i]);
+        if (err != SWD_OK) {
+            host->_tar_valid = false;
+            return err;
         }
-
-        if (fp_cmpn_data == encoded_addr) {
-            SWD_LOGI("Requested breakpoint address 0x%08" PRIx32 " already exists", addr);
-            return SWD_OK;
+        _swd_host_tar_advance(host, 1);
+        if (w_cnt != NULL) {
+            *w_cnt += 1;
         }
     }
 
-    if (!valid_addr_found) {
-        return SWD_TARGET_NO_MORE_BKPT;
-    }
-
-    err = swd_host_memory_write_word(host, fp_cmp_w_addr, encoded_addr);
+    // Disable Auto increment TAR
+    err = _swd_host_set_addr_inc(host, false);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
     return SWD_OK;
 }
 
-swd_err_t swd_host_remove_breakpoint(swd_host_t *host, uint32_t addr) {
+swd_err_t swd_host_memory_write_byte_block(swd_host_t *host, uint32_t start_addr,
+                                           const uint8_t *data_buf, uint32_t bufsz,
+                                           uint32_t* _Nullable w_cnt) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
 
-    if (host->_fpb_version == FPB_VERSION_1 && addr >= SRAM_BASE_ADDR) {
-        SWD_LOGW("FPB V1 does not breakpoint signals beyond the ROM reigon");
-        return SWD_TARGET_INVALID_ADDR;
-    }
+    // Enable Auto increment TAR
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    swd_err_t err;
-    uint32_t fp_cmp_addr;
-    uint32_t fp_cmp_data;
-    uint32_t encoded = _fpb_cmp_encode_bkpt(addr, host->_fpb_version);
-    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
-        fp_cmp_addr = FP_CMPN + (4 * i);
-        err = swd_host_memory_read_word(host, fp_cmp_addr, &fp_cmp_data);
-        SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_write_span(host, start_addr, data_buf, bufsz, w_cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-        // Delete if match
-        if (fp_cmp_data == encoded) {
-            err = swd_host_memory_write_word(host, fp_cmp_addr, 0x0);
-            SWD_HOST_RETURN_IF_NON_OK(err);
-            return SWD_OK;
-        }
-    }
+    // Disable Auto increment TAR
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_TARGET_INVALID_ADDR;
+    return SWD_OK;
 }
 
-swd_err_t swd_host_clear_breakpoints(swd_host_t *host) {
+swd_err_t swd_host_memory_read_word(swd_host_t *host, uint32_t addr, uint32_t *data) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
 
-    swd_err_t err;
-    uint32_t addr;
-    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
-        addr = FP_CMPN + (4 * i);
-        err = swd_host_memory_write_word(host, addr, 0x0);
-        if (err != SWD_OK) {
-            SWD_LOGW("Could not clear breakpoint at address 0x%08" PRIx32, addr);
-        }
+    if (addr & 0x3) {
+        SWD_LOGE("Word writes need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
     }
 
-    return SWD_OK;
-}
+    if (_swd_host_cache_usable(host, addr)) {
+        return _swd_host_cache_read_word(host, addr, data);
+    }
 
-swd_err_t swd_host_get_breakpoint_count(swd_host_t *host, uint32_t *bkpt_cnt) {
-    SWD_HOST_CHECK_STARTED
+    swd_err_t err = _swd_host_set_tar(host, addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    *bkpt_cnt = host->code_cmp_cnt;
+    err = swd_dap_port_read(host->dap, AP_DRW, data);
+    if (err != SWD_OK) {
+        host->_tar_valid = false;
+        return err;
+    }
+    _swd_host_tar_advance(host, 1);
 
     return SWD_OK;
 }
 
-swd_err_t swd_host_get_breakpoints(swd_host_t *host, uint32_t *buf, uint32_t bufsz,
-                                   uint32_t *rdcnt) {
+swd_err_t swd_host_memory_read_word_block(swd_host_t *host, uint32_t start_addr, uint32_t *data_buf,
+                                          uint32_t bufsz, uint32_t* _Nullable rd_cnt) {
     SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
 
-    if (bufsz < host->code_cmp_cnt) {
-        SWD_LOGW("Less space was provided than the maximum number of possible breakpoints. Given: "
-                 "%" PRIu32 ", Possible: %" PRIu8,
-                 bufsz, host->code_cmp_cnt);
+    if (start_addr & 0x3) {
+        SWD_LOGE("Word writes need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
     }
-    bufsz = (bufsz < host->code_cmp_cnt) ? bufsz : host->code_cmp_cnt;
-
-    *rdcnt = 0;
-    swd_err_t err;
-    uint32_t fp_cmp_addr;
-    uint32_t fp_cmp_data;
-    uint32_t decoded;
-    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
-        fp_cmp_addr = FP_CMPN + (4 * i);
-        err = swd_host_memory_read_word(host, fp_cmp_addr, &fp_cmp_data);
-        SWD_HOST_RETURN_IF_NON_OK(err);
 
-        decoded = _fpb_cmp_decode_bkpt(fp_cmp_data, host->_fpb_version);
-        if (decoded == FPB_ADDR_ERROR) {
-            SWD_LOGW("Issue decoded comparator address at 0x%08" PRIx32, fp_cmp_addr);
-        } else if (decoded != 0x0) {
-            buf[(*rdcnt)++] = decoded;
-        }
-    }
+    // Enable Auto increment TAR
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-    return SWD_OK;
-}
+    err = _swd_host_set_tar(host, start_addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
 
-swd_err_t _swd_host_setup_dap_configs(swd_host_t *host) {
+    if (rd_cnt != NULL) {
+        *rd_cnt = 0;
+    }
+    for (uint32_t i = 0; i < bufsz; i++) {
+        err = swd_dap_port_read(host->dap, AP_DRW, data_buf + i);
+        if (err != SWD_OK) {
+            SWD_LOGW("Read failed at data buffer index %" PRIu32, i);
+            host->_tar_valid = false;
+            return err;
+        }
+        _swd_host_tar_advance(host, 1);
+        if (rd_cnt != NULL) {
+            *rd_cnt += 1;
+        }
+    }
+
+    // Disable Auto increment TAR
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_read_byte_block(swd_host_t *host, uint32_t start_addr, uint8_t *data_buf,
+                                          uint32_t bufsz, uint32_t* _Nullable rd_cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+
+    // Enable Auto increment TAR
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = _swd_host_read_span(host, start_addr, data_buf, bufsz, rd_cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Disable Auto increment TAR
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_read_repeat(swd_host_t *host, uint32_t addr, uint32_t *data_buf,
+                                      uint32_t cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+
+    if (addr & 0x3) {
+        SWD_LOGE("Word reads need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_err_t err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = _swd_host_set_tar(host, addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = swd_dap_port_read_block(host->dap, AP_DRW, data_buf, cnt);
+    if (err != SWD_OK) {
+        SWD_LOGW("Repeated read of 0x%08" PRIx32 " failed", addr);
+        host->_tar_valid = false;
+        return err;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_read_stream(swd_host_t *host, uint32_t start_addr, uint64_t len,
+                                      swd_host_stream_consumer_t consumer,
+                                      swd_host_stream_progress_t _Nullable progress,
+                                      void *_Nullable ctx, uint64_t *_Nullable rd_cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(consumer != NULL);
+
+    uint32_t buf[SWD_HOST_STREAM_CHUNK_BYTES / 4];
+    uint64_t done = 0;
+
+    if (rd_cnt != NULL) {
+        *rd_cnt = 0;
+    }
+    if ((uint64_t)start_addr + len > TARGET_ADDR_SPACE_SIZE) {
+        SWD_LOGE("Stream of %" PRIu64 " bytes at 0x%08" PRIx32 " is past the address space",
+                 len, start_addr);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    while (done < len) {
+        uint32_t addr = start_addr + (uint32_t)done;
+        uint32_t n = _swd_host_stream_chunk_len(addr, len - done);
+
+        err = _swd_host_read_span(host, addr, (uint8_t *)buf, n, NULL);
+        if (err != SWD_OK) {
+            break;
+        }
+        err = consumer(ctx, done, (uint8_t *)buf, n);
+        if (err != SWD_OK) {
+            break;
+        }
+
+        done += n;
+        if (rd_cnt != NULL) {
+            *rd_cnt = done;
+        }
+        if (progress != NULL && !progress(ctx, done, len) && done < len) {
+            SWD_LOGI("Stream read cancelled after %" PRIu64 " bytes", done);
+            err = SWD_HOST_XFER_CANCELLED;
+            break;
+        }
+    }
+
+    // Disable Auto increment TAR
+    swd_err_t inc_err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return inc_err;
+}
+
+swd_err_t swd_host_memory_write_stream(swd_host_t *host, uint32_t start_addr, uint64_t len,
+                                       swd_host_stream_producer_t producer,
+                                       swd_host_stream_progress_t _Nullable progress,
+                                       void *_Nullable ctx, uint64_t *_Nullable w_cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(producer != NULL);
+
+    uint32_t buf[SWD_HOST_STREAM_CHUNK_BYTES / 4];
+    uint64_t done = 0;
+
+    if (w_cnt != NULL) {
+        *w_cnt = 0;
+    }
+    if ((uint64_t)start_addr + len > TARGET_ADDR_SPACE_SIZE) {
+        SWD_LOGE("Stream of %" PRIu64 " bytes at 0x%08" PRIx32 " is past the address space",
+                 len, start_addr);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    while (done < len) {
+        uint32_t addr = start_addr + (uint32_t)done;
+        uint32_t n = _swd_host_stream_chunk_len(addr, len - done);
+        uint32_t written = 0;
+
+        err = producer(ctx, done, (uint8_t *)buf, n);
+        if (err != SWD_OK) {
+            break;
+        }
+        err = _swd_host_write_span(host, addr, (uint8_t *)buf, n, &written);
+
+        done += written;
+        if (w_cnt != NULL) {
+            *w_cnt = done;
+        }
+        if (err != SWD_OK) {
+            break;
+        }
+        if (progress != NULL && !progress(ctx, done, len) && done < len) {
+            SWD_LOGI("Stream write cancelled after %" PRIu64 " bytes", done);
+            err = SWD_HOST_XFER_CANCELLED;
+            break;
+        }
+    }
+
+    // Disable Auto increment TAR
+    swd_err_t inc_err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return inc_err;
+}
+
+swd_err_t swd_host_memory_fill(swd_host_t *host, uint32_t start_addr, uint32_t len,
+                               const uint8_t *pattern, uint32_t pattern_len) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(pattern != NULL);
+    SWD_ASSERT(pattern_len > 0);
+
+    _swd_host_fill_ctx_t ctx = {.pattern = pattern, .pattern_len = pattern_len};
+    return swd_host_memory_write_stream(host, start_addr, len, _swd_host_fill_produce, NULL, &ctx,
+                                        NULL);
+}
+
+swd_err_t swd_host_memory_compare(swd_host_t *host, uint32_t start_addr, const uint8_t *expected,
+                                  uint32_t len, bool *is_equal, uint32_t *_Nullable mismatch) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(expected != NULL);
+    SWD_ASSERT(is_equal != NULL);
+
+    _swd_host_compare_ctx_t ctx = {.expected = expected, .mismatch = 0, .is_equal = true};
+    swd_err_t err = swd_host_memory_read_stream(host, start_addr, len, _swd_host_compare_consume,
+                                                NULL, &ctx, NULL);
+    // The consumer cancels the stream on the first difference
+    if (err != SWD_OK && !(err == SWD_HOST_XFER_CANCELLED && !ctx.is_equal)) {
+        return err;
+    }
+
+    *is_equal = ctx.is_equal;
+    if (mismatch != NULL && !ctx.is_equal) {
+        *mismatch = ctx.mismatch;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_find(swd_host_t *host, uint32_t start_addr, uint32_t len,
+                               const uint8_t *pattern, uint32_t pattern_len, bool *found,
+                               uint32_t *_Nullable match_addr) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(pattern != NULL);
+    SWD_ASSERT(found != NULL);
+
+    if (pattern_len == 0 || pattern_len > SWD_HOST_FIND_MAX_PATTERN) {
+        SWD_LOGE("Pattern length %" PRIu32 " is not supported", pattern_len);
+        return SWD_ERR;
+    }
+
+    *found = false;
+    if (pattern_len > len) {
+        return SWD_OK;
+    }
+
+    _swd_host_find_ctx_t ctx = {.pattern = pattern, .pattern_len = pattern_len};
+    for (uint32_t i = 0; i < 256; i++) {
+        ctx.shift[i] = pattern_len;
+    }
+    for (uint32_t i = 0; i + 1 < pattern_len; i++) {
+        ctx.shift[pattern[i]] = pattern_len - 1 - i;
+    }
+
+    swd_err_t err = swd_host_memory_read_stream(host, start_addr, len, _swd_host_find_consume,
+                                                NULL, &ctx, NULL);
+    // The consumer cancels the stream on the first match
+    if (err != SWD_OK && !(err == SWD_HOST_XFER_CANCELLED && ctx.found)) {
+        return err;
+    }
+
+    *found = ctx.found;
+    if (match_addr != NULL && ctx.found) {
+        *match_addr = start_addr + ctx.match;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_readv(swd_host_t *host, const swd_host_iovec_t *iov, uint32_t iovcnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(iov != NULL || iovcnt == 0);
+
+    uint16_t order[SWD_HOST_IOV_BATCH_SIZE];
+    uint32_t chunk[SWD_HOST_XFER_CHUNK_WORDS];
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    for (uint32_t base = 0; base < iovcnt; base += SWD_HOST_IOV_BATCH_SIZE) {
+        uint32_t n = iovcnt - base;
+        n = (n < SWD_HOST_IOV_BATCH_SIZE) ? n : SWD_HOST_IOV_BATCH_SIZE;
+        _swd_host_iov_sort(iov + base, order, n);
+
+        uint32_t i = 0;
+        while (i < n) {
+            const swd_host_iovec_t *seg = &iov[base + order[i]];
+            if (seg->len == 0) {
+                i++;
+                continue;
+            }
+
+            // Registers with read side effects are only read exactly as requested
+            const swd_host_region_t *region = swd_host_region_find(host, seg->addr);
+            if (region != NULL && region->read_side_effects) {
+                err = _swd_host_read_span(host, seg->addr, seg->buf, seg->len, NULL);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                i++;
+                continue;
+            }
+
+            // Grow the run while the next segment starts close enough to its end
+            uint64_t run_start = seg->addr & ~0x3;
+            uint64_t run_end = ((uint64_t)seg->addr + seg->len + 3) & ~(uint64_t)0x3;
+            uint32_t j = i + 1;
+            for (; j < n; j++) {
+                const swd_host_iovec_t *next = &iov[base + order[j]];
+                if (next->addr > run_end + SWD_HOST_IOV_COALESCE_GAP) {
+                    break;
+                }
+                // Reading through a gap is only safe within the same region
+                if (swd_host_region_find(host, next->addr) != region) {
+                    break;
+                }
+                uint64_t next_end = ((uint64_t)next->addr + next->len + 3) & ~(uint64_t)0x3;
+                run_end = (next_end > run_end) ? next_end : run_end;
+            }
+
+            SWD_LOGD("readv run 0x%08" PRIx32 " - 0x%08" PRIx32 " covers %" PRIu32 " segments",
+                     (uint32_t)run_start, (uint32_t)(run_end - 1), j - i);
+            for (uint64_t addr = run_start; addr < run_end;) {
+                uint64_t words = (run_end - addr) / 4;
+                words = (words < SWD_HOST_XFER_CHUNK_WORDS) ? words : SWD_HOST_XFER_CHUNK_WORDS;
+                err = _swd_host_read_words(host, (uint32_t)addr, chunk, (uint32_t)words);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                _swd_host_iov_copy(iov + base, order, i, j, (uint32_t)addr, chunk,
+                                   (uint32_t)words, true);
+                addr += words * 4;
+            }
+            i = j;
+        }
+    }
+
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_memory_writev(swd_host_t *host, const swd_host_iovec_t *iov, uint32_t iovcnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+    SWD_ASSERT(iov != NULL || iovcnt == 0);
+
+    uint16_t order[SWD_HOST_IOV_BATCH_SIZE];
+    uint32_t chunk[SWD_HOST_XFER_CHUNK_WORDS];
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    for (uint32_t base = 0; base < iovcnt; base += SWD_HOST_IOV_BATCH_SIZE) {
+        uint32_t n = iovcnt - base;
+        n = (n < SWD_HOST_IOV_BATCH_SIZE) ? n : SWD_HOST_IOV_BATCH_SIZE;
+        _swd_host_iov_sort(iov + base, order, n);
+
+        uint32_t i = 0;
+        while (i < n) {
+            const swd_host_iovec_t *seg = &iov[base + order[i]];
+            if (seg->len == 0) {
+                i++;
+                continue;
+            }
+
+            // Only merge segments which leave no hole, gaps must not be written
+            uint64_t run_start = seg->addr;
+            uint64_t run_end = (uint64_t)seg->addr + seg->len;
+            uint32_t j = i + 1;
+            for (; j < n; j++) {
+                const swd_host_iovec_t *next = &iov[base + order[j]];
+                if (next->addr > run_end) {
+                    break;
+                }
+                uint64_t next_end = (uint64_t)next->addr + next->len;
+                run_end = (next_end > run_end) ? next_end : run_end;
+            }
+
+            // Leading bytes up to the first word boundary
+            uint64_t addr = run_start;
+            uint64_t head = (4 - (run_start & 0x3)) & 0x3;
+            head = (head < run_end - run_start) ? head : run_end - run_start;
+            if (head > 0) {
+                err = _swd_host_iov_write_partial(host, iov + base, order, i, j, (uint32_t)addr,
+                                                  (uint32_t)head);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                addr += head;
+            }
+
+            while (run_end - addr >= 4) {
+                uint64_t words = (run_end - addr) / 4;
+                words = (words < SWD_HOST_XFER_CHUNK_WORDS) ? words : SWD_HOST_XFER_CHUNK_WORDS;
+                _swd_host_iov_copy(iov + base, order, i, j, (uint32_t)addr, chunk,
+                                   (uint32_t)words, false);
+                err = _swd_host_write_words(host, (uint32_t)addr, chunk, (uint32_t)words);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                addr += words * 4;
+            }
+
+            if (addr < run_end) {
+                err = _swd_host_iov_write_partial(host, iov + base, order, i, j, (uint32_t)addr,
+                                                  (uint32_t)(run_end - addr));
+                SWD_HOST_RETURN_IF_NON_OK(err);
+            }
+            i = j;
+        }
+    }
+
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_region_add(swd_host_t *host, const swd_host_region_t *region) {
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(region != NULL);
+
+    if (region->end < region->start) {
+        SWD_LOGE("Region 0x%08" PRIx32 " - 0x%08" PRIx32 " is empty", region->start,
+                 region->end);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+    if (host->_region_cnt >= SWD_HOST_MAX_REGIONS) {
+        SWD_LOGW("No more space for memory regions. Increase SWD_HOST_MAX_REGIONS");
+        return SWD_HOST_TABLE_FULL;
+    }
+
+    // Keep the table sorted by start address
+    uint32_t i = host->_region_cnt;
+    while (i > 0 && host->_regions[i - 1].start > region->start) {
+        i--;
+    }
+    if ((i > 0 && host->_regions[i - 1].end >= region->start) ||
+        (i < host->_region_cnt && host->_regions[i].start <= region->end)) {
+        SWD_LOGE("Region 0x%08" PRIx32 " - 0x%08" PRIx32 " overlaps an existing region",
+                 region->start, region->end);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    for (uint32_t j = host->_region_cnt; j > i; j--) {
+        host->_regions[j] = host->_regions[j - 1];
+    }
+    host->_regions[i] = *region;
+    host->_region_cnt++;
+
+    _swd_host_cache_invalidate(host);
+
+    return SWD_OK;
+}
+
+void swd_host_memory_changed(swd_host_t *host, uint32_t start_addr, uint32_t len) {
+    SWD_ASSERT(host != NULL);
+
+    _swd_host_cache_invalidate_range(host, start_addr, len);
+}
+
+void swd_host_region_clear(swd_host_t *host) {
+    SWD_ASSERT(host != NULL);
+
+    host->_region_cnt = 0;
+    _swd_host_cache_invalidate(host);
+}
+
+void swd_host_region_add_defaults(swd_host_t *host) {
+    SWD_ASSERT(host != NULL);
+
+    static const swd_host_region_t defaults[] = {
+        {CODE_BASE_ADDR, CODE_END_ADDR, SWD_REGION_FLASH, SWD_REGION_ACCESS_ANY, true, false},
+        {SRAM_BASE_ADDR, SRAM_END_ADDR, SWD_REGION_RAM, SWD_REGION_ACCESS_ANY, true, false},
+        {PERIPH_BASE_ADDR, PERIPH_END_ADDR, SWD_REGION_PERIPHERAL, SWD_REGION_ACCESS_ANY, false,
+         true},
+        {EXT_RAM_BASE_ADDR, EXT_RAM_END_ADDR, SWD_REGION_RAM, SWD_REGION_ACCESS_ANY, true, false},
+        {EXT_DEV_BASE_ADDR, EXT_DEV_END_ADDR, SWD_REGION_PERIPHERAL, SWD_REGION_ACCESS_ANY, false,
+         true},
+        {PPB_BASE_ADDR, PPB_END_ADDR, SWD_REGION_PPB, SWD_REGION_ACCESS_WORD, false, true},
+        {VENDOR_BASE_ADDR, VENDOR_END_ADDR, SWD_REGION_PERIPHERAL, SWD_REGION_ACCESS_ANY, false,
+         true},
+    };
+
+    for (uint32_t i = 0; i < sizeof(defaults) / sizeof(swd_host_region_t); i++) {
+        if (swd_host_region_add(host, &defaults[i]) != SWD_OK) {
+            SWD_LOGW("Could not add default region 0x%08" PRIx32, defaults[i].start);
+        }
+    }
+}
+
+const swd_host_region_t *swd_host_region_find(swd_host_t *host, uint32_t addr) {
+    SWD_ASSERT(host != NULL);
+
+    // Binary search for the last region starting at or before `addr`
+    uint32_t lo = 0;
+    uint32_t hi = host->_region_cnt;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (host->_regions[mid].start <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0 || host->_regions[lo - 1].end < addr) {
+        return NULL;
+    }
+    return &host->_regions[lo - 1];
+}
+
+swd_err_t swd_host_window_read(swd_host_t *host, uint32_t addr, uint32_t *data) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+
+    if (addr & 0x3) {
+        SWD_LOGE("Window reads need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_dap_port_t port;
+    swd_err_t err = _swd_host_set_window(host, addr, &port);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = swd_dap_port_read(host->dap, port, data);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Reading DHCSR clears its sticky bits, every read is kept track of for the monitor
+    if (addr == DHCSR) {
+        _swd_host_dhcsr_observe(host, *data);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_window_write(swd_host_t *host, uint32_t addr, uint32_t data) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+
+    if (addr & 0x3) {
+        SWD_LOGE("Window writes need to be word aligned");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    // Memory written by the host has to be visible to the core's caches before it runs
+    if (addr == DHCSR && !(data & C_HALT)) {
+        swd_err_t err = _swd_host_cache_maint_flush(host);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    swd_dap_port_t port;
+    swd_err_t err = _swd_host_set_window(host, addr, &port);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    _swd_host_cache_invalidate_range(host, addr, 4);
+    err = swd_dap_port_write(host->dap, port, data);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_window_read_all(swd_host_t *host, uint32_t base, uint32_t *data) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(host->dap != NULL);
+
+    if (base & BD_WINDOW_MASK) {
+        SWD_LOGE("Window base needs to be 16-byte aligned");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    swd_dap_port_t port;
+    swd_err_t err = _swd_host_set_window(host, base, &port);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    static const swd_dap_port_t bd_ports[] = {AP_DB0, AP_DB1, AP_DB2, AP_DB3};
+    err = swd_dap_port_read_multi(host->dap, bd_ports, data, 4);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (base == (DHCSR & ~BD_WINDOW_MASK)) {
+        _swd_host_dhcsr_observe(host, data[(DHCSR & BD_WINDOW_MASK) >> 2]);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_register_read(swd_host_t *host, swd_target_register_t reg, uint32_t *data) {
+    SWD_HOST_CHECK_STARTED
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    return _swd_host_reg_cached_read(host, reg, data);
+}
+
+swd_err_t swd_host_register_write(swd_host_t *host, swd_target_register_t reg, uint32_t data) {
+    SWD_HOST_CHECK_STARTED
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    err = _swd_host_reg_transfer_write(host, reg, data);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    host->_regs[reg] = data;
+    host->_regs_valid = (host->_regs_valid & ~_swd_host_reg_aliases(reg)) | SWD_REG_SET(reg);
+    host->_regs_dirty &= ~(_swd_host_reg_aliases(reg) | SWD_REG_SET(reg));
+
+    return SWD_OK;
+}
+
+void swd_host_monitor_set_callback(swd_host_t *host, swd_host_event_cb_t _Nullable cb,
+                                   void *_Nullable ctx) {
+    SWD_ASSERT(host != NULL);
+
+    host->_mon_cb = cb;
+    host->_mon_ctx = ctx;
+}
+
+swd_err_t swd_host_monitor_poll(swd_host_t *host, uint32_t now, uint32_t *_Nullable next) {
+    SWD_HOST_CHECK_STARTED
+
+    if (!host->_mon_poll_now && (int32_t)(now - host->_mon_next) < 0) {
+        if (next != NULL) {
+            *next = host->_mon_next;
+        }
+        return SWD_OK;
+    }
+
+    uint32_t dhcsr;
+    swd_err_t err = swd_host_window_read(host, DHCSR, &dhcsr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    uint32_t sticky = host->_dhcsr_sticky;
+    uint32_t prev = host->_mon_status;
+    bool halted = dhcsr & S_HALTED;
+    bool was_halted = prev & S_HALTED;
+    bool event = false;
+
+    host->_dhcsr_sticky = 0;
+    host->_mon_status = dhcsr & (S_HALTED | S_LOCKUP);
+
+    if (sticky & S_RESET_ST) {
+        _swd_host_target_resumed(host);
+        _swd_host_monitor_dispatch(host, SWD_EVENT_RESET, 0);
+        event = true;
+    }
+
+    if ((dhcsr & S_LOCKUP) && !(prev & S_LOCKUP)) {
+        _swd_host_monitor_dispatch(host, SWD_EVENT_LOCKUP, 0);
+        event = true;
+    }
+
+    // Instructions retired while halted on both polls mean the core ran and halted again since
+    if (halted && (!was_halted || (sticky & S_RETIRE_ST))) {
+        uint32_t dfsr;
+        err = swd_host_memory_read_word(host, DFSR, &dfsr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        // Clear the reported bits so the next halt starts from a clean slate
+        err = swd_host_memory_write_word(host, DFSR, dfsr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        uint32_t reason =
+            dfsr & (DFSR_HALTED | DFSR_BKPT | DFSR_DWTTRAP | DFSR_VCATCH | DFSR_EXTERNAL);
+        if ((reason & DFSR_DWTTRAP) && host->_dwt_cmp_cnt > 0) {
+            uint32_t matched;
+            err = _swd_host_dwt_matched(host, &matched);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+                reason |= (matched & (1u << i)) ? SWD_HALT_REASON_WATCH_CMP(i) : 0;
+            }
+        }
+        if (host->_mon_stepping && (reason & DFSR_HALTED)) {
+            reason = (reason & ~DFSR_HALTED) | SWD_HALT_REASON_STEP;
+        }
+        host->_mon_stepping = false;
+        host->_target_halted = true;
+
+        _swd_host_monitor_dispatch(host, SWD_EVENT_HALTED, reason);
+        event = true;
+    } else if (!halted) {
+        _swd_host_target_resumed(host);
+        if (was_halted) {
+            _swd_host_monitor_dispatch(host, SWD_EVENT_RESUMED, 0);
+            event = true;
+        }
+    }
+
+    // Back off while nothing happens
+    if (event || host->_mon_poll_now) {
+        host->_mon_interval = SWD_HOST_MONITOR_MIN_INTERVAL;
+    } else if (host->_mon_interval < SWD_HOST_MONITOR_MAX_INTERVAL) {
+        host->_mon_interval = (host->_mon_interval * 2 < SWD_HOST_MONITOR_MAX_INTERVAL)
+                                  ? host->_mon_interval * 2
+                                  : SWD_HOST_MONITOR_MAX_INTERVAL;
+    }
+    host->_mon_poll_now = false;
+    host->_mon_next = now + host->_mon_interval;
+
+    if (next != NULL) {
+        *next = host->_mon_next;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_registers_fetch(swd_host_t *host, swd_target_register_set_t set,
+                                   uint32_t *out, swd_target_register_set_t *_Nullable fetched) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(out != NULL);
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    set &= SWD_REG_SET_ALL;
+
+    // FP registers are only worth reading when the core is using them
+    if (set & SWD_REG_SET_FP) {
+        bool fp_active = host->_has_fpu;
+        if (fp_active) {
+            uint32_t cfbp;
+            err = _swd_host_reg_cached_read(host, REG_CONTROL_FAULTMASK_BASEPRI_PRIMASK, &cfbp);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            fp_active = (cfbp & CFBP_FPCA) != 0;
+        }
+        if (!fp_active) {
+            set &= ~SWD_REG_SET_FP;
+        }
+    }
+
+    for (uint32_t reg = 0; reg < REG_CNT; reg++) {
+        if (set & SWD_REG_SET(reg)) {
+            err = _swd_host_reg_cached_read(host, (swd_target_register_t)reg, &out[reg]);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    if (fetched != NULL) {
+        *fetched = set;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_registers_stage(swd_host_t *host, swd_target_register_t reg, uint32_t data) {
+    SWD_HOST_CHECK_STARTED
+
+    if (reg >= REG_CNT) {
+        return SWD_HOST_INVALID_REGISTER;
+    }
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    // Staged aliases are kept, commit writes them in register order
+    swd_target_register_set_t aliases = _swd_host_reg_aliases(reg) & ~host->_regs_dirty;
+    host->_regs[reg] = data;
+    host->_regs_valid = (host->_regs_valid & ~aliases) | SWD_REG_SET(reg);
+    host->_regs_dirty |= SWD_REG_SET(reg);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_registers_commit(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
+
+    for (uint32_t reg = 0; reg < REG_CNT && host->_regs_dirty != 0; reg++) {
+        if (!(host->_regs_dirty & SWD_REG_SET(reg))) {
+            continue;
+        }
+
+        swd_err_t err =
+            _swd_host_reg_transfer_write(host, (swd_target_register_t)reg, host->_regs[reg]);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        host->_regs_valid &= ~_swd_host_reg_aliases((swd_target_register_t)reg);
+        host->_regs_dirty &= ~SWD_REG_SET(reg);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_add_breakpoint(swd_host_t *host, uint32_t addr) {
+    SWD_HOST_CHECK_STARTED
+
+    bool found;
+    _swd_host_sw_bkpt_probe(host, addr, &found);
+    if (found) {
+        SWD_LOGI("Requested breakpoint address 0x%08" PRIx32 " already exists", addr);
+        return SWD_OK;
+    }
+
+    if (host->_fpb_version == FPB_VERSION_1 && addr >= SRAM_BASE_ADDR) {
+        if (_swd_host_sw_bkpt_capable(host, addr)) {
+            return swd_host_add_sw_breakpoints(host, &addr, 1);
+        }
+        SWD_LOGW("FPB V1 does not breakpoint signals beyond the ROM reigon");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    // Find the first empty breakpoint to write to
+    // Find if the breakpoint exists
+    // Cry if there are no more breakpoints
+    uint32_t encoded_addr = _fpb_cmp_encode_bkpt(addr, host->_fpb_version);
+    uint32_t free_idx = host->code_cmp_cnt;
+
+    if (encoded_addr == FPB_ADDR_ERROR) {
+        SWD_LOGE("Cannot encode 0x%08" PRIx32 " as a breakpoint address", addr);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
+        // Find the first valid spot (a comparator which is disabled)
+        if (free_idx == host->code_cmp_cnt && ((host->_fp_comp[i] & ENABLE) == 0)) {
+            free_idx = i;
+        }
+
+        if (host->_fp_comp[i] == encoded_addr) {
+            SWD_LOGI("Requested breakpoint address 0x%08" PRIx32 " already exists", addr);
+            return SWD_OK;
+        }
+    }
+
+    if (free_idx == host->code_cmp_cnt) {
+        // Overflow into software breakpoints when the code can be patched
+        if (_swd_host_sw_bkpt_capable(host, addr)) {
+            return swd_host_add_sw_breakpoints(host, &addr, 1);
+        }
+        return SWD_TARGET_NO_MORE_BKPT;
+    }
+
+    return _swd_host_fpb_write_bank(host, free_idx, &encoded_addr, 1);
+}
+
+swd_err_t swd_host_remove_breakpoint(swd_host_t *host, uint32_t addr) {
+    SWD_HOST_CHECK_STARTED
+
+    bool found;
+    _swd_host_sw_bkpt_probe(host, addr, &found);
+    if (found) {
+        return swd_host_remove_sw_breakpoints(host, &addr, 1);
+    }
+
+    if (host->_fpb_version == FPB_VERSION_1 && addr >= SRAM_BASE_ADDR) {
+        SWD_LOGW("FPB V1 does not breakpoint signals beyond the ROM reigon");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    uint32_t encoded = _fpb_cmp_encode_bkpt(addr, host->_fpb_version);
+    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
+        // Delete if match
+        if (host->_fp_comp[i] == encoded) {
+            uint32_t disabled = 0x0;
+            return _swd_host_fpb_write_bank(host, i, &disabled, 1);
+        }
+    }
+
+    return SWD_TARGET_INVALID_ADDR;
+}
+
+swd_err_t swd_host_add_sw_breakpoints(swd_host_t *host, const uint32_t *addrs, uint32_t cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(addrs != NULL || cnt == 0);
+
+    static const uint8_t bkpt[2] = {THUMB_BKPT & 0xFF, THUMB_BKPT >> 8};
+    swd_host_iovec_t iov[SWD_HOST_IOV_BATCH_SIZE];
+    uint8_t orig[SWD_HOST_IOV_BATCH_SIZE][2];
+    swd_err_t err;
+
+    uint32_t i = 0;
+    while (i < cnt) {
+        uint32_t n = 0;
+        for (; i < cnt && n < SWD_HOST_IOV_BATCH_SIZE; i++) {
+            uint32_t addr = addrs[i];
+            if (!_swd_host_sw_bkpt_capable(host, addr)) {
+                SWD_LOGE("Cannot place a software breakpoint at 0x%08" PRIx32, addr);
+                return SWD_TARGET_INVALID_ADDR;
+            }
+
+            bool found;
+            _swd_host_sw_bkpt_probe(host, addr, &found);
+            for (uint32_t j = 0; j < n && !found; j++) {
+                found = iov[j].addr == addr;
+            }
+            if (found) {
+                continue;
+            }
+
+            if (host->_sw_bkpt_cnt + n >= SW_BKPT_MAX_CNT) {
+                SWD_LOGW("No more space for software breakpoints. Increase "
+                         "SWD_HOST_SW_BKPT_SLOTS");
+                return SWD_HOST_TABLE_FULL;
+            }
+            iov[n].addr = addr;
+            iov[n].len = 2;
+            iov[n].buf = orig[n];
+            n++;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        err = swd_host_memory_readv(host, iov, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        // Track the originals first, so even a failed write can be undone
+        for (uint32_t k = 0; k < n; k++) {
+            bool found;
+            uint32_t slot = _swd_host_sw_bkpt_probe(host, iov[k].addr, &found);
+            swd_host_sw_bkpt_t *bp = &host->_sw_bkpts[slot];
+            bp->addr = iov[k].addr;
+            bp->orig = orig[k][0] | (orig[k][1] << 8);
+            bp->used = true;
+            host->_sw_bkpt_cnt++;
+
+            iov[k].buf = (uint8_t *)bkpt;
+        }
+
+        err = swd_host_memory_writev(host, iov, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_remove_sw_breakpoints(swd_host_t *host, const uint32_t *addrs,
+                                         uint32_t cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(addrs != NULL || cnt == 0);
+
+    swd_host_iovec_t iov[SWD_HOST_IOV_BATCH_SIZE];
+    uint8_t orig[SWD_HOST_IOV_BATCH_SIZE][2];
+    swd_err_t err;
+
+    uint32_t i = 0;
+    while (i < cnt) {
+        uint32_t n = 0;
+        for (; i < cnt && n < SWD_HOST_IOV_BATCH_SIZE; i++) {
+            bool found;
+            uint32_t slot = _swd_host_sw_bkpt_probe(host, addrs[i], &found);
+            for (uint32_t j = 0; j < n && found; j++) {
+                found = iov[j].addr != addrs[i];
+            }
+            if (!found) {
+                continue;
+            }
+
+            orig[n][0] = host->_sw_bkpts[slot].orig & 0xFF;
+            orig[n][1] = host->_sw_bkpts[slot].orig >> 8;
+            iov[n].addr = addrs[i];
+            iov[n].len = 2;
+            iov[n].buf = orig[n];
+            n++;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        err = swd_host_memory_writev(host, iov, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        for (uint32_t k = 0; k < n; k++) {
+            bool found;
+            uint32_t slot = _swd_host_sw_bkpt_probe(host, iov[k].addr, &found);
+            _swd_host_sw_bkpt_delete(host, slot);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_clear_breakpoints(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
+
+    uint32_t comps[SWD_HOST_MAX_FPB_COMPARATORS];
+    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
+        comps[i] = (host->_patch_mask & (1u << i)) ? host->_fp_comp[i] : 0x0;
+    }
+
+    swd_err_t err = _swd_host_fpb_write_bank(host, 0, comps, host->code_cmp_cnt);
+    if (err != SWD_OK) {
+        SWD_LOGW("Could not clear the breakpoint comparators");
+    }
+
+    err = _swd_host_sw_bkpt_remove_unless(host, NULL, 0);
+    if (err != SWD_OK) {
+        SWD_LOGW("Could not restore the software breakpoints");
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_set_breakpoints(swd_host_t *host, const uint32_t *addrs, uint32_t cnt) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(addrs != NULL || cnt == 0);
+
+    uint32_t bank[SWD_HOST_MAX_FPB_COMPARATORS] = {0};
+    uint32_t bank_addrs[SWD_HOST_MAX_FPB_COMPARATORS];
+    uint32_t used = 0;
+    uint32_t capacity = 0;
+    swd_err_t err;
+
+    // Comparators holding flash patches are not available
+    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
+        capacity += !(host->_patch_mask & (1u << i));
+    }
+
+    // Comparators are handed out in order, whatever is left becomes a software breakpoint
+    for (uint32_t i = 0; i < cnt; i++) {
+        uint32_t encoded = FPB_ADDR_ERROR;
+        if (!(host->_fpb_version == FPB_VERSION_1 && addrs[i] >= SRAM_BASE_ADDR)) {
+            encoded = _fpb_cmp_encode_bkpt(addrs[i], host->_fpb_version);
+        }
+
+        if (encoded != FPB_ADDR_ERROR) {
+            bool duplicate = false;
+            for (uint32_t j = 0; j < used && !duplicate; j++) {
+                duplicate = bank[j] == encoded;
+            }
+            if (duplicate) {
+                continue;
+            }
+            if (used < capacity) {
+                bank_addrs[used] = addrs[i];
+                bank[used++] = encoded;
+                continue;
+            }
+        }
+
+        if (!_swd_host_sw_bkpt_capable(host, addrs[i])) {
+            SWD_LOGE("No breakpoint can be placed at 0x%08" PRIx32, addrs[i]);
+            return SWD_TARGET_NO_MORE_BKPT;
+        }
+    }
+
+    // Only the comparators between the first and last change are rewritten, so re-inserting
+    // the same set (ex. on every resume) costs no bus traffic at all
+    uint32_t comps[SWD_HOST_MAX_FPB_COMPARATORS];
+    uint32_t first = host->code_cmp_cnt;
+    uint32_t last = 0;
+    for (uint32_t i = 0, k = 0; i < host->code_cmp_cnt; i++) {
+        comps[i] = (host->_patch_mask & (1u << i)) ? host->_fp_comp[i] : bank[k++];
+        if (host->_fp_comp[i] != comps[i]) {
+            first = (i < first) ? i : first;
+            last = i + 1;
+        }
+    }
+    if (first < last) {
+        err = _swd_host_fpb_write_bank(host, first, &comps[first], last - first);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    if (host->_sw_bkpt_cnt > 0) {
+        // Drop software breakpoints which are no longer requested or now have a comparator
+        err = _swd_host_sw_bkpt_remove_unless(host, addrs, cnt);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        err = swd_host_remove_sw_breakpoints(host, bank_addrs, used);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    uint32_t batch[SWD_HOST_IOV_BATCH_SIZE];
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        bool in_bank = false;
+        for (uint32_t j = 0; j < used && !in_bank; j++) {
+            in_bank = bank_addrs[j] == addrs[i];
+        }
+        if (in_bank) {
+            continue;
+        }
+
+        batch[n++] = addrs[i];
+        if (n == SWD_HOST_IOV_BATCH_SIZE) {
+            err = swd_host_add_sw_breakpoints(host, batch, n);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        err = swd_host_add_sw_breakpoints(host, batch, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_get_breakpoint_count(swd_host_t *host, uint32_t *bkpt_cnt) {
+    SWD_HOST_CHECK_STARTED
+
+    *bkpt_cnt = host->code_cmp_cnt;
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_get_breakpoints(swd_host_t *host, uint32_t *buf, uint32_t bufsz,
+                                   uint32_t *rdcnt) {
+    SWD_HOST_CHECK_STARTED
+
+    if (bufsz < host->code_cmp_cnt) {
+        SWD_LOGW("Less space was provided than the maximum number of possible breakpoints. Given: "
+                 "%" PRIu32 ", Possible: %" PRIu8,
+                 bufsz, host->code_cmp_cnt);
+    }
+
+    *rdcnt = 0;
+    uint32_t decoded;
+    for (uint32_t i = 0; i < host->code_cmp_cnt && *rdcnt < bufsz; i++) {
+        if (host->_patch_mask & (1u << i)) {
+            continue;
+        }
+        decoded = _fpb_cmp_decode_bkpt(host->_fp_comp[i], host->_fpb_version);
+        if (decoded == FPB_ADDR_ERROR) {
+            SWD_LOGW("Issue decoded comparator address at 0x%08" PRIx32, FP_CMPN + (4 * i));
+        } else if (decoded != 0x0) {
+            buf[(*rdcnt)++] = decoded;
+        }
+    }
+    for (uint32_t i = 0; i < SWD_HOST_SW_BKPT_SLOTS && *rdcnt < bufsz; i++) {
+        if (host->_sw_bkpts[i].used) {
+            buf[(*rdcnt)++] = host->_sw_bkpts[i].addr;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_patch_set_table(swd_host_t *host, uint32_t table_addr) {
+    SWD_HOST_CHECK_STARTED
+
+    if (!host->_remap_supported) {
+        SWD_LOGE("The FPB does not support remapping");
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+    if ((table_addr & ~REMAP_MASK) != SRAM_BASE_ADDR) {
+        SWD_LOGE("Remap table 0x%08" PRIx32 " must be 32-byte aligned in SRAM", table_addr);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    host->_remap_table = table_addr;
+    return _swd_host_patch_write_table(host);
+}
+
+swd_err_t swd_host_patch_add(swd_host_t *host, uint32_t addr, uint32_t data, uint8_t size,
+                             swd_host_patch_kind_t kind) {
+    SWD_HOST_CHECK_STARTED
+
+    if (!host->_remap_supported) {
+        SWD_LOGE("The FPB does not support remapping");
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+    if (host->_remap_table == 0) {
+        SWD_LOGE("No remap table was set");
+        return SWD_ERR;
+    }
+    if ((size != 2 && size != 4) || (addr & (size - 1)) || addr >= SRAM_BASE_ADDR) {
+        SWD_LOGE("Cannot patch %" PRIu8 " bytes at 0x%08" PRIx32, size, addr);
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    // Code patches use the code comparators and literal patches the ones after them
+    uint32_t first = (kind == SWD_PATCH_CODE) ? 0 : host->code_cmp_cnt;
+    uint32_t last = (kind == SWD_PATCH_CODE) ? host->code_cmp_cnt
+                                              : host->code_cmp_cnt + host->_lit_cmp_cnt;
+    uint32_t word_addr = addr & ~0x3u;
+    uint32_t idx = last;
+    for (uint32_t i = first; i < last; i++) {
+        if ((host->_patch_mask & (1u << i)) && host->_patches[i].addr == word_addr) {
+            idx = i;
+            break;
+        }
+        if (idx == last && !(host->_fp_comp[i] & ENABLE)) {
+            idx = i;
+        }
+    }
+    if (idx == last) {
+        SWD_LOGE("No free %s comparator for a patch",
+                 (kind == SWD_PATCH_CODE) ? "code" : "literal");
+        return SWD_TARGET_NO_MORE_BKPT;
+    }
+
+    // The remap table always holds whole words, merge halfwords with what is already there
+    swd_err_t err;
+    uint32_t word = data;
+    if (size == 2) {
+        if (host->_patch_mask & (1u << idx)) {
+            word = host->_patches[idx].data;
+        } else {
+            err = swd_host_memory_read_word(host, word_addr, &word);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+        uint32_t shift = 8 * (addr & 0x2);
+        word = (word & ~(0xFFFFu << shift)) | ((data & 0xFFFFu) << shift);
+    }
+
+    err = swd_host_memory_write_word(host, host->_remap_table + 4 * idx, word);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    host->_patches[idx].addr = word_addr;
+    host->_patches[idx].data = word;
+    host->_patches[idx].kind = kind;
+    host->_patch_mask |= 1u << idx;
+
+    // REPLACE = 00 remaps the word instead of breaking on it
+    uint32_t comp = (word_addr & 0x1FFFFFFC) | ENABLE;
+    if (host->_fp_comp[idx] != comp) {
+        err = _swd_host_fpb_write_bank(host, idx, &comp, 1);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+    _swd_host_cache_invalidate_range(host, word_addr, 4);
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_patch_remove(swd_host_t *host, uint32_t addr, swd_host_patch_kind_t kind) {
+    SWD_HOST_CHECK_STARTED
+
+    for (uint32_t i = 0; i < SWD_HOST_MAX_FPB_COMPARATORS; i++) {
+        if ((host->_patch_mask & (1u << i)) && host->_patches[i].addr == (addr & ~0x3u) &&
+            host->_patches[i].kind == kind) {
+            uint32_t disabled = 0x0;
+            swd_err_t err = _swd_host_fpb_write_bank(host, i, &disabled, 1);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            host->_patch_mask &= ~(1u << i);
+            _swd_host_cache_invalidate_range(host, addr & ~0x3u, 4);
+            return SWD_OK;
+        }
+    }
+
+    return SWD_TARGET_INVALID_ADDR;
+}
+
+swd_err_t swd_host_patch_list(swd_host_t *host, swd_host_patch_t *buf, uint32_t bufsz,
+                              uint32_t *cnt) {
+    SWD_HOST_CHECK_STARTED
+
+    *cnt = 0;
+    for (uint32_t i = 0; i < SWD_HOST_MAX_FPB_COMPARATORS && *cnt < bufsz; i++) {
+        if (host->_patch_mask & (1u << i)) {
+            buf[(*cnt)++] = host->_patches[i];
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_patch_reapply(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
+
+    if (host->_remap_table == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = _swd_host_patch_write_table(host);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // The whole bank goes out in one burst, breakpoints included
+    return _swd_host_fpb_write_bank(host, 0, host->_fp_comp,
+                                    host->code_cmp_cnt + host->_lit_cmp_cnt);
+}
+
+swd_err_t swd_host_add_watchpoint(swd_host_t *host, const swd_host_watchpoint_t *wp,
+                                  uint8_t *_Nullable cmp) {
+    SWD_HOST_CHECK_STARTED
+    SWD_ASSERT(wp != NULL);
+    SWD_ASSERT(wp->kind >= SWD_WATCH_READ && wp->kind <= SWD_WATCH_ACCESS);
+
+    uint32_t mask = 0;
+    while (mask < 32 && (1u << mask) < wp->size) {
+        mask++;
+    }
+    if (wp->size == 0 || (1u << mask) != wp->size || (wp->addr & (wp->size - 1))) {
+        SWD_LOGE("Watched range must be a power of two and aligned to its size");
+        return SWD_TARGET_INVALID_ADDR;
+    }
+    if (mask > host->_dwt_max_mask) {
+        SWD_LOGE("The DWT can not watch more than %" PRIu32 " bytes",
+                 (uint32_t)1 << host->_dwt_max_mask);
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+        const swd_host_watchpoint_t *w = &host->_watches[i];
+        if ((host->_watch_mask & (1u << i)) && w->addr == wp->addr && w->kind == wp->kind &&
+            w->size == wp->size && w->match_value == wp->match_value &&
+            (!wp->match_value || (w->value == wp->value && w->value_size == wp->value_size))) {
+            SWD_LOGI("Requested watchpoint 0x%08" PRIx32 " already exists", wp->addr);
+            if (cmp != NULL) {
+                *cmp = (uint8_t)i;
+            }
+            return SWD_OK;
+        }
+    }
+
+    if (wp->match_value && host->_dwt_datav_mask == 0) {
+        SWD_LOGE("The DWT does not support data value matching");
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    // Addresses prefer comparators which can not match data values, keeping those available
+    uint32_t free_cmps = ~host->_dwt_used & ((1u << host->_dwt_cmp_cnt) - 1);
+    uint32_t datav = free_cmps & host->_dwt_datav_mask;
+    uint32_t plain = (free_cmps & ~datav) ? (free_cmps & ~datav) : free_cmps;
+    uint32_t idx = _swd_host_dwt_first(host, wp->match_value ? datav : plain);
+    uint32_t link = host->_dwt_cmp_cnt;
+    if (wp->match_value && idx < host->_dwt_cmp_cnt) {
+        uint32_t rest = free_cmps & ~(1u << idx);
+        link = _swd_host_dwt_first(host, (rest & ~datav) ? (rest & ~datav) : rest);
+    }
+    if (idx == host->_dwt_cmp_cnt || (wp->match_value && link == host->_dwt_cmp_cnt)) {
+        SWD_LOGE("No free DWT comparator for watchpoint 0x%08" PRIx32, wp->addr);
+        return SWD_TARGET_NO_MORE_BKPT;
+    }
+
+    swd_err_t err;
+    uint32_t func = (uint32_t)wp->kind;
+    if (wp->match_value) {
+        uint32_t value = wp->value;
+        uint32_t vsize;
+        switch (wp->value_size) {
+        case 1:
+            // Byte and halfword values are compared against every lane, replicate them
+            value = (value & 0xFF) * 0x01010101u;
+            vsize = 0;
+            break;
+        case 2:
+            value = (value & 0xFFFF) * 0x00010001u;
+            vsize = 1;
+            break;
+        case 4:
+            vsize = 2;
+            break;
+        default:
+            SWD_LOGE("Data values are 1, 2 or 4 bytes");
+            return SWD_TARGET_NOT_SUPPORTED;
+        }
+
+        // The linked comparator only provides the address, it does not halt by itself
+        err = _swd_host_dwt_write_cmp(host, link, wp->addr, mask, 0x0);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        host->_dwt_used |= 1u << link;
+
+        func |= DWT_DATAVMATCH | (vsize << DWT_DATAVSIZE_SHIFT) |
+                (link << DWT_DATAVADDR0_SHIFT) | (link << DWT_DATAVADDR1_SHIFT);
+        err = _swd_host_dwt_write_cmp(host, idx, value, 0x0, func);
+    } else {
+        err = _swd_host_dwt_write_cmp(host, idx, wp->addr, mask, func);
+    }
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    host->_watches[idx] = *wp;
+    host->_watches[idx].cmp = (uint8_t)idx;
+    host->_watch_mask |= 1u << idx;
+    host->_dwt_used |= 1u << idx;
+    if (cmp != NULL) {
+        *cmp = (uint8_t)idx;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_remove_watchpoint(swd_host_t *host, uint32_t addr,
+                                     swd_host_watch_kind_t kind) {
+    SWD_HOST_CHECK_STARTED
+
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+        if (!(host->_watch_mask & (1u << i)) || host->_watches[i].addr != addr ||
+            host->_watches[i].kind != kind) {
+            continue;
+        }
+
+        swd_err_t err = swd_host_memory_write_word(host, DWT_FUNCTION0 + DWT_CMP_STRIDE * i, 0);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        if (host->_dwt_func[i] & DWT_DATAVMATCH) {
+            uint32_t link = (host->_dwt_func[i] >> DWT_DATAVADDR0_SHIFT) & 0xF;
+            host->_dwt_used &= ~(1u << link);
+        }
+        host->_dwt_func[i] = 0;
+        host->_watch_mask &= ~(1u << i);
+        host->_dwt_used &= ~(1u << i);
+        return SWD_OK;
+    }
+
+    return SWD_TARGET_INVALID_ADDR;
+}
+
+swd_err_t swd_host_clear_watchpoints(swd_host_t *host) {
+    SWD_HOST_CHECK_STARTED
+
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+        if (host->_watch_mask & (1u << i)) {
+            swd_err_t err = swd_host_remove_watchpoint(host, host->_watches[i].addr,
+                                                       host->_watches[i].kind);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_host_get_watchpoints(swd_host_t *host, swd_host_watchpoint_t *buf, uint32_t bufsz,
+                                   uint32_t *cnt) {
+    SWD_HOST_CHECK_STARTED
+
+    *cnt = 0;
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt && *cnt < bufsz; i++) {
+        if (host->_watch_mask & (1u << i)) {
+            buf[(*cnt)++] = host->_watches[i];
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_setup_dap_configs(swd_host_t *host) {
     // Set transfers to word (CSW.Size = 0x2)
     SWD_LOGV("Setting transfers to word");
     SWD_LOGV("Setting address auto-increment to false");
@@ -736,69 +2537,1384 @@ swd_err_t _swd_host_setup_dap_configs(swd_host_t *host) {
     // err = swd_dap_port_write(host->dap, AP_CSW, (csw & ~0x37) | 0x2); // Size = 0b010 (word),
     // AddrInc = 0b00 (no inc) SWD_HOST_RETURN_IF_NON_OK(err);
 
-    // Size = 0b010 (word), AddrInc = 0b00 (no inc)
-    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x02, 0x37);
+    // Size = 0b010 (word), AddrInc = 0b00 (no inc)
+    swd_err_t err = _swd_host_dap_port_write_masked(host, AP_CSW, 0x02, 0x37);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Keep a copy so later AddrInc changes do not need a read-modify-write
+    err = swd_dap_port_read(host->dap, AP_CSW, &host->_csw);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Word sized transfers make the banked data registers safe to use
+    swd_dap_allow_banked_data(host->dap, true);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_enable_arch_configs(swd_host_t *host) {
+    // Enable the Flash Patch and Breakpoint unit
+    SWD_LOGI("Enabling FPB Unit");
+    uint32_t fp_ctrl;
+    swd_err_t err;
+    swd_host_memory_write_word(host, FP_CTRL, KEY | ENABLE);
+    err = swd_host_memory_read_word(host, FP_CTRL, &fp_ctrl);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!(fp_ctrl & ENABLE)) {
+        SWD_LOGW("FPB unit failed to set ENABLE");
+        return SWD_HOST_NOT_STARTED;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_detect_arch_configs(swd_host_t *host) {
+    // Read FPB version
+    uint32_t fp_ctrl;
+    swd_err_t err = swd_host_memory_read_word(host, FP_CTRL, &fp_ctrl);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    host->_fpb_version = (uint8_t)(fp_ctrl >> 28);
+    const char *v_str;
+    switch (host->_fpb_version) {
+    case FPB_VERSION_1:
+        v_str = "v1";
+        break;
+    case FPB_VERSION_2:
+        v_str = "v2";
+        break;
+    default:
+        SWD_LOGE("Cannot detect FPB version");
+        return SWD_HOST_START_ERR;
+    }
+    SWD_LOGI("Detected FPB version: %s", v_str);
+
+    // Get the number of code comparators (breakpoint addresses)
+    host->code_cmp_cnt = (uint8_t)((fp_ctrl & 0x7000) >> 0x8) | ((fp_ctrl & 0xF0) >> 0x4);
+    SWD_LOGI("Detected number of code comparators (HW Breakpoints): %" PRIu8, host->code_cmp_cnt);
+    host->_lit_cmp_cnt = (uint8_t)((fp_ctrl & 0xF00) >> 0x8);
+    SWD_LOGI("Detected number of literal comparators (FP Remaps): %" PRIu8, host->_lit_cmp_cnt);
+
+    if (host->code_cmp_cnt + host->_lit_cmp_cnt > SWD_HOST_MAX_FPB_COMPARATORS) {
+        SWD_LOGW("Only %d comparators are managed. Increase SWD_HOST_MAX_FPB_COMPARATORS",
+                 SWD_HOST_MAX_FPB_COMPARATORS);
+        host->code_cmp_cnt = (host->code_cmp_cnt < SWD_HOST_MAX_FPB_COMPARATORS)
+                                 ? host->code_cmp_cnt
+                                 : SWD_HOST_MAX_FPB_COMPARATORS;
+        host->_lit_cmp_cnt = SWD_HOST_MAX_FPB_COMPARATORS - host->code_cmp_cnt;
+    }
+
+    // Shadow the comparator bank so breakpoints can be managed without reading it back
+    err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_read_words(host, FP_CMPN, host->_fp_comp,
+                               host->code_cmp_cnt + host->_lit_cmp_cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // Only FPB v1 can remap, and only if the implementation supports remapping to SRAM
+    uint32_t fp_remap;
+    err = swd_host_memory_read_word(host, FP_REMAP, &fp_remap);
+    if (err != SWD_OK) {
+        SWD_LOGW("Cannot read FP_REMAP, assuming no remapping: %s", swd_err_as_str(err));
+        fp_remap = 0;
+    }
+    host->_remap_supported = host->_fpb_version == FPB_VERSION_1 && (fp_remap & RMPSPT);
+    SWD_LOGI("Detected flash patch remapping: %s", host->_remap_supported ? "yes" : "no");
+
+    // Optional features are best-effort, a failed probe leaves the feature out
+    err = _swd_host_dwt_detect(host);
+    if (err != SWD_OK) {
+        SWD_LOGW("Cannot detect the DWT, watchpoints are unavailable: %s", swd_err_as_str(err));
+        host->_dwt_cmp_cnt = 0;
+        host->_dwt_used = 0;
+        host->_dwt_datav_mask = 0;
+    }
+
+    // FPSCR and S0-S31 only exist with an FPU
+    uint32_t mvfr0;
+    err = swd_host_memory_read_word(host, MVFR0, &mvfr0);
+    if (err != SWD_OK) {
+        SWD_LOGW("Cannot read MVFR0, assuming no FPU: %s", swd_err_as_str(err));
+        mvfr0 = 0;
+    }
+    host->_has_fpu = (mvfr0 & MVFR0_SIMD_REGS) != 0;
+    SWD_LOGI("Detected FPU: %s", host->_has_fpu ? "yes" : "no");
+
+    err = _swd_host_cache_maint_detect(host);
+    if (err != SWD_OK) {
+        SWD_LOGW("Cannot detect the caches, assuming none: %s", swd_err_as_str(err));
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_dwt_detect(swd_host_t *host) {
+    // The DWT is only accessible with trace enabled
+    uint32_t demcr;
+    swd_err_t err = swd_host_window_read(host, DEMCR, &demcr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (!(demcr & TRCENA)) {
+        err = swd_host_window_write(host, DEMCR, demcr | TRCENA);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    // DWT comparators. Data value matching and the largest address mask are optional, they are
+    // found out by trying them on comparators the firmware does not use, then restoring them
+    host->_dwt_used = 0;
+    host->_dwt_datav_mask = 0;
+    host->_dwt_max_mask = 0;
+    uint32_t dwt_ctrl;
+    err = swd_host_memory_read_word(host, DWT_CTRL, &dwt_ctrl);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    host->_dwt_cmp_cnt = (uint8_t)(dwt_ctrl >> DWT_NUMCOMP_SHIFT);
+    SWD_LOGI("Detected number of DWT comparators (Watchpoints): %" PRIu8, host->_dwt_cmp_cnt);
+    if (host->_dwt_cmp_cnt > SWD_HOST_MAX_DWT_COMPARATORS) {
+        SWD_LOGW("Only %d DWT comparators are managed. Increase SWD_HOST_MAX_DWT_COMPARATORS",
+                 SWD_HOST_MAX_DWT_COMPARATORS);
+        host->_dwt_cmp_cnt = SWD_HOST_MAX_DWT_COMPARATORS;
+    }
+
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+        uint32_t base = DWT_COMP0 + DWT_CMP_STRIDE * i;
+        uint32_t func;
+        err = swd_host_memory_read_word(host, base + 0x8, &func);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        host->_dwt_func[i] = func & ~DWT_MATCHED;
+        if (func & DWT_FUNC_MASK) {
+            host->_dwt_used |= 1u << i;
+            continue;
+        }
+
+        uint32_t probe;
+        if (host->_dwt_max_mask == 0) {
+            uint32_t mask;
+            err = swd_host_memory_read_word(host, base + 0x4, &mask);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            err = swd_host_memory_write_word(host, base + 0x4, 0x1F);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            err = swd_host_memory_read_word(host, base + 0x4, &probe);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            host->_dwt_max_mask = (uint8_t)(probe & 0x1F);
+            err = swd_host_memory_write_word(host, base + 0x4, mask);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+
+        if (func & DWT_LNK1ENA) {
+            err = swd_host_memory_write_word(host, base + 0x8, DWT_DATAVMATCH);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            err = swd_host_memory_read_word(host, base + 0x8, &probe);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+            host->_dwt_datav_mask |= (probe & DWT_DATAVMATCH) ? (1u << i) : 0;
+            err = swd_host_memory_write_word(host, base + 0x8, host->_dwt_func[i]);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_dap_port_write_masked(swd_host_t *host, swd_dap_port_t port, uint32_t data,
+                                          uint32_t mask) {
+    uint32_t rd_data;
+    swd_err_t err = swd_dap_port_read(host->dap, port, &rd_data);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = swd_dap_port_write(host->dap, port, (rd_data & ~mask) | (data & mask));
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_set_tar(swd_host_t *host, uint32_t addr) {
+    if (host->_tar_valid && host->_tar == addr) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = swd_dap_port_write(host->dap, AP_TAR, addr);
+    host->_tar = addr;
+    host->_tar_valid = (err == SWD_OK);
+
+    return err;
+}
+
+swd_err_t _swd_host_set_window(swd_host_t *host, uint32_t addr, swd_dap_port_t *port) {
+    *port = (swd_dap_port_t)(AP_DB0 + ((addr >> 2) & 0x3));
+
+    // Any TAR inside of the window works, the low bits are ignored by the BD registers
+    if (host->_tar_valid && ((host->_tar ^ addr) & ~BD_WINDOW_MASK) == 0) {
+        return SWD_OK;
+    }
+
+    return _swd_host_set_tar(host, addr & ~BD_WINDOW_MASK);
+}
+
+void _swd_host_tar_advance(swd_host_t *host, uint32_t cnt) {
+    if ((host->_csw & CSW_ADDRINC_MASK) != CSW_ADDRINC_SINGLE || !host->_tar_valid) {
+        return;
+    }
+
+    // Once TAR reaches a 1KB boundary its next value is implementation defined
+    uint64_t next = (uint64_t)host->_tar + 4 * (uint64_t)cnt;
+    uint64_t block_end = ((uint64_t)host->_tar & ~(uint64_t)(TAR_AUTOINC_BOUNDARY - 1)) +
+                         TAR_AUTOINC_BOUNDARY;
+    host->_tar = (uint32_t)next;
+    host->_tar_valid = next < block_end;
+}
+
+swd_err_t _swd_host_set_addr_inc(swd_host_t *host, bool enable) {
+    uint32_t csw = (host->_csw & ~CSW_ADDRINC_MASK) | (enable ? CSW_ADDRINC_SINGLE : 0x0);
+    if (csw != host->_csw) {
+        SWD_LOGD("%s auto-increment TAR", enable ? "Enabling" : "Disabling");
+    }
+    return _swd_host_set_csw(host, csw);
+}
+
+swd_err_t _swd_host_set_csw(swd_host_t *host, uint32_t csw) {
+    if (csw == host->_csw) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = swd_dap_port_write(host->dap, AP_CSW, csw);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    host->_csw = csw;
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_read_narrow(swd_host_t *host, uint32_t addr, uint8_t size, uint32_t *data) {
+    uint32_t csw = host->_csw;
+    uint32_t size_bits = (size == 1) ? CSW_SIZE_BYTE : CSW_SIZE_HALFWORD;
+    swd_err_t err = _swd_host_set_csw(host, (csw & ~CSW_SIZE_MASK) | size_bits);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = _swd_host_set_tar(host, addr);
+    if (err == SWD_OK) {
+        uint32_t lanes;
+        err = swd_dap_port_read(host->dap, AP_DRW, &lanes);
+        if (err == SWD_OK) {
+            *data = (lanes >> (8 * (addr & 0x3))) & ((size == 1) ? 0xFF : 0xFFFF);
+        }
+    }
+    // TAR moves by the transfer size which the word based tracking cannot follow
+    host->_tar_valid = false;
+
+    swd_err_t restore_err = _swd_host_set_csw(host, csw);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    return restore_err;
+}
+
+swd_err_t _swd_host_write_narrow(swd_host_t *host, uint32_t addr, uint8_t size, uint32_t data) {
+    uint32_t csw = host->_csw;
+    uint32_t size_bits = (size == 1) ? CSW_SIZE_BYTE : CSW_SIZE_HALFWORD;
+    swd_err_t err = _swd_host_set_csw(host, (csw & ~CSW_SIZE_MASK) | size_bits);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    _swd_host_cache_invalidate_range(host, addr, size);
+    err = _swd_host_set_tar(host, addr);
+    if (err == SWD_OK) {
+        err = swd_dap_port_write(host->dap, AP_DRW, data << (8 * (addr & 0x3)));
+    }
+    host->_tar_valid = false;
+
+    swd_err_t restore_err = _swd_host_set_csw(host, csw);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    return restore_err;
+}
+
+swd_err_t _swd_host_read_partial_word(swd_host_t *host, uint32_t addr, uint8_t *buf,
+                                      uint32_t cnt) {
+    swd_err_t err;
+    const swd_host_region_t *region = swd_host_region_find(host, addr);
+    bool exact = region != NULL && region->read_side_effects;
+
+    while (exact && cnt > 0) {
+        uint8_t size = 0;
+        if ((region->access & SWD_REGION_ACCESS_HALFWORD) && !(addr & 0x1) && cnt >= 2) {
+            size = 2;
+        } else if (region->access & SWD_REGION_ACCESS_BYTE) {
+            size = 1;
+        } else {
+            // No narrow access fits, fall back to reading the whole word
+            break;
+        }
+
+        uint32_t data;
+        err = _swd_host_read_narrow(host, addr, size, &data);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        for (uint8_t i = 0; i < size; i++) {
+            *(buf++) = (data >> (8 * i)) & 0xFF;
+        }
+        addr += size;
+        cnt -= size;
+    }
+
+    if (cnt > 0) {
+        uint32_t word;
+        err = swd_host_memory_read_word(host, addr & ~0x3, &word);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        for (uint32_t i = 0; i < cnt; i++) {
+            buf[i] = (word >> (8 * ((addr & 0x3) + i))) & 0xFF;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_write_partial_word(swd_host_t *host, uint32_t addr, const uint8_t *buf,
+                                       uint32_t cnt) {
+    swd_err_t err;
+    const swd_host_region_t *region = swd_host_region_find(host, addr);
+    bool exact = region != NULL && region->read_side_effects;
+
+    while (exact && cnt > 0) {
+        uint8_t size = 0;
+        if ((region->access & SWD_REGION_ACCESS_HALFWORD) && !(addr & 0x1) && cnt >= 2) {
+            size = 2;
+        } else if (region->access & SWD_REGION_ACCESS_BYTE) {
+            size = 1;
+        } else {
+            break;
+        }
+
+        uint32_t data = (size == 2) ? (buf[0] | (buf[1] << 8)) : buf[0];
+        err = _swd_host_write_narrow(host, addr, size, data);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        buf += size;
+        addr += size;
+        cnt -= size;
+    }
+
+    if (cnt > 0) {
+        uint32_t word;
+        uint32_t aligned = addr & ~0x3;
+        err = swd_host_memory_read_word(host, aligned, &word);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        for (uint32_t i = 0; i < cnt; i++) {
+            uint8_t shamt = 8 * ((addr & 0x3) + i);
+            word = (word & ~(0xFFu << shamt)) | ((uint32_t)buf[i] << shamt);
+        }
+        err = swd_host_memory_write_word(host, aligned, word);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_read_span(swd_host_t *host, uint32_t addr, uint8_t *buf, uint32_t len,
+                              uint32_t *_Nullable cnt) {
+    uint32_t chunk[SWD_HOST_XFER_CHUNK_WORDS];
+    swd_err_t err;
+
+    if (cnt != NULL) {
+        *cnt = 0;
+    }
+
+    // Leading bytes up to the first word boundary
+    uint32_t head = (4 - (addr & 0x3)) & 0x3;
+    head = (head < len) ? head : len;
+    if (head > 0) {
+        err = _swd_host_read_partial_word(host, addr, buf, head);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        addr += head;
+        buf += head;
+        len -= head;
+        if (cnt != NULL) {
+            *cnt += head;
+        }
+    }
+
+    while (len >= 4) {
+        uint32_t words = len / 4;
+        words = (words < SWD_HOST_XFER_CHUNK_WORDS) ? words : SWD_HOST_XFER_CHUNK_WORDS;
+        err = _swd_host_read_words(host, addr, chunk, words);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        for (uint32_t i = 0; i < 4 * words; i++) {
+            buf[i] = (chunk[i >> 2] >> (8 * (i & 0x3))) & 0xFF;
+        }
+        addr += 4 * words;
+        buf += 4 * words;
+        len -= 4 * words;
+        if (cnt != NULL) {
+            *cnt += 4 * words;
+        }
+    }
+
+    if (len > 0) {
+        err = _swd_host_read_partial_word(host, addr, buf, len);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        if (cnt != NULL) {
+            *cnt += len;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_write_span(swd_host_t *host, uint32_t addr, const uint8_t *buf, uint32_t len,
+                               uint32_t *_Nullable cnt) {
+    uint32_t chunk[SWD_HOST_XFER_CHUNK_WORDS];
+    swd_err_t err;
+
+    if (cnt != NULL) {
+        *cnt = 0;
+    }
+
+    uint32_t head = (4 - (addr & 0x3)) & 0x3;
+    head = (head < len) ? head : len;
+    if (head > 0) {
+        SWD_LOGD("Non word aligned byte transfer at 0x%08" PRIx32, addr);
+        err = _swd_host_write_partial_word(host, addr, buf, head);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        addr += head;
+        buf += head;
+        len -= head;
+        if (cnt != NULL) {
+            *cnt += head;
+        }
+    }
+
+    while (len >= 4) {
+        uint32_t words = len / 4;
+        words = (words < SWD_HOST_XFER_CHUNK_WORDS) ? words : SWD_HOST_XFER_CHUNK_WORDS;
+        for (uint32_t i = 0; i < words; i++) {
+            chunk[i] = buf[4 * i] | (buf[4 * i + 1] << 8) | (buf[4 * i + 2] << 16) |
+                       ((uint32_t)buf[4 * i + 3] << 24);
+        }
+        err = _swd_host_write_words(host, addr, chunk, words);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        addr += 4 * words;
+        buf += 4 * words;
+        len -= 4 * words;
+        if (cnt != NULL) {
+            *cnt += 4 * words;
+        }
+    }
+
+    if (len > 0) {
+        SWD_LOGD("Non word aligned byte transfer at 0x%08" PRIx32, addr);
+        err = _swd_host_write_partial_word(host, addr, buf, len);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        if (cnt != NULL) {
+            *cnt += len;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_fill_produce(void *ctx, uint64_t offset, uint8_t *data, uint32_t len) {
+    _swd_host_fill_ctx_t *fill = ctx;
+    uint32_t p = offset % fill->pattern_len;
+
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = fill->pattern[p];
+        p = (p + 1 == fill->pattern_len) ? 0 : p + 1;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_compare_consume(void *ctx, uint64_t offset, const uint8_t *data,
+                                    uint32_t len) {
+    _swd_host_compare_ctx_t *cmp = ctx;
+    const uint8_t *expected = cmp->expected + offset;
+
+    if (memcmp(data, expected, len) == 0) {
+        return SWD_OK;
+    }
+
+    uint32_t i = 0;
+    while (data[i] == expected[i]) {
+        i++;
+    }
+    cmp->is_equal = false;
+    cmp->mismatch = (uint32_t)offset + i;
+
+    // No need to read the rest
+    return SWD_HOST_XFER_CANCELLED;
+}
+
+swd_err_t _swd_host_find_consume(void *ctx, uint64_t offset, const uint8_t *data, uint32_t len) {
+    _swd_host_find_ctx_t *find = ctx;
+    uint32_t plen = find->pattern_len;
+
+    // Matches can straddle chunks, so search the carried tail of the previous chunk as well
+    memcpy(&find->window[find->carry], data, len);
+    uint32_t window_len = find->carry + len;
+    uint32_t window_offset = (uint32_t)offset - find->carry;
+
+    uint32_t pos = 0;
+    while (pos + plen <= window_len) {
+        uint8_t last = find->window[pos + plen - 1];
+        if (last == find->pattern[plen - 1] &&
+            memcmp(&find->window[pos], find->pattern, plen - 1) == 0) {
+            find->found = true;
+            find->match = window_offset + pos;
+            return SWD_HOST_XFER_CANCELLED;
+        }
+        pos += find->shift[last];
+    }
+
+    // Keep the bytes which can still start a match
+    uint32_t keep = (window_len < plen - 1) ? window_len : plen - 1;
+    memmove(find->window, &find->window[window_len - keep], keep);
+    find->carry = keep;
+
+    return SWD_OK;
+}
+
+uint32_t _swd_host_stream_chunk_len(uint32_t addr, uint64_t remaining) {
+    // Only the first chunk can start unaligned, the rest stay word aligned
+    uint32_t n = SWD_HOST_STREAM_CHUNK_BYTES - (addr & 0x3);
+    return (remaining < n) ? (uint32_t)remaining : n;
+}
+
+bool _swd_host_cache_usable(swd_host_t *host, uint32_t addr) {
+#if SWD_HOST_MEM_CACHE_LINES > 0
+    if (!host->_target_halted) {
+        return false;
+    }
+
+    // The whole line must be covered, filling it reads every word
+    const swd_host_region_t *region = swd_host_region_find(host, addr);
+    uint32_t line_addr = addr & ~(CACHE_LINE_BYTES - 1);
+    return region != NULL && region->cacheable && !region->read_side_effects &&
+           line_addr >= region->start && line_addr + (CACHE_LINE_BYTES - 1) <= region->end;
+#else
+    return false;
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+}
+
+swd_err_t _swd_host_cache_read_word(swd_host_t *host, uint32_t addr, uint32_t *data) {
+#if SWD_HOST_MEM_CACHE_LINES > 0
+    uint32_t line_addr = addr & ~(CACHE_LINE_BYTES - 1);
+    swd_host_cache_line_t *line =
+        &host->_cache[(line_addr / CACHE_LINE_BYTES) % SWD_HOST_MEM_CACHE_LINES];
+
+    if (!line->valid || line->addr != line_addr) {
+        // Fill the whole line with a single pipelined transfer
+        bool addr_inc = (host->_csw & CSW_ADDRINC_MASK) == CSW_ADDRINC_SINGLE;
+        line->valid = false;
+        swd_err_t err = _swd_host_set_addr_inc(host, true);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        err = _swd_host_read_words(host, line_addr, line->data, SWD_HOST_MEM_CACHE_LINE_WORDS);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        err = _swd_host_set_addr_inc(host, addr_inc);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        line->addr = line_addr;
+        line->valid = true;
+    }
+
+    *data = line->data[(addr - line_addr) / 4];
+    return SWD_OK;
+#else
+    return SWD_ERR;
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+}
+
+void _swd_host_cache_invalidate_range(swd_host_t *host, uint32_t addr, uint32_t len) {
+    // Every write to the target passes here
+    _swd_host_cache_maint_track(host, addr, len);
+
+#if SWD_HOST_MEM_CACHE_LINES > 0
+    if (len == 0) {
+        return;
+    }
+    uint64_t end = (uint64_t)addr + len;
+    for (uint32_t i = 0; i < SWD_HOST_MEM_CACHE_LINES; i++) {
+        swd_host_cache_line_t *line = &host->_cache[i];
+        if (line->valid && line->addr < end && (uint64_t)line->addr + CACHE_LINE_BYTES > addr) {
+            line->valid = false;
+        }
+    }
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+}
+
+void _swd_host_cache_invalidate(swd_host_t *host) {
+#if SWD_HOST_MEM_CACHE_LINES > 0
+    for (uint32_t i = 0; i < SWD_HOST_MEM_CACHE_LINES; i++) {
+        host->_cache[i].valid = false;
+    }
+#endif // SWD_HOST_MEM_CACHE_LINES > 0
+}
+
+swd_err_t _swd_host_cache_maint_detect(swd_host_t *host) {
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    host->_cm_line = 0;
+    host->_cm_range_cnt = 0;
+
+    // CLIDR reads as zero on cores without caches
+    uint32_t clidr;
+    swd_err_t err = swd_host_memory_read_word(host, CLIDR, &clidr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (!(clidr & CLIDR_CTYPE1)) {
+        SWD_LOGI("Detected caches: no");
+        return SWD_OK;
+    }
+
+    uint32_t ctr;
+    err = swd_host_memory_read_word(host, CTR, &ctr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    uint32_t iline = 4u << CTR_IMINLINE(ctr);
+    uint32_t dline = 4u << CTR_DMINLINE(ctr);
+
+    // Level 1 data cache geometry
+    uint32_t ccsidr;
+    err = swd_host_memory_write_word(host, CSSELR, 0);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = swd_host_memory_read_word(host, CCSIDR, &ccsidr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    host->_cm_sets = CCSIDR_SETS(ccsidr);
+    host->_cm_ways = CCSIDR_WAYS(ccsidr);
+    host->_cm_set_shift = (uint8_t)(CCSIDR_LINE_SIZE(ccsidr) + 4);
+    host->_cm_way_shift = 32;
+    while (host->_cm_way_shift > 0 && (1u << (32 - host->_cm_way_shift)) < host->_cm_ways) {
+        host->_cm_way_shift--;
+    }
+
+    host->_cm_line = (iline < dline) ? iline : dline;
+    SWD_LOGI("Detected caches: %" PRIu32 " byte lines, D-cache of %" PRIu32 " sets of %" PRIu32
+             " ways",
+             host->_cm_line, host->_cm_sets, host->_cm_ways);
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+
+    return SWD_OK;
+}
+
+void _swd_host_cache_maint_track(swd_host_t *host, uint32_t addr, uint32_t len) {
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    if (host->_cm_line == 0 || len == 0) {
+        return;
+    }
+
+    // Only memory is cached, device and system regions never are
+    const swd_host_region_t *region = swd_host_region_find(host, addr);
+    if (region == NULL || (region->type != SWD_REGION_RAM && region->type != SWD_REGION_FLASH)) {
+        return;
+    }
+
+    uint32_t mask = ~(host->_cm_line - 1);
+    uint32_t start = addr & mask;
+    uint32_t last = (uint32_t)(((uint64_t)addr + len - 1) & mask);
+
+    // Grow a range which overlaps or touches the new one, else take a free entry, else grow
+    // the range with the smallest gap to it
+    uint32_t best = 0;
+    uint64_t best_gap = UINT64_MAX;
+    for (uint32_t i = 0; i < host->_cm_range_cnt; i++) {
+        const swd_host_cache_range_t *range = &host->_cm_ranges[i];
+        uint64_t gap = 0;
+        if (start > range->last) {
+            gap = (uint64_t)start - range->last - host->_cm_line;
+        } else if (last < range->start) {
+            gap = (uint64_t)range->start - last - host->_cm_line;
+        }
+        if (gap < best_gap) {
+            best = i;
+            best_gap = gap;
+        }
+    }
+
+    if (best_gap > 0 && host->_cm_range_cnt < SWD_HOST_CACHE_MAINT_RANGES) {
+        host->_cm_ranges[host->_cm_range_cnt].start = start;
+        host->_cm_ranges[host->_cm_range_cnt].last = last;
+        host->_cm_range_cnt++;
+        return;
+    }
+
+    swd_host_cache_range_t *range = &host->_cm_ranges[best];
+    range->start = (start < range->start) ? start : range->start;
+    range->last = (last > range->last) ? last : range->last;
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+}
+
+swd_err_t _swd_host_cache_maint_flush(swd_host_t *host) {
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    if (host->_cm_range_cnt == 0) {
+        return SWD_OK;
+    }
+
+    // Nothing can be stale in a disabled cache
+    uint32_t ccr;
+    swd_err_t err = swd_host_memory_read_word(host, CCR, &ccr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    uint32_t dc = (ccr & CCR_DC) ? 1 : 0;
+    uint32_t ic = (ccr & CCR_IC) ? 1 : 0;
+
+    // By address, each line takes a write per enabled cache. Once that is more than the lines
+    // of the D-cache, it is maintained by set and way and the I-cache invalidated as a whole
+    uint64_t lines = 0;
+    for (uint32_t i = 0; i < host->_cm_range_cnt; i++) {
+        lines += (host->_cm_ranges[i].last - host->_cm_ranges[i].start) / host->_cm_line + 1;
+    }
+    uint64_t by_addr = lines * (dc + ic);
+    uint64_t whole = dc * (uint64_t)host->_cm_sets * host->_cm_ways + ic;
+
+    if (by_addr <= whole) {
+        SWD_LOGD("Cache maintenance of %" PRIu64 " lines by address", lines);
+        if (dc) {
+            err = _swd_host_cache_maint_lines(host, DCCIMVAC);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+        if (ic) {
+            err = _swd_host_cache_maint_lines(host, ICIMVAU);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+    } else {
+        SWD_LOGD("Cache maintenance of %" PRIu64 " lines on the whole caches", lines);
+        if (dc) {
+            err = _swd_host_cache_maint_dcache_all(host);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+        if (ic) {
+            err = swd_host_memory_write_word(host, ICIALLU, 0);
+            SWD_HOST_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    host->_cm_range_cnt = 0;
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_cache_maint_lines(swd_host_t *host, uint32_t reg) {
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    uint32_t buf[SWD_HOST_XFER_CHUNK_WORDS];
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < host->_cm_range_cnt; i++) {
+        const swd_host_cache_range_t *range = &host->_cm_ranges[i];
+        for (uint64_t addr = range->start; addr <= range->last; addr += host->_cm_line) {
+            buf[n++] = (uint32_t)addr;
+            if (n == SWD_HOST_XFER_CHUNK_WORDS) {
+                swd_err_t err = _swd_host_write_repeat(host, reg, buf, n);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                n = 0;
+            }
+        }
+    }
+
+    if (n > 0) {
+        swd_err_t err = _swd_host_write_repeat(host, reg, buf, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_cache_maint_dcache_all(swd_host_t *host) {
+#if SWD_HOST_CACHE_MAINT_RANGES > 0
+    uint32_t buf[SWD_HOST_XFER_CHUNK_WORDS];
+    uint32_t n = 0;
+
+    for (uint32_t way = 0; way < host->_cm_ways; way++) {
+        uint32_t way_bits = (host->_cm_way_shift < 32) ? way << host->_cm_way_shift : 0;
+        for (uint32_t set = 0; set < host->_cm_sets; set++) {
+            buf[n++] = way_bits | (set << host->_cm_set_shift);
+            if (n == SWD_HOST_XFER_CHUNK_WORDS) {
+                swd_err_t err = _swd_host_write_repeat(host, DCCISW, buf, n);
+                SWD_HOST_RETURN_IF_NON_OK(err);
+                n = 0;
+            }
+        }
+    }
+
+    if (n > 0) {
+        swd_err_t err = _swd_host_write_repeat(host, DCCISW, buf, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+#endif // SWD_HOST_CACHE_MAINT_RANGES > 0
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_write_repeat(swd_host_t *host, uint32_t addr, const uint32_t *buf,
+                                 uint32_t cnt) {
+    swd_err_t err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    err = _swd_host_set_tar(host, addr);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    _swd_host_cache_invalidate_range(host, addr, 4);
+    err = swd_dap_port_write_block(host->dap, AP_DRW, buf, cnt);
+    if (err != SWD_OK) {
+        SWD_LOGW("Repeated write of 0x%08" PRIx32 " failed", addr);
+        host->_tar_valid = false;
+        return err;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_reg_transfer_read(swd_host_t *host, swd_target_register_t reg,
+                                      uint32_t *data, uint32_t *_Nullable dhcsr) {
+    uint32_t regsel = swd_target_register_as_regsel(reg, true);
+    if (regsel == DCRSR_REGSEL_ERR) {
+        return SWD_HOST_INVALID_REGISTER;
+    }
+    swd_err_t err = swd_host_window_write(host, DCRSR, regsel);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // DHCSR and DCRDR share a window, so one pipelined sequence reads both. DCRDR was read
+    // after DHCSR, so it holds the register whenever S_REGRDY is set
+    swd_dap_port_t ports[2];
+    err = _swd_host_set_window(host, DHCSR, &ports[0]);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    ports[1] = (swd_dap_port_t)(ports[0] + ((DCRDR - DHCSR) >> 2));
+
+    uint32_t vals[2];
+    int32_t retry_count = REGRDY_READ_RETRY_CNT;
+    do {
+        err = swd_dap_port_read_multi(host->dap, ports, vals, 2);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        _swd_host_dhcsr_observe(host, vals[0]);
+
+        if (vals[0] & S_REGRDY) {
+            *data = vals[1];
+            if (dhcsr != NULL) {
+                *dhcsr = vals[0];
+            }
+            return SWD_OK;
+        }
+    } while ((retry_count--) > 0);
+
+    return SWD_ERR;
+}
+
+swd_err_t _swd_host_reg_transfer_write(swd_host_t *host, swd_target_register_t reg,
+                                       uint32_t data) {
+    uint32_t regsel = swd_target_register_as_regsel(reg, false);
+    if (regsel == DCRSR_REGSEL_ERR) {
+        return SWD_HOST_INVALID_REGISTER;
+    }
+
+    swd_err_t err = swd_host_window_write(host, DCRDR, data);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = swd_host_window_write(host, DCRSR, regsel);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
+    // DCRDR can not be touched again until the transfer completes
+    uint32_t dhcsr;
+    int32_t retry_count = REGRDY_READ_RETRY_CNT;
+    do {
+        err = swd_host_window_read(host, DHCSR, &dhcsr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        if (dhcsr & S_REGRDY) {
+            return SWD_OK;
+        }
+    } while ((retry_count--) > 0);
+
+    return SWD_ERR;
+}
+
+swd_err_t _swd_host_reg_cached_read(swd_host_t *host, swd_target_register_t reg,
+                                    uint32_t *data) {
+    if (reg >= REG_CNT) {
+        return SWD_HOST_INVALID_REGISTER;
+    }
+
+    if (!(host->_regs_valid & SWD_REG_SET(reg))) {
+        swd_err_t err = _swd_host_reg_transfer_read(host, reg, &host->_regs[reg], NULL);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        host->_regs_valid |= SWD_REG_SET(reg);
+    }
+
+    *data = host->_regs[reg];
     return SWD_OK;
 }
 
-swd_err_t _swd_host_enable_arch_configs(swd_host_t *host) {
-    // Enable the Flash Patch and Breakpoint unit
-    SWD_LOGI("Enabling FPB Unit");
-    uint32_t fp_ctrl;
-    swd_err_t err;
-    swd_host_memory_write_word(host, FP_CTRL, KEY | ENABLE);
-    err = swd_host_memory_read_word(host, FP_CTRL, &fp_ctrl);
+swd_target_register_set_t _swd_host_reg_aliases(swd_target_register_t reg) {
+    switch (reg) {
+    case REG_SP:
+        return SWD_REG_SET(REG_MSP) | SWD_REG_SET(REG_PSP);
+    case REG_MSP:
+    case REG_PSP:
+        return SWD_REG_SET(REG_SP);
+    case REG_CONTROL_FAULTMASK_BASEPRI_PRIMASK:
+        // CONTROL.SPSEL picks which stack pointer SP is
+        return SWD_REG_SET(REG_SP);
+    default:
+        return 0;
+    }
+}
+
+void _swd_host_dhcsr_observe(swd_host_t *host, uint32_t dhcsr) {
+    host->_dhcsr_sticky |= dhcsr & (S_RESET_ST | S_RETIRE_ST);
+}
+
+void _swd_host_monitor_kick(swd_host_t *host) {
+    host->_mon_poll_now = true;
+    host->_mon_interval = SWD_HOST_MONITOR_MIN_INTERVAL;
+}
+
+void _swd_host_monitor_dispatch(swd_host_t *host, swd_host_event_t event, uint32_t reason) {
+    if (host->_mon_cb != NULL) {
+        host->_mon_cb(host, event, reason, host->_mon_ctx);
+    }
+}
+
+void _swd_host_target_resumed(swd_host_t *host) {
+    host->_target_halted = false;
+    host->_regs_valid = 0;
+    host->_regs_dirty = 0;
+    _swd_host_cache_invalidate(host);
+}
+
+swd_err_t _swd_host_read_words(swd_host_t *host, uint32_t addr, uint32_t *buf, uint32_t cnt) {
+    while (cnt > 0) {
+        // Number of words left before TAR needs to be written again
+        uint32_t span = (TAR_AUTOINC_BOUNDARY - (addr & (TAR_AUTOINC_BOUNDARY - 1))) / 4;
+        span = (span < cnt) ? span : cnt;
+
+        swd_err_t err = _swd_host_set_tar(host, addr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        err = swd_dap_port_read_block(host->dap, AP_DRW, buf, span);
+        if (err != SWD_OK) {
+            SWD_LOGW("Pipelined read failed in block 0x%08" PRIx32, addr);
+            host->_tar_valid = false;
+            return err;
+        }
+        _swd_host_tar_advance(host, span);
+
+        addr += 4 * span;
+        buf += span;
+        cnt -= span;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_write_words(swd_host_t *host, uint32_t addr, const uint32_t *buf,
+                                uint32_t cnt) {
+    while (cnt > 0) {
+        uint32_t span = (TAR_AUTOINC_BOUNDARY - (addr & (TAR_AUTOINC_BOUNDARY - 1))) / 4;
+        span = (span < cnt) ? span : cnt;
+
+        swd_err_t err = _swd_host_set_tar(host, addr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+
+        _swd_host_cache_invalidate_range(host, addr, 4 * span);
+        err = swd_dap_port_write_block(host->dap, AP_DRW, buf, span);
+        if (err != SWD_OK) {
+            SWD_LOGW("Block write failed in block 0x%08" PRIx32, addr);
+            host->_tar_valid = false;
+            return err;
+        }
+        _swd_host_tar_advance(host, span);
+
+        addr += 4 * span;
+        buf += span;
+        cnt -= span;
+    }
+
+    return SWD_OK;
+}
+
+void _swd_host_iov_sort(const swd_host_iovec_t *iov, uint16_t *order, uint32_t cnt) {
+    // Batches are small, an insertion sort keeps equal addresses in caller order
+    for (uint32_t i = 0; i < cnt; i++) {
+        uint32_t j = i;
+        while (j > 0 && iov[order[j - 1]].addr > iov[i].addr) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = (uint16_t)i;
+    }
+}
+
+void _swd_host_iov_copy(const swd_host_iovec_t *iov, const uint16_t *order, uint32_t first,
+                        uint32_t last, uint32_t addr, uint32_t *words, uint32_t cnt,
+                        bool to_iov) {
+    uint64_t win_start = addr;
+    uint64_t win_end = win_start + 4 * (uint64_t)cnt;
+
+    for (uint32_t k = first; k < last; k++) {
+        const swd_host_iovec_t *seg = &iov[order[k]];
+        uint64_t seg_start = seg->addr;
+        uint64_t seg_end = seg_start + seg->len;
+        uint64_t lo = (seg_start > win_start) ? seg_start : win_start;
+        uint64_t hi = (seg_end < win_end) ? seg_end : win_end;
+
+        for (uint64_t x = lo; x < hi; x++) {
+            uint32_t off = (uint32_t)(x - win_start);
+            uint8_t shamt = 8 * (off & 0x3);
+            if (to_iov) {
+                seg->buf[x - seg_start] = (words[off >> 2] >> shamt) & 0xFF;
+            } else {
+                words[off >> 2] = (words[off >> 2] & ~(0xFFu << shamt)) |
+                                  ((uint32_t)seg->buf[x - seg_start] << shamt);
+            }
+        }
+    }
+}
+
+swd_err_t _swd_host_iov_write_partial(swd_host_t *host, const swd_host_iovec_t *iov,
+                                      const uint16_t *order, uint32_t first, uint32_t last,
+                                      uint32_t addr, uint32_t cnt) {
+    uint32_t word = 0;
+    uint8_t bytes[4];
+
+    _swd_host_iov_copy(iov, order, first, last, addr & ~0x3, &word, 1, false);
+    for (uint32_t i = 0; i < cnt; i++) {
+        bytes[i] = (word >> (8 * ((addr & 0x3) + i))) & 0xFF;
+    }
+
+    return _swd_host_write_partial_word(host, addr, bytes, cnt);
+}
+
+swd_err_t _swd_host_fpb_write_bank(swd_host_t *host, uint32_t first, const uint32_t *comps,
+                                   uint32_t cnt) {
+    if (cnt == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    if (!(fp_ctrl & ENABLE)) {
-        SWD_LOGW("FPB unit failed to set ENABLE");
-        return SWD_HOST_NOT_STARTED;
+    err = _swd_host_write_words(host, FP_CMPN + (4 * first), comps, cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // The write is posted, a fault on it is only acknowledged by the CSW write following it
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    for (uint32_t i = 0; i < cnt; i++) {
+        host->_fp_comp[first + i] = comps[i];
     }
 
     return SWD_OK;
 }
 
-swd_err_t _swd_host_detect_arch_configs(swd_host_t *host) {
-    // Read FPB version
-    uint32_t fp_ctrl;
-    swd_err_t err = swd_host_memory_read_word(host, FP_CTRL, &fp_ctrl);
+swd_err_t _swd_host_patch_write_table(swd_host_t *host) {
+    uint32_t table[SWD_HOST_MAX_FPB_COMPARATORS] = {0};
+    uint32_t cnt = host->code_cmp_cnt + host->_lit_cmp_cnt;
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (host->_patch_mask & (1u << i)) {
+            table[i] = host->_patches[i].data;
+        }
+    }
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_write_words(host, host->_remap_table, table, cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_set_addr_inc(host, false);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
-    host->_fpb_version = (uint8_t)(fp_ctrl >> 28);
-    const char *v_str;
-    switch (host->_fpb_version) {
-    case FPB_VERSION_1:
-        v_str = "v1";
-        break;
-    case FPB_VERSION_2:
-        v_str = "v2";
-        break;
-    default:
-        SWD_LOGE("Cannot detect FPB version");
-        return SWD_HOST_START_ERR;
+    return swd_host_memory_write_word(host, FP_REMAP, host->_remap_table & REMAP_MASK);
+}
+
+swd_err_t _swd_host_dwt_write_cmp(swd_host_t *host, uint32_t idx, uint32_t comp, uint32_t mask,
+                                  uint32_t func) {
+    const uint32_t regs[3] = {comp, mask, func};
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_write_words(host, DWT_COMP0 + DWT_CMP_STRIDE * idx, regs, 3);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    host->_dwt_func[idx] = func;
+
+    return _swd_host_set_addr_inc(host, false);
+}
+
+uint32_t _swd_host_dwt_first(swd_host_t *host, uint32_t cmps) {
+    uint32_t i = 0;
+    while (i < host->_dwt_cmp_cnt && !(cmps & (1u << i))) {
+        i++;
     }
-    SWD_LOGI("Detected FPB version: %s", v_str);
+    return i;
+}
 
-    // Get the number of code comparators (breakpoint addresses)
-    host->code_cmp_cnt = (uint8_t)((fp_ctrl & 0x7000) >> 0x8) | ((fp_ctrl & 0xF0) >> 0x4);
-    SWD_LOGI("Detected number of code comparators (HW Breakpoints): %" PRIu8, host->code_cmp_cnt);
-    SWD_LOGI("Detected number of literal comparators (FP Remaps): %" PRIu8,
-             (uint8_t)((fp_ctrl & 0xF00) >> 0x8));
-    SWD_LOGI("Note that literal comparators are not used");
+swd_err_t _swd_host_dwt_matched(swd_host_t *host, uint32_t *matched) {
+    // One burst over all the comparator registers beats a TAR write per FUNCTION register
+    uint32_t regs[4 * SWD_HOST_MAX_DWT_COMPARATORS];
+
+    swd_err_t err = _swd_host_set_addr_inc(host, true);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_read_words(host, DWT_COMP0, regs, 4 * host->_dwt_cmp_cnt);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    err = _swd_host_set_addr_inc(host, false);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    *matched = 0;
+    for (uint32_t i = 0; i < host->_dwt_cmp_cnt; i++) {
+        *matched |= (regs[4 * i + 2] & DWT_MATCHED) ? (1u << i) : 0;
+    }
 
     return SWD_OK;
 }
 
-swd_err_t _swd_host_dap_port_write_masked(swd_host_t *host, swd_dap_port_t port, uint32_t data,
-                                          uint32_t mask) {
-    uint32_t rd_data;
-    swd_err_t err = swd_dap_port_read(host->dap, port, &rd_data);
+bool _swd_host_fpb_bkpt_at(swd_host_t *host, uint32_t addr) {
+    // FPB v1 comparators match words, a false positive only costs disabling the FPB for a step
+    uint32_t match_mask = (host->_fpb_version == FPB_VERSION_1) ? 0x1FFFFFFC : 0xFFFFFFFE;
+    for (uint32_t i = 0; i < host->code_cmp_cnt; i++) {
+        uint32_t comp = host->_fp_comp[i];
+        if (!(host->_patch_mask & (1u << i)) && (comp & ENABLE) &&
+            (comp & match_mask) == (addr & match_mask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+swd_err_t _swd_host_trace(swd_host_t *host, const swd_host_trace_cfg_t *cfg,
+                          _swd_host_trace_record_t _Nullable record, void *_Nullable ctx,
+                          uint32_t *cnt) {
+    *cnt = 0;
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
     SWD_HOST_RETURN_IF_NON_OK(err);
-    err = swd_dap_port_write(host->dap, port, (rd_data & ~mask) | (data & mask));
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    err = swd_host_registers_commit(host);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    uint32_t pc;
+    err = _swd_host_reg_cached_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    // C_MASKINTS may only change while halted, so it is set before the first step
+    uint32_t maskints = cfg->mask_ints ? C_MASKINTS : 0;
+    if (maskints) {
+        err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN | C_HALT | maskints);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    }
+
+    _swd_host_monitor_kick(host);
+    host->_mon_stepping = true;
+
+    while (*cnt < cfg->max_steps) {
+        err = (record != NULL) ? record(ctx, pc) : SWD_OK;
+        if (err != SWD_OK) {
+            break;
+        }
+        (*cnt)++;
+
+        bool on_sw_bkpt = false;
+        if (host->_sw_bkpt_cnt > 0) {
+            _swd_host_sw_bkpt_probe(host, pc, &on_sw_bkpt);
+        }
+
+        if (on_sw_bkpt) {
+            bool stepped;
+            err = _swd_host_sw_bkpt_step_over(host, maskints, &stepped);
+        } else {
+            // A hardware breakpoint under the PC would halt the step right away
+            bool on_bkpt = _swd_host_fpb_bkpt_at(host, pc);
+            _swd_host_target_resumed(host);
+            if (on_bkpt) {
+                err = swd_host_memory_write_word(host, FP_CTRL, KEY);
+            }
+            if (err == SWD_OK) {
+                err = swd_host_window_write(host, DHCSR,
+                                            DBG_KEY | C_STEP | C_DEBUGEN | maskints);
+            }
+            if (err == SWD_OK && on_bkpt) {
+                err = swd_host_memory_write_word(host, FP_CTRL, KEY | ENABLE);
+            }
+        }
+        if (err != SWD_OK) {
+            break;
+        }
+
+        // A step takes a few core cycles, it is normally over before the DCRSR write reaches
+        // the core. A slower one, ex. a load stalled on the bus, is waited for and the PC read
+        // again, DCRSR is ignored while the core runs
+        uint32_t dhcsr;
+        err = _swd_host_reg_transfer_read(host, REG_DEBUG_RETURN_ADDRESS, &pc, &dhcsr);
+        for (int32_t retry = 0; err == SWD_OK && !(dhcsr & S_HALTED); retry++) {
+            if (retry == REGRDY_READ_RETRY_CNT) {
+                SWD_LOGW("Core did not halt after a step");
+                err = SWD_TARGET_NOT_HALTED;
+                break;
+            }
+            err = swd_host_window_read(host, DHCSR, &dhcsr);
+            if (err != SWD_OK) {
+                break;
+            }
+            if (dhcsr & S_HALTED) {
+                err = _swd_host_reg_transfer_read(host, REG_DEBUG_RETURN_ADDRESS, &pc, &dhcsr);
+            }
+        }
+        if (err != SWD_OK) {
+            break;
+        }
+        host->_target_halted = true;
+        host->_regs[REG_DEBUG_RETURN_ADDRESS] = pc;
+        host->_regs_valid = SWD_REG_SET(REG_DEBUG_RETURN_ADDRESS);
+
+        if (cfg->stop_len > 0 && pc - cfg->stop_addr < cfg->stop_len) {
+            break;
+        }
+    }
+
+    if (maskints) {
+        swd_err_t unmask_err = swd_host_window_write(host, DHCSR, DBG_KEY | C_DEBUGEN | C_HALT);
+        err = (err == SWD_OK) ? unmask_err : err;
+    }
+
+    return err;
+}
+
+swd_err_t _swd_host_trace_store(void *ctx, uint32_t pc) {
+    _swd_host_trace_store_ctx_t *store = ctx;
+    store->pcs[store->cnt++] = pc;
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_trace_encode(void *ctx, uint32_t pc) {
+    _swd_host_trace_encode_ctx_t *enc = ctx;
+
+    // A varint of a 32-bit value takes at most 5 bytes
+    if (enc->len + 5 > sizeof(enc->buf)) {
+        swd_err_t err = enc->consumer(enc->ctx, enc->offset, enc->buf, enc->len);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+        enc->offset += enc->len;
+        enc->len = 0;
+    }
+
+    int32_t delta = (int32_t)(pc - enc->prev) / 2;
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    do {
+        uint8_t byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        enc->buf[enc->len++] = byte | (zigzag ? 0x80 : 0);
+    } while (zigzag);
+    enc->prev = pc;
+
+    return SWD_OK;
+}
+
+bool _swd_host_sw_bkpt_capable(swd_host_t *host, uint32_t addr) {
+    const swd_host_region_t *region = swd_host_region_find(host, addr);
+    return !(addr & 0x1) && region != NULL && region->type == SWD_REGION_RAM;
+}
+
+uint32_t _swd_host_sw_bkpt_hash(uint32_t addr) {
+    // Fibonacci hashing of the halfword index
+    return (((addr >> 1) * 2654435769u) >> 16) & (SWD_HOST_SW_BKPT_SLOTS - 1);
+}
+
+uint32_t _swd_host_sw_bkpt_probe(swd_host_t *host, uint32_t addr, bool *found) {
+    uint32_t slot = _swd_host_sw_bkpt_hash(addr);
+
+    // The table is never full, so an empty slot ends every probe
+    while (host->_sw_bkpts[slot].used) {
+        if (host->_sw_bkpts[slot].addr == addr) {
+            *found = true;
+            return slot;
+        }
+        slot = (slot + 1) & (SWD_HOST_SW_BKPT_SLOTS - 1);
+    }
+
+    *found = false;
+    return slot;
+}
+
+void _swd_host_sw_bkpt_delete(swd_host_t *host, uint32_t slot) {
+    const uint32_t mask = SWD_HOST_SW_BKPT_SLOTS - 1;
+    uint32_t hole = slot;
+
+    // Shift later entries of the probe sequence back instead of leaving a tombstone
+    for (uint32_t i = (slot + 1) & mask; host->_sw_bkpts[i].used; i = (i + 1) & mask) {
+        uint32_t home = _swd_host_sw_bkpt_hash(host->_sw_bkpts[i].addr);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            host->_sw_bkpts[hole] = host->_sw_bkpts[i];
+            hole = i;
+        }
+    }
+
+    host->_sw_bkpts[hole].used = false;
+    host->_sw_bkpt_cnt--;
+}
+
+swd_err_t _swd_host_sw_bkpt_remove_unless(swd_host_t *host, const uint32_t *_Nullable keep,
+                                          uint32_t keep_cnt) {
+    uint32_t batch[SWD_HOST_IOV_BATCH_SIZE];
+    uint32_t n;
+
+    do {
+        n = 0;
+        for (uint32_t slot = 0; slot < SWD_HOST_SW_BKPT_SLOTS && n < SWD_HOST_IOV_BATCH_SIZE;
+             slot++) {
+            if (!host->_sw_bkpts[slot].used) {
+                continue;
+            }
+            bool kept = false;
+            for (uint32_t k = 0; k < keep_cnt && !kept; k++) {
+                kept = keep[k] == host->_sw_bkpts[slot].addr;
+            }
+            if (!kept) {
+                batch[n++] = host->_sw_bkpts[slot].addr;
+            }
+        }
+
+        swd_err_t err = swd_host_remove_sw_breakpoints(host, batch, n);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    } while (n == SWD_HOST_IOV_BATCH_SIZE);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_host_sw_bkpt_step_over(swd_host_t *host, uint32_t maskints, bool *stepped) {
+    *stepped = false;
+    if (host->_sw_bkpt_cnt == 0) {
+        return SWD_OK;
+    }
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_OK;
+    }
+
+    uint32_t pc;
+    err = _swd_host_reg_cached_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
     SWD_HOST_RETURN_IF_NON_OK(err);
 
+    bool found;
+    uint32_t slot = _swd_host_sw_bkpt_probe(host, pc, &found);
+    if (!found) {
+        return SWD_OK;
+    }
+
+    SWD_LOGD("Stepping over software breakpoint at 0x%08" PRIx32, pc);
+    uint8_t orig[2] = {host->_sw_bkpts[slot].orig & 0xFF, host->_sw_bkpts[slot].orig >> 8};
+    err = _swd_host_write_span(host, pc, orig, 2, NULL);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    _swd_host_target_resumed(host);
+    err = swd_host_window_write(host, DHCSR, DBG_KEY | C_STEP | C_DEBUGEN | maskints);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    uint32_t dhcsr = 0;
+    int32_t retry_count = REGRDY_READ_RETRY_CNT;
+    do {
+        err = swd_host_window_read(host, DHCSR, &dhcsr);
+        SWD_HOST_RETURN_IF_NON_OK(err);
+    } while (!(dhcsr & S_HALTED) && (retry_count--) > 0);
+    host->_target_halted = dhcsr & S_HALTED;
+
+    // Put the breakpoint back even if the step did not complete
+    static const uint8_t bkpt[2] = {THUMB_BKPT & 0xFF, THUMB_BKPT >> 8};
+    err = _swd_host_write_span(host, pc, bkpt, 2, NULL);
+    SWD_HOST_RETURN_IF_NON_OK(err);
+
+    if (!(dhcsr & S_HALTED)) {
+        SWD_LOGW("Core did not halt after stepping over 0x%08" PRIx32, pc);
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    *stepped = true;
     return SWD_OK;
 }
 
@@ -0,0 +1,697 @@
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef SWD_IMAGE_ENABLE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // SWD_IMAGE_ENABLE_MMAP
+
+#include "swd_err.h"
+#include "swd_flash.h"
+#include "swd_host.h"
+#include "swd_image.h"
+#include "swd_log.h"
+#include "swd_target_register.h"
+
+#include "_swd_arch_addr_decl.h"
+
+// ELF32 header and program header layout
+#define ELF_EHDR_SIZE (52)
+#define ELF_CLASS_32 (1)
+#define ELF_DATA_LSB (1)
+#define ELF_E_ENTRY (24)
+#define ELF_E_PHOFF (28)
+#define ELF_E_PHENTSIZE (42)
+#define ELF_E_PHNUM (44)
+#define ELF_PHDR_SIZE (32)
+#define ELF_P_TYPE (0)
+#define ELF_P_OFFSET (4)
+#define ELF_P_VADDR (8)
+#define ELF_P_PADDR (12)
+#define ELF_P_FILESZ (16)
+#define ELF_PT_LOAD (1)
+
+// ELF32 section header and symbol layout
+#define ELF_E_SHOFF (32)
+#define ELF_E_SHENTSIZE (46)
+#define ELF_E_SHNUM (48)
+#define ELF_E_SHSTRNDX (50)
+#define ELF_SHDR_SIZE (40)
+#define ELF_SH_NAME (0)
+#define ELF_SH_TYPE (4)
+#define ELF_SH_ADDR (12)
+#define ELF_SH_OFFSET (16)
+#define ELF_SH_SIZE (20)
+#define ELF_SH_LINK (24)
+#define ELF_SHT_SYMTAB (2)
+#define ELF_SHT_NOBITS (8)
+#define ELF_SYM_SIZE (16)
+#define ELF_ST_NAME (0)
+#define ELF_ST_VALUE (4)
+
+// Intel HEX record types
+#define HEX_DATA (0x00)
+#define HEX_EOF (0x01)
+#define HEX_EXT_SEGMENT_ADDR (0x02)
+#define HEX_START_SEGMENT_ADDR (0x03)
+#define HEX_EXT_LINEAR_ADDR (0x04)
+#define HEX_START_LINEAR_ADDR (0x05)
+
+/*
+ * Decoded Intel HEX record
+ */
+typedef struct _swd_image_hex_rec_t {
+    uint8_t type;
+    uint8_t len;
+    uint16_t addr;
+    uint8_t data[255];
+} _swd_image_hex_rec_t;
+
+/*
+ * Merges the loaded content into blocks ending on SWD_IMAGE_CHUNK_BYTES boundaries
+ */
+typedef struct _swd_image_emitter_t {
+    swd_image_sink_t sink;
+    void *ctx;
+    uint8_t chunk[SWD_IMAGE_CHUNK_BYTES];
+    uint32_t chunk_addr;
+    uint32_t chunk_len;
+    /*
+     * End of the content emitted so far
+     */
+    uint64_t end;
+    uint64_t bytes;
+    uint32_t ranges;
+} _swd_image_emitter_t;
+
+uint32_t _swd_image_le16(const uint8_t *p);
+uint32_t _swd_image_le32(const uint8_t *p);
+
+/*
+ * @brief Decode the record starting at or after `pos`, skipping line breaks. `pos` is moved
+ *          past the record
+ */
+swd_err_t _swd_image_hex_next(const swd_image_t *img, size_t *pos, _swd_image_hex_rec_t *rec);
+
+/*
+ * @brief Value of the two hex digits at `p`, -1 if they are not hex digits
+ */
+int _swd_image_hex_byte(const uint8_t *p);
+
+/*
+ * @brief Section header `idx` of an ELF image, NULL if it is out of the file
+ */
+const uint8_t *_swd_image_elf_shdr(const swd_image_t *img, uint32_t idx);
+
+/*
+ * @brief Whether the string at `offset` of the string table section `strtab` is `name`
+ */
+bool _swd_image_elf_name_is(const swd_image_t *img, const uint8_t *strtab, uint32_t offset,
+                            const char *name);
+
+swd_err_t _swd_image_load_elf(const swd_image_t *img, _swd_image_emitter_t *em);
+swd_err_t _swd_image_load_hex(const swd_image_t *img, _swd_image_emitter_t *em);
+
+/*
+ * @brief Append content to the emitter. Chunk aligned parts go straight from the image to the
+ *          sink when nothing is staged. Content has to come in ascending address order
+ */
+swd_err_t _swd_image_emit(_swd_image_emitter_t *em, uint32_t addr, const uint8_t *data,
+                          uint32_t len);
+swd_err_t _swd_image_flush(_swd_image_emitter_t *em);
+
+swd_err_t swd_image_open(swd_image_t *img, const uint8_t *data, size_t size, uint32_t bin_base) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(data != NULL || size == 0);
+
+    img->data = data;
+    img->size = size;
+    img->bin_base = bin_base;
+    img->entry = 0;
+    img->has_entry = false;
+    img->_mapped = false;
+
+    size_t start = 0;
+    while (start < size && (data[start] == '\r' || data[start] == '\n')) {
+        start++;
+    }
+
+    if (size >= ELF_EHDR_SIZE && memcmp(data, "\x7F" "ELF", 4) == 0) {
+        img->format = SWD_IMAGE_ELF;
+        if (data[4] != ELF_CLASS_32 || data[5] != ELF_DATA_LSB) {
+            SWD_LOGE("Only 32-bit little endian ELF images are supported");
+            return SWD_IMAGE_INVALID;
+        }
+
+        uint32_t phoff = _swd_image_le32(&data[ELF_E_PHOFF]);
+        uint32_t phentsize = _swd_image_le16(&data[ELF_E_PHENTSIZE]);
+        uint32_t phnum = _swd_image_le16(&data[ELF_E_PHNUM]);
+        if (phentsize < ELF_PHDR_SIZE || phoff > size ||
+            (uint64_t)phentsize * phnum > size - phoff) {
+            SWD_LOGE("ELF program headers are out of the file");
+            return SWD_IMAGE_INVALID;
+        }
+        for (uint32_t i = 0; i < phnum; i++) {
+            const uint8_t *phdr = &data[phoff + i * phentsize];
+            uint64_t offset = _swd_image_le32(&phdr[ELF_P_OFFSET]);
+            uint64_t filesz = _swd_image_le32(&phdr[ELF_P_FILESZ]);
+            uint64_t paddr = _swd_image_le32(&phdr[ELF_P_PADDR]);
+            if (_swd_image_le32(&phdr[ELF_P_TYPE]) == ELF_PT_LOAD &&
+                (offset + filesz > size || paddr + filesz > ((uint64_t)1 << 32))) {
+                SWD_LOGE("ELF segment %" PRIu32 " is out of the file", i);
+                return SWD_IMAGE_INVALID;
+            }
+        }
+
+        img->entry = _swd_image_le32(&data[ELF_E_ENTRY]);
+        img->has_entry = true;
+    } else if (start < size && data[start] == ':') {
+        img->format = SWD_IMAGE_HEX;
+
+        // Check every record once, the start address record may be anywhere
+        _swd_image_hex_rec_t rec;
+        size_t pos = 0;
+        do {
+            swd_err_t err = _swd_image_hex_next(img, &pos, &rec);
+            SWD_RETURN_IF_NON_OK(err);
+
+            if (rec.type == HEX_START_SEGMENT_ADDR && rec.len == 4) {
+                // CS:IP, both big endian
+                uint32_t cs = ((uint32_t)rec.data[0] << 8) | rec.data[1];
+                uint32_t ip = ((uint32_t)rec.data[2] << 8) | rec.data[3];
+                img->entry = (cs << 4) + ip;
+                img->has_entry = true;
+            } else if (rec.type == HEX_START_LINEAR_ADDR && rec.len == 4) {
+                img->entry = ((uint32_t)rec.data[0] << 24) | ((uint32_t)rec.data[1] << 16) |
+                             ((uint32_t)rec.data[2] << 8) | rec.data[3];
+                img->has_entry = true;
+            }
+        } while (rec.type != HEX_EOF);
+    } else {
+        img->format = SWD_IMAGE_BIN;
+        if ((uint64_t)bin_base + size > ((uint64_t)1 << 32)) {
+            SWD_LOGE("Binary image does not fit at 0x%08" PRIx32, bin_base);
+            return SWD_IMAGE_INVALID;
+        }
+    }
+
+    return SWD_OK;
+}
+
+#ifdef SWD_IMAGE_ENABLE_MMAP
+swd_err_t swd_image_map(swd_image_t *img, const char *path, uint32_t bin_base) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(path != NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        SWD_LOGE("Failed to open %s", path);
+        return SWD_ERR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        SWD_LOGE("Failed to get the size of %s", path);
+        close(fd);
+        return SWD_ERR;
+    }
+
+    // The mapping keeps the file referenced once the descriptor is closed
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        SWD_LOGE("Failed to map %s", path);
+        return SWD_ERR;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    swd_err_t err = swd_image_open(img, map, (size_t)st.st_size, bin_base);
+    if (err != SWD_OK) {
+        munmap(map, (size_t)st.st_size);
+        return err;
+    }
+    img->_mapped = true;
+
+    return SWD_OK;
+}
+
+void swd_image_unmap(swd_image_t *img) {
+    SWD_ASSERT(img != NULL);
+
+    if (img->_mapped) {
+        munmap((void *)img->data, img->size);
+        img->_mapped = false;
+    }
+}
+#endif // SWD_IMAGE_ENABLE_MMAP
+
+swd_err_t swd_image_load(const swd_image_t *img, swd_image_sink_t sink, void *_Nullable ctx,
+                         swd_image_clock_t _Nullable clock, void *_Nullable clock_ctx,
+                         swd_image_stats_t *_Nullable stats) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(sink != NULL);
+
+    _swd_image_emitter_t em;
+    em.sink = sink;
+    em.ctx = ctx;
+    em.chunk_addr = 0;
+    em.chunk_len = 0;
+    em.end = 0;
+    em.bytes = 0;
+    em.ranges = 0;
+
+    uint32_t start = (clock != NULL) ? clock(clock_ctx) : 0;
+
+    swd_err_t err;
+    switch (img->format) {
+    case SWD_IMAGE_ELF:
+        err = _swd_image_load_elf(img, &em);
+        break;
+    case SWD_IMAGE_HEX:
+        err = _swd_image_load_hex(img, &em);
+        break;
+    default:
+        err = _swd_image_emit(&em, img->bin_base, img->data, (uint32_t)img->size);
+        break;
+    }
+    err = (err == SWD_OK) ? _swd_image_flush(&em) : err;
+    SWD_RETURN_IF_NON_OK(err);
+
+    uint32_t elapsed = (clock != NULL) ? clock(clock_ctx) - start : 0;
+    uint64_t rate = (elapsed > 0) ? (em.bytes * 1000000) / elapsed : 0;
+    SWD_LOGI("Loaded %" PRIu64 " bytes in %" PRIu32 " ranges, %" PRIu64 " B/s", em.bytes,
+             em.ranges, rate);
+
+    if (stats != NULL) {
+        stats->bytes = em.bytes;
+        stats->ranges = em.ranges;
+        stats->elapsed_us = elapsed;
+        stats->rate = (rate < UINT32_MAX) ? (uint32_t)rate : UINT32_MAX;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_image_sink_ram(void *_Nullable ctx, uint32_t addr, const uint8_t *data,
+                             uint32_t len) {
+    SWD_ASSERT(ctx != NULL);
+
+    return swd_host_memory_write_byte_block((swd_host_t *)ctx, addr, data, len, NULL);
+}
+
+swd_err_t swd_image_sink_flash(void *_Nullable ctx, uint32_t addr, const uint8_t *data,
+                               uint32_t len) {
+    SWD_ASSERT(ctx != NULL);
+
+    return swd_flash_program((swd_flash_t *)ctx, addr, data, len);
+}
+
+swd_err_t swd_image_run(swd_host_t *host, uint32_t vector_table) {
+    SWD_ASSERT(host != NULL);
+
+    if (vector_table & 0x7F) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    // Thread mode can not be entered while the NVIC still has an exception active
+    uint32_t xpsr;
+    swd_err_t err = swd_host_register_read(host, REG_XPSR, &xpsr);
+    SWD_RETURN_IF_NON_OK(err);
+    if (xpsr & XPSR_IPSR) {
+        SWD_LOGE("Core is halted in exception %" PRIu32 ", reset it before running an image",
+                 xpsr & XPSR_IPSR);
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    uint32_t msp;
+    uint32_t reset;
+    err = swd_host_memory_read_word(host, vector_table, &msp);
+    SWD_RETURN_IF_NON_OK(err);
+    err = swd_host_memory_read_word(host, vector_table + 4, &reset);
+    SWD_RETURN_IF_NON_OK(err);
+
+    err = swd_host_memory_write_word(host, VTOR, vector_table);
+    SWD_RETURN_IF_NON_OK(err);
+
+    // Same state as out of reset: privileged thread mode on MSP, interrupts enabled
+    err = swd_host_registers_stage(host, REG_CONTROL_FAULTMASK_BASEPRI_PRIMASK, 0);
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_MSP, msp) : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_XPSR, XPSR_T) : err;
+    err = (err == SWD_OK) ? swd_host_registers_stage(host, REG_DEBUG_RETURN_ADDRESS,
+                                                     reset & ~(uint32_t)0x1)
+                          : err;
+    SWD_RETURN_IF_NON_OK(err);
+
+    SWD_LOGI("Starting image at 0x%08" PRIx32 ", MSP 0x%08" PRIx32, reset, msp);
+    return swd_host_continue_target(host);
+}
+
+swd_err_t swd_image_elf_read(const swd_image_t *img, uint32_t addr, uint8_t *buf, uint32_t len) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(buf != NULL || len == 0);
+
+    if (img->format != SWD_IMAGE_ELF) {
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    const uint8_t *data = img->data;
+    uint32_t phoff = _swd_image_le32(&data[ELF_E_PHOFF]);
+    uint32_t phentsize = _swd_image_le16(&data[ELF_E_PHENTSIZE]);
+    uint32_t phnum = _swd_image_le16(&data[ELF_E_PHNUM]);
+    for (uint32_t i = 0; i < phnum; i++) {
+        const uint8_t *phdr = &data[phoff + i * phentsize];
+        uint32_t vaddr = _swd_image_le32(&phdr[ELF_P_VADDR]);
+        uint32_t filesz = _swd_image_le32(&phdr[ELF_P_FILESZ]);
+        if (_swd_image_le32(&phdr[ELF_P_TYPE]) == ELF_PT_LOAD && addr >= vaddr &&
+            (uint64_t)addr + len <= (uint64_t)vaddr + filesz) {
+            memcpy(buf, &data[_swd_image_le32(&phdr[ELF_P_OFFSET]) + (addr - vaddr)], len);
+            return SWD_OK;
+        }
+    }
+
+    return SWD_TARGET_INVALID_ADDR;
+}
+
+swd_err_t swd_image_elf_section(const swd_image_t *img, const char *name, bool *found,
+                                uint32_t *_Nullable addr, uint32_t *_Nullable size) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(name != NULL);
+    SWD_ASSERT(found != NULL);
+
+    *found = false;
+    if (img->format != SWD_IMAGE_ELF) {
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    uint32_t shnum = _swd_image_le16(&img->data[ELF_E_SHNUM]);
+    const uint8_t *shstrtab = _swd_image_elf_shdr(img, _swd_image_le16(&img->data[ELF_E_SHSTRNDX]));
+    if (shstrtab == NULL) {
+        return SWD_IMAGE_INVALID;
+    }
+
+    for (uint32_t i = 0; i < shnum; i++) {
+        const uint8_t *shdr = _swd_image_elf_shdr(img, i);
+        if (shdr == NULL) {
+            return SWD_IMAGE_INVALID;
+        }
+        if (_swd_image_elf_name_is(img, shstrtab, _swd_image_le32(&shdr[ELF_SH_NAME]), name)) {
+            *found = true;
+            if (addr != NULL) {
+                *addr = _swd_image_le32(&shdr[ELF_SH_ADDR]);
+            }
+            if (size != NULL) {
+                *size = _swd_image_le32(&shdr[ELF_SH_SIZE]);
+            }
+            return SWD_OK;
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t swd_image_elf_symbol(const swd_image_t *img, const char *name, bool *found,
+                               uint32_t *_Nullable value) {
+    SWD_ASSERT(img != NULL);
+    SWD_ASSERT(name != NULL);
+    SWD_ASSERT(found != NULL);
+
+    *found = false;
+    if (img->format != SWD_IMAGE_ELF) {
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    uint32_t shnum = _swd_image_le16(&img->data[ELF_E_SHNUM]);
+    for (uint32_t i = 0; i < shnum; i++) {
+        const uint8_t *symtab = _swd_image_elf_shdr(img, i);
+        if (symtab == NULL) {
+            return SWD_IMAGE_INVALID;
+        }
+        if (_swd_image_le32(&symtab[ELF_SH_TYPE]) != ELF_SHT_SYMTAB) {
+            continue;
+        }
+
+        const uint8_t *strtab = _swd_image_elf_shdr(img, _swd_image_le32(&symtab[ELF_SH_LINK]));
+        uint64_t offset = _swd_image_le32(&symtab[ELF_SH_OFFSET]);
+        uint64_t end = offset + _swd_image_le32(&symtab[ELF_SH_SIZE]);
+        if (strtab == NULL || end > img->size) {
+            return SWD_IMAGE_INVALID;
+        }
+
+        for (; offset + ELF_SYM_SIZE <= end; offset += ELF_SYM_SIZE) {
+            const uint8_t *sym = &img->data[offset];
+            if (_swd_image_elf_name_is(img, strtab, _swd_image_le32(&sym[ELF_ST_NAME]), name)) {
+                *found = true;
+                if (value != NULL) {
+                    *value = _swd_image_le32(&sym[ELF_ST_VALUE]);
+                }
+                return SWD_OK;
+            }
+        }
+    }
+
+    return SWD_OK;
+}
+
+uint32_t _swd_image_le16(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+uint32_t _swd_image_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+swd_err_t _swd_image_hex_next(const swd_image_t *img, size_t *pos, _swd_image_hex_rec_t *rec) {
+    const uint8_t *data = img->data;
+    size_t p = *pos;
+    while (p < img->size && (data[p] == '\r' || data[p] == '\n')) {
+        p++;
+    }
+
+    // ':' count(2) address(4) type(2) data checksum(2)
+    if (p + 11 > img->size || data[p] != ':') {
+        SWD_LOGE("Expected a HEX record at offset %zu", p);
+        return SWD_IMAGE_INVALID;
+    }
+    int len = _swd_image_hex_byte(&data[p + 1]);
+    if (len < 0 || p + 11 + 2 * (size_t)len > img->size) {
+        SWD_LOGE("Truncated HEX record at offset %zu", p);
+        return SWD_IMAGE_INVALID;
+    }
+
+    uint8_t sum = 0;
+    uint8_t raw[4 + 255 + 1];
+    for (int i = 0; i < 4 + len + 1; i++) {
+        int byte = _swd_image_hex_byte(&data[p + 1 + 2 * i]);
+        if (byte < 0) {
+            SWD_LOGE("Bad hex digit in the HEX record at offset %zu", p);
+            return SWD_IMAGE_INVALID;
+        }
+        raw[i] = (uint8_t)byte;
+        sum += raw[i];
+    }
+    if (sum != 0) {
+        SWD_LOGE("Bad checksum of the HEX record at offset %zu", p);
+        return SWD_IMAGE_INVALID;
+    }
+
+    rec->len = (uint8_t)len;
+    rec->addr = (uint16_t)((raw[1] << 8) | raw[2]);
+    rec->type = raw[3];
+    memcpy(rec->data, &raw[4], (size_t)len);
+    *pos = p + 11 + 2 * (size_t)len;
+
+    return SWD_OK;
+}
+
+int _swd_image_hex_byte(const uint8_t *p) {
+    int value = 0;
+    for (int i = 0; i < 2; i++) {
+        uint8_t c = p[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+const uint8_t *_swd_image_elf_shdr(const swd_image_t *img, uint32_t idx) {
+    uint64_t shoff = _swd_image_le32(&img->data[ELF_E_SHOFF]);
+    uint32_t shentsize = _swd_image_le16(&img->data[ELF_E_SHENTSIZE]);
+    uint64_t offset = shoff + (uint64_t)shentsize * idx;
+    if (shentsize < ELF_SHDR_SIZE || idx >= _swd_image_le16(&img->data[ELF_E_SHNUM]) ||
+        offset + ELF_SHDR_SIZE > img->size) {
+        return NULL;
+    }
+
+    return &img->data[offset];
+}
+
+bool _swd_image_elf_name_is(const swd_image_t *img, const uint8_t *strtab, uint32_t offset,
+                            const char *name) {
+    if (_swd_image_le32(&strtab[ELF_SH_TYPE]) == ELF_SHT_NOBITS) {
+        return false;
+    }
+
+    // The whole name and its terminator have to be within the table and the file
+    uint64_t start = (uint64_t)_swd_image_le32(&strtab[ELF_SH_OFFSET]) + offset;
+    uint64_t end = (uint64_t)_swd_image_le32(&strtab[ELF_SH_OFFSET]) +
+                   _swd_image_le32(&strtab[ELF_SH_SIZE]);
+    size_t len = strlen(name);
+    if (offset >= _swd_image_le32(&strtab[ELF_SH_SIZE]) || end > img->size ||
+        start + len >= end) {
+        return false;
+    }
+
+    return memcmp(&img->data[start], name, len + 1) == 0;
+}
+
+swd_err_t _swd_image_load_elf(const swd_image_t *img, _swd_image_emitter_t *em) {
+    const uint8_t *data = img->data;
+    uint32_t phoff = _swd_image_le32(&data[ELF_E_PHOFF]);
+    uint32_t phentsize = _swd_image_le16(&data[ELF_E_PHENTSIZE]);
+    uint32_t phnum = _swd_image_le16(&data[ELF_E_PHNUM]);
+
+    // Segments are taken by ascending physical address, which is not always the header order
+    uint64_t last_key = 0;
+    bool first = true;
+    while (true) {
+        const uint8_t *next = NULL;
+        uint64_t next_key = UINT64_MAX;
+        for (uint32_t i = 0; i < phnum; i++) {
+            const uint8_t *phdr = &data[phoff + i * phentsize];
+            if (_swd_image_le32(&phdr[ELF_P_TYPE]) != ELF_PT_LOAD ||
+                _swd_image_le32(&phdr[ELF_P_FILESZ]) == 0) {
+                continue;
+            }
+            // Physical address then header index, so equal addresses keep the header order
+            uint64_t key = ((uint64_t)_swd_image_le32(&phdr[ELF_P_PADDR]) << 16) | i;
+            if ((first || key > last_key) && key < next_key) {
+                next_key = key;
+                next = phdr;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        swd_err_t err = _swd_image_emit(em, _swd_image_le32(&next[ELF_P_PADDR]),
+                                        &data[_swd_image_le32(&next[ELF_P_OFFSET])],
+                                        _swd_image_le32(&next[ELF_P_FILESZ]));
+        SWD_RETURN_IF_NON_OK(err);
+
+        last_key = next_key;
+        first = false;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_image_load_hex(const swd_image_t *img, _swd_image_emitter_t *em) {
+    _swd_image_hex_rec_t rec;
+    uint32_t base = 0;
+    size_t pos = 0;
+
+    while (true) {
+        swd_err_t err = _swd_image_hex_next(img, &pos, &rec);
+        SWD_RETURN_IF_NON_OK(err);
+
+        switch (rec.type) {
+        case HEX_DATA:
+            err = _swd_image_emit(em, base + rec.addr, rec.data, rec.len);
+            SWD_RETURN_IF_NON_OK(err);
+            break;
+        case HEX_EXT_SEGMENT_ADDR:
+            base = ((uint32_t)rec.data[0] << 12) | ((uint32_t)rec.data[1] << 4);
+            break;
+        case HEX_EXT_LINEAR_ADDR:
+            base = ((uint32_t)rec.data[0] << 24) | ((uint32_t)rec.data[1] << 16);
+            break;
+        case HEX_EOF:
+            return SWD_OK;
+        default:
+            break;
+        }
+    }
+}
+
+swd_err_t _swd_image_emit(_swd_image_emitter_t *em, uint32_t addr, const uint8_t *data,
+                          uint32_t len) {
+    if (len == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err;
+    if (em->ranges > 0 && addr < em->end) {
+        SWD_LOGE("Image content at 0x%08" PRIx32 " overlaps or is out of order", addr);
+        return SWD_IMAGE_INVALID;
+    }
+    if (em->ranges == 0 || addr != em->end) {
+        // A gap within the staged chunk is filled, only a gap into another chunk ends the block
+        if (em->chunk_len > 0 &&
+            addr / SWD_IMAGE_CHUNK_BYTES == em->chunk_addr / SWD_IMAGE_CHUNK_BYTES) {
+            uint32_t gap = addr - (uint32_t)em->end;
+            memset(&em->chunk[em->chunk_len], SWD_IMAGE_GAP_FILL, gap);
+            em->chunk_len += gap;
+        } else {
+            err = _swd_image_flush(em);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+        em->ranges++;
+    }
+    em->end = (uint64_t)addr + len;
+    em->bytes += len;
+
+    while (len > 0) {
+        uint32_t n;
+        if (em->chunk_len == 0 && addr % SWD_IMAGE_CHUNK_BYTES == 0 &&
+            len >= SWD_IMAGE_CHUNK_BYTES) {
+            n = len - len % SWD_IMAGE_CHUNK_BYTES;
+            err = em->sink(em->ctx, addr, data, n);
+            SWD_RETURN_IF_NON_OK(err);
+        } else {
+            if (em->chunk_len == 0) {
+                em->chunk_addr = addr;
+            }
+            n = SWD_IMAGE_CHUNK_BYTES - addr % SWD_IMAGE_CHUNK_BYTES;
+            n = (n < len) ? n : len;
+            memcpy(&em->chunk[em->chunk_len], data, n);
+            em->chunk_len += n;
+
+            if ((addr + n) % SWD_IMAGE_CHUNK_BYTES == 0) {
+                err = _swd_image_flush(em);
+                SWD_RETURN_IF_NON_OK(err);
+            }
+        }
+
+        addr += n;
+        data += n;
+        len -= n;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_image_flush(_swd_image_emitter_t *em) {
+    if (em->chunk_len == 0) {
+        return SWD_OK;
+    }
+
+    swd_err_t err = em->sink(em->ctx, em->chunk_addr, em->chunk, em->chunk_len);
+    em->chunk_len = 0;
+
+    return err;
+}
\ No newline at end of file
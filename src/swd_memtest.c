@@ -0,0 +1,370 @@
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_log.h"
+#include "swd_memtest.h"
+
+// BKPT #0 followed by B . in case the core is not halted by the BKPT
+#define MEMTEST_TRAP ((uint32_t)0xE7FEBE00)
+
+// Entry points of the march routine
+#define MEMTEST_FILL (0)
+#define MEMTEST_FILL_ADDR (12)
+#define MEMTEST_MARCH (28)
+#define MEMTEST_MARCH_ADDR (46)
+
+// Elements of the walking test: 32 walking ones, 32 walking zeros, and a final read
+#define MEMTEST_WALK_PATTERNS (64)
+
+/*
+ * One pass over the memory. Reads expect `rd` and writes store `wr`, both XORed with the word's
+ *  address for address patterns
+ */
+typedef struct _swd_memtest_element_t {
+    bool down;
+    bool read;
+    bool write;
+    bool addr;
+    uint32_t rd;
+    uint32_t wr;
+} _swd_memtest_element_t;
+
+typedef struct _swd_memtest_ctx_t {
+    const _swd_memtest_element_t *el;
+    swd_memtest_report_t *report;
+    uint32_t addr;
+} _swd_memtest_ctx_t;
+
+static const _swd_memtest_element_t _swd_memtest_march_c_minus[] = {
+    {.down = false, .read = false, .write = true, .addr = false, .rd = 0, .wr = 0},
+    {.down = false, .read = true, .write = true, .addr = false, .rd = 0, .wr = 0xFFFFFFFF},
+    {.down = false, .read = true, .write = true, .addr = false, .rd = 0xFFFFFFFF, .wr = 0},
+    {.down = true, .read = true, .write = true, .addr = false, .rd = 0, .wr = 0xFFFFFFFF},
+    {.down = true, .read = true, .write = true, .addr = false, .rd = 0xFFFFFFFF, .wr = 0},
+    {.down = false, .read = true, .write = false, .addr = false, .rd = 0, .wr = 0},
+};
+
+static const _swd_memtest_element_t _swd_memtest_address[] = {
+    {.down = false, .read = false, .write = true, .addr = true, .rd = 0, .wr = 0},
+    {.down = false, .read = true, .write = true, .addr = true, .rd = 0, .wr = 0xFFFFFFFF},
+    {.down = false, .read = true, .write = false, .addr = true, .rd = 0xFFFFFFFF, .wr = 0},
+};
+
+/*
+ * uint32_t remaining = element(uint32_t *addr, uint32_t cnt, uint32_t rd, uint32_t wr), with
+ *  the address stride in R9. Returns at the first failing read, leaving the word unwritten.
+ *  Thumb-1 halfwords in little endian, must be loaded word aligned
+ */
+static const uint8_t _swd_memtest_code[] = {
+    // fill: store wr
+    0x00, 0x29, // cmp r1, #0
+    0x20, 0xD0, // beq done
+    0x03, 0x60, // str r3, [r0]
+    0x48, 0x44, // add r0, r9
+    0x01, 0x39, // subs r1, #1
+    0xF9, 0xE7, // b fill
+    // fill_addr: store addr ^ wr
+    0x00, 0x29, // cmp r1, #0
+    0x1A, 0xD0, // beq done
+    0x04, 0x00, // movs r4, r0
+    0x5C, 0x40, // eors r4, r3
+    0x04, 0x60, // str r4, [r0]
+    0x48, 0x44, // add r0, r9
+    0x01, 0x39, // subs r1, #1
+    0xF7, 0xE7, // b fill_addr
+    // march: check rd, store wr
+    0x00, 0x29, // cmp r1, #0
+    0x12, 0xD0, // beq done
+    0x04, 0x68, // ldr r4, [r0]
+    0x94, 0x42, // cmp r4, r2
+    0x0F, 0xD1, // bne done
+    0x03, 0x60, // str r3, [r0]
+    0x48, 0x44, // add r0, r9
+    0x01, 0x39, // subs r1, #1
+    0xF6, 0xE7, // b march
+    // march_addr: check addr ^ rd, store addr ^ wr
+    0x00, 0x29, // cmp r1, #0
+    0x09, 0xD0, // beq done
+    0x04, 0x68, // ldr r4, [r0]
+    0x44, 0x40, // eors r4, r0
+    0x94, 0x42, // cmp r4, r2
+    0x05, 0xD1, // bne done
+    0x04, 0x00, // movs r4, r0
+    0x5C, 0x40, // eors r4, r3
+    0x04, 0x60, // str r4, [r0]
+    0x48, 0x44, // add r0, r9
+    0x01, 0x39, // subs r1, #1
+    0xF3, 0xE7, // b march_addr
+    0x08, 0x00, // done: movs r0, r1
+    0x70, 0x47, // bx lr
+    0x00, 0xBF, // nop
+};
+
+/*
+ * @brief Element `idx` of an algorithm, returns false past the last one
+ */
+bool _swd_memtest_element(swd_memtest_algo_t algo, uint32_t idx, _swd_memtest_element_t *el);
+
+/*
+ * @brief Run an element from the host, a block at a time. The block is read and checked as a
+ *          whole before it is written, which gives up the per word read-write order
+ */
+swd_err_t _swd_memtest_host_element(swd_host_t *host, uint32_t addr, uint32_t len,
+                                    const _swd_memtest_element_t *el,
+                                    swd_memtest_report_t *report);
+
+/*
+ * @brief Run an element with the routine loaded at `scratch`, resuming after each failure
+ */
+swd_err_t _swd_memtest_target_element(swd_host_t *host, uint32_t addr, uint32_t len,
+                                      const _swd_memtest_element_t *el, uint32_t scratch,
+                                      uint32_t sp, swd_memtest_report_t *report);
+
+/*
+ * @brief Write the element's value to [addr, addr + len)
+ */
+swd_err_t _swd_memtest_write(swd_host_t *host, uint32_t addr, uint32_t len,
+                             const _swd_memtest_element_t *el);
+
+/*
+ * @brief Check streamed words against the element's read value
+ */
+swd_err_t _swd_memtest_check(void *ctx, uint64_t offset, const uint8_t *data, uint32_t len);
+
+/*
+ * @brief Generate the words of an address pattern
+ */
+swd_err_t _swd_memtest_generate(void *ctx, uint64_t offset, uint8_t *data, uint32_t len);
+
+void _swd_memtest_fail(swd_memtest_report_t *report, uint32_t addr, uint32_t expected,
+                       uint32_t actual);
+
+swd_err_t swd_memtest_run(swd_host_t *host, uint32_t addr, uint32_t len, swd_memtest_algo_t algo,
+                          uint32_t scratch, uint32_t scratch_size, swd_memtest_report_t *report) {
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(report != NULL);
+
+    report->fail_cnt = 0;
+    report->fail_mask = 0;
+    report->elements = 0;
+
+    if ((addr & 0x3) || (len & 0x3) || (uint64_t)addr + len > (uint64_t)UINT32_MAX + 1) {
+        return SWD_TARGET_INVALID_ADDR;
+    }
+
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!is_halted) {
+        return SWD_TARGET_NOT_HALTED;
+    }
+
+    bool on_target = scratch_size >= SWD_MEMTEST_SCRATCH_SIZE;
+    uint32_t sp = (scratch + scratch_size) & ~(uint32_t)0x7;
+    if (on_target) {
+        if ((scratch & 0x3) ||
+            ((uint64_t)addr + len > scratch && (uint64_t)scratch + scratch_size > addr)) {
+            SWD_LOGE("Memory test scratch at 0x%08" PRIx32 " overlaps the tested memory",
+                     scratch);
+            return SWD_TARGET_INVALID_ADDR;
+        }
+
+        err = swd_host_memory_write_word(host, scratch, MEMTEST_TRAP);
+        SWD_RETURN_IF_NON_OK(err);
+        err = swd_host_memory_write_byte_block(host, scratch + 4, _swd_memtest_code,
+                                               sizeof(_swd_memtest_code), NULL);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    _swd_memtest_element_t el;
+    for (uint32_t idx = 0; _swd_memtest_element(algo, idx, &el); idx++) {
+        if (on_target) {
+            err = _swd_memtest_target_element(host, addr, len, &el, scratch, sp, report);
+        } else {
+            err = _swd_memtest_host_element(host, addr, len, &el, report);
+        }
+        SWD_RETURN_IF_NON_OK(err);
+        report->elements++;
+    }
+
+    if (report->fail_cnt > 0) {
+        SWD_LOGW("Memory test of 0x%08" PRIx32 "-0x%08" PRIx32 " failed %" PRIu32
+                 " reads, bits 0x%08" PRIx32,
+                 addr, addr + len - 1, report->fail_cnt, report->fail_mask);
+    } else {
+        SWD_LOGI("Memory test of 0x%08" PRIx32 "-0x%08" PRIx32 " passed", addr, addr + len - 1);
+    }
+
+    return SWD_OK;
+}
+
+bool _swd_memtest_element(swd_memtest_algo_t algo, uint32_t idx, _swd_memtest_element_t *el) {
+    switch (algo) {
+    case SWD_MEMTEST_MARCH_C_MINUS:
+        if (idx >= sizeof(_swd_memtest_march_c_minus) / sizeof(_swd_memtest_march_c_minus[0])) {
+            return false;
+        }
+        *el = _swd_memtest_march_c_minus[idx];
+        return true;
+
+    case SWD_MEMTEST_WALKING: {
+        if (idx > MEMTEST_WALK_PATTERNS) {
+            return false;
+        }
+        // Pattern k is a one at bit k, then a zero at bit k - 32. Each element checks the
+        // previous pattern while writing the next one
+        uint32_t prev = (idx - 1) % 32;
+        uint32_t next = idx % 32;
+        *el = (_swd_memtest_element_t){
+            .down = false,
+            .read = idx > 0,
+            .write = idx < MEMTEST_WALK_PATTERNS,
+            .addr = false,
+            .rd = (idx - 1 < 32) ? (uint32_t)0x1 << prev : ~((uint32_t)0x1 << prev),
+            .wr = (idx < 32) ? (uint32_t)0x1 << next : ~((uint32_t)0x1 << next),
+        };
+        return true;
+    }
+
+    case SWD_MEMTEST_ADDRESS:
+        if (idx >= sizeof(_swd_memtest_address) / sizeof(_swd_memtest_address[0])) {
+            return false;
+        }
+        *el = _swd_memtest_address[idx];
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+swd_err_t _swd_memtest_host_element(swd_host_t *host, uint32_t addr, uint32_t len,
+                                    const _swd_memtest_element_t *el,
+                                    swd_memtest_report_t *report) {
+    if (!el->read) {
+        return _swd_memtest_write(host, addr, len, el);
+    }
+
+    uint32_t blocks = (uint32_t)(((uint64_t)len + SWD_MEMTEST_BLOCK_BYTES - 1) /
+                                 SWD_MEMTEST_BLOCK_BYTES);
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t offset = (el->down ? blocks - 1 - b : b) * SWD_MEMTEST_BLOCK_BYTES;
+        uint32_t n = len - offset;
+        n = (n < SWD_MEMTEST_BLOCK_BYTES) ? n : SWD_MEMTEST_BLOCK_BYTES;
+
+        _swd_memtest_ctx_t check = {.el = el, .report = report, .addr = addr + offset};
+        swd_err_t err = swd_host_memory_read_stream(host, addr + offset, n, _swd_memtest_check,
+                                                    NULL, &check, NULL);
+        SWD_RETURN_IF_NON_OK(err);
+
+        if (el->write) {
+            err = _swd_memtest_write(host, addr + offset, n, el);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_memtest_target_element(swd_host_t *host, uint32_t addr, uint32_t len,
+                                      const _swd_memtest_element_t *el, uint32_t scratch,
+                                      uint32_t sp, swd_memtest_report_t *report) {
+    uint32_t entry;
+    if (el->read) {
+        entry = el->addr ? MEMTEST_MARCH_ADDR : MEMTEST_MARCH;
+    } else {
+        entry = el->addr ? MEMTEST_FILL_ADDR : MEMTEST_FILL;
+    }
+
+    // A read-only element writes back the value it expects
+    swd_host_call_t call = {
+        .entry = scratch + 4 + entry,
+        .args = {el->down ? addr + len - 4 : addr, len / 4, el->rd, el->write ? el->wr : el->rd},
+        .sp = sp,
+        .trap = scratch,
+        .sb = el->down ? (uint32_t)-4 : 4,
+    };
+
+    while (call.args[1] > 0) {
+        uint32_t remaining;
+        swd_err_t err = swd_host_call(host, &call, SWD_MEMTEST_MAX_POLLS, &remaining);
+        SWD_RETURN_IF_NON_OK(err);
+        if (remaining == 0) {
+            break;
+        }
+
+        uint32_t bad = call.args[0] + call.sb * (call.args[1] - remaining);
+        uint32_t mask = el->addr ? bad : 0;
+        uint32_t actual;
+        err = swd_host_memory_read_word(host, bad, &actual);
+        SWD_RETURN_IF_NON_OK(err);
+        _swd_memtest_fail(report, bad, el->rd ^ mask, actual);
+
+        // Complete the failing word as the routine would have, then carry on after it
+        err = swd_host_memory_write_word(host, bad, call.args[3] ^ mask);
+        SWD_RETURN_IF_NON_OK(err);
+        call.args[0] = bad + call.sb;
+        call.args[1] = remaining - 1;
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_memtest_write(swd_host_t *host, uint32_t addr, uint32_t len,
+                             const _swd_memtest_element_t *el) {
+    if (!el->addr) {
+        uint8_t word[4] = {(uint8_t)el->wr, (uint8_t)(el->wr >> 8), (uint8_t)(el->wr >> 16),
+                           (uint8_t)(el->wr >> 24)};
+        return swd_host_memory_fill(host, addr, len, word, sizeof(word));
+    }
+
+    _swd_memtest_ctx_t gen = {.el = el, .report = NULL, .addr = addr};
+    return swd_host_memory_write_stream(host, addr, len, _swd_memtest_generate, NULL, &gen, NULL);
+}
+
+swd_err_t _swd_memtest_check(void *ctx, uint64_t offset, const uint8_t *data, uint32_t len) {
+    _swd_memtest_ctx_t *check = ctx;
+    const _swd_memtest_element_t *el = check->el;
+
+    // Chunks of a word aligned stream stay word aligned
+    for (uint32_t i = 0; i + 4 <= len; i += 4) {
+        uint32_t addr = check->addr + (uint32_t)offset + i;
+        uint32_t expected = el->rd ^ (el->addr ? addr : 0);
+        uint32_t actual = (uint32_t)data[i] | ((uint32_t)data[i + 1] << 8) |
+                          ((uint32_t)data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24);
+        if (actual != expected) {
+            _swd_memtest_fail(check->report, addr, expected, actual);
+        }
+    }
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_memtest_generate(void *ctx, uint64_t offset, uint8_t *data, uint32_t len) {
+    _swd_memtest_ctx_t *gen = ctx;
+
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t addr = gen->addr + (uint32_t)offset + i;
+        uint32_t value = gen->el->wr ^ (addr & ~(uint32_t)0x3);
+        data[i] = (uint8_t)(value >> (8 * (addr & 0x3)));
+    }
+
+    return SWD_OK;
+}
+
+void _swd_memtest_fail(swd_memtest_report_t *report, uint32_t addr, uint32_t expected,
+                       uint32_t actual) {
+    if (report->fails != NULL && report->fail_cnt < report->fails_size) {
+        report->fails[report->fail_cnt] = (swd_memtest_fail_t){
+            .addr = addr,
+            .expected = expected,
+            .actual = actual,
+        };
+    }
+    report->fail_cnt++;
+    report->fail_mask |= expected ^ actual;
+}
\ No newline at end of file
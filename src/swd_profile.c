@@ -0,0 +1,269 @@
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_log.h"
+#include "swd_profile.h"
+#include "swd_target_register.h"
+
+#include "_swd_arch_addr_decl.h"
+
+// Keep probe sequences short
+#define PROFILE_MAX_USED ((SWD_PROFILE_BUCKETS * 3) / 4)
+
+// DWT_PCSR reads as all ones while the core is halted
+#define PCSR_HALTED ((uint32_t)0xFFFFFFFF)
+
+// Reads used to tell a missing DWT_PCSR (read as zero) from a running core
+#define PCSR_DETECT_READS (4)
+
+/*
+ * @brief Add one sample of `pc` to the histogram
+ */
+void _swd_profile_record(swd_profile_t *prof, uint32_t pc);
+
+/*
+ * @brief Halt the core, read its PC and resume it
+ */
+swd_err_t _swd_profile_halt_sample(swd_profile_t *prof, uint32_t *pc);
+
+/*
+ * @brief Append `len` bytes to the export chunk, handing full chunks to the consumer
+ */
+swd_err_t _swd_profile_emit(uint8_t *chunk, uint32_t *chunk_len, uint64_t *offset,
+                            const char *text, uint32_t len, swd_host_stream_consumer_t consumer,
+                            void *_Nullable ctx);
+
+uint32_t _swd_profile_now(const swd_profile_t *prof);
+
+swd_err_t swd_profile_init(swd_profile_t *prof, swd_host_t *host,
+                           swd_profile_clock_t _Nullable clock, void *_Nullable clock_ctx) {
+    SWD_ASSERT(prof != NULL);
+    SWD_ASSERT(host != NULL);
+
+    prof->host = host;
+    prof->_clock = clock;
+    prof->_clock_ctx = clock_ctx;
+    swd_profile_reset(prof);
+
+    // Cores without DWT_PCSR read it as zero, a running core never samples address 0 for long
+    uint32_t reads[PCSR_DETECT_READS];
+    swd_err_t err = swd_host_memory_read_repeat(host, DWT_PCSR, reads, PCSR_DETECT_READS);
+    SWD_RETURN_IF_NON_OK(err);
+
+    prof->_use_pcsr = false;
+    for (uint32_t i = 0; i < PCSR_DETECT_READS; i++) {
+        prof->_use_pcsr |= reads[i] != 0;
+    }
+    SWD_LOGI("Profiler samples %s", prof->_use_pcsr ? "DWT_PCSR" : "by halting the core");
+
+    return SWD_OK;
+}
+
+void swd_profile_reset(swd_profile_t *prof) {
+    SWD_ASSERT(prof != NULL);
+
+    memset(prof->_buckets, 0, sizeof(prof->_buckets));
+    prof->_used = 0;
+    prof->_samples = 0;
+    prof->_halted = 0;
+    prof->_dropped = 0;
+    prof->_elapsed_us = 0;
+    prof->_stopped_us = 0;
+}
+
+swd_err_t swd_profile_sample(swd_profile_t *prof, uint32_t cnt) {
+    SWD_ASSERT(prof != NULL);
+
+    uint32_t pcs[SWD_PROFILE_BATCH];
+    uint32_t start = _swd_profile_now(prof);
+    swd_err_t err = SWD_OK;
+
+    while (cnt > 0 && err == SWD_OK) {
+        uint32_t batch = (cnt < SWD_PROFILE_BATCH) ? cnt : SWD_PROFILE_BATCH;
+
+        if (prof->_use_pcsr) {
+            err = swd_host_memory_read_repeat(prof->host, DWT_PCSR, pcs, batch);
+        } else {
+            for (uint32_t i = 0; i < batch && err == SWD_OK; i++) {
+                err = _swd_profile_halt_sample(prof, &pcs[i]);
+            }
+        }
+        if (err != SWD_OK) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < batch; i++) {
+            _swd_profile_record(prof, pcs[i]);
+        }
+        cnt -= batch;
+    }
+
+    prof->_elapsed_us += (uint32_t)(_swd_profile_now(prof) - start);
+
+    return err;
+}
+
+void swd_profile_stats(const swd_profile_t *prof, swd_profile_stats_t *stats) {
+    SWD_ASSERT(prof != NULL);
+    SWD_ASSERT(stats != NULL);
+
+    stats->samples = prof->_samples;
+    stats->halted = prof->_halted;
+    stats->dropped = prof->_dropped;
+    stats->uses_pcsr = prof->_use_pcsr;
+
+    uint64_t total = prof->_samples + prof->_halted + prof->_dropped;
+    stats->rate = 0;
+    stats->overhead_ppm = 0;
+    if (prof->_elapsed_us > 0) {
+        uint64_t rate = (total * 1000000) / prof->_elapsed_us;
+        stats->rate = (rate < UINT32_MAX) ? (uint32_t)rate : UINT32_MAX;
+        stats->overhead_ppm = (uint32_t)((prof->_stopped_us * 1000000) / prof->_elapsed_us);
+    }
+}
+
+void swd_profile_hotspots(const swd_profile_t *prof, swd_profile_bucket_t *buf, uint32_t bufsz,
+                          uint32_t *cnt) {
+    SWD_ASSERT(prof != NULL);
+    SWD_ASSERT(buf != NULL || bufsz == 0);
+
+    // Insertion into the sorted output, only the `bufsz` hottest buckets are kept
+    *cnt = 0;
+    for (uint32_t i = 0; i < SWD_PROFILE_BUCKETS; i++) {
+        const swd_profile_bucket_t *bucket = &prof->_buckets[i];
+        if (bucket->hits == 0) {
+            continue;
+        }
+        if (*cnt == bufsz && (bufsz == 0 || buf[bufsz - 1].hits >= bucket->hits)) {
+            continue;
+        }
+
+        uint32_t j = (*cnt < bufsz) ? (*cnt)++ : bufsz - 1;
+        while (j > 0 && buf[j - 1].hits < bucket->hits) {
+            buf[j] = buf[j - 1];
+            j--;
+        }
+        buf[j] = *bucket;
+    }
+}
+
+swd_err_t swd_profile_export_collapsed(const swd_profile_t *prof,
+                                       swd_profile_symbolize_t _Nullable symbolize,
+                                       void *_Nullable sym_ctx,
+                                       swd_host_stream_consumer_t consumer,
+                                       void *_Nullable ctx) {
+    SWD_ASSERT(prof != NULL);
+    SWD_ASSERT(consumer != NULL);
+
+    uint8_t chunk[SWD_HOST_STREAM_CHUNK_BYTES];
+    uint32_t chunk_len = 0;
+    uint64_t offset = 0;
+    char line[128];
+    swd_err_t err;
+
+    for (uint32_t i = 0; i < SWD_PROFILE_BUCKETS; i++) {
+        const swd_profile_bucket_t *bucket = &prof->_buckets[i];
+        if (bucket->hits == 0) {
+            continue;
+        }
+
+        const char *sym = (symbolize != NULL) ? symbolize(sym_ctx, bucket->pc) : NULL;
+        int len;
+        if (sym != NULL) {
+            len = snprintf(line, sizeof(line), "%s;0x%08" PRIx32 " %" PRIu32 "\n", sym,
+                           bucket->pc, bucket->hits);
+        } else {
+            len = snprintf(line, sizeof(line), "0x%08" PRIx32 " %" PRIu32 "\n", bucket->pc,
+                           bucket->hits);
+        }
+        if (len < 0 || (uint32_t)len >= sizeof(line)) {
+            SWD_LOGW("Symbol of 0x%08" PRIx32 " is too long", bucket->pc);
+            continue;
+        }
+
+        err = _swd_profile_emit(chunk, &chunk_len, &offset, line, (uint32_t)len, consumer, ctx);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    if (chunk_len > 0) {
+        err = consumer(ctx, offset, chunk, chunk_len);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    return SWD_OK;
+}
+
+void _swd_profile_record(swd_profile_t *prof, uint32_t pc) {
+    if (pc == PCSR_HALTED) {
+        prof->_halted++;
+        return;
+    }
+
+    // Fibonacci hashing of the halfword index, then linear probing
+    uint32_t slot = (((pc >> 1) * 2654435769u) >> 16) & (SWD_PROFILE_BUCKETS - 1);
+    while (prof->_buckets[slot].hits != 0 && prof->_buckets[slot].pc != pc) {
+        slot = (slot + 1) & (SWD_PROFILE_BUCKETS - 1);
+    }
+
+    swd_profile_bucket_t *bucket = &prof->_buckets[slot];
+    if (bucket->hits == 0) {
+        if (prof->_used == PROFILE_MAX_USED) {
+            prof->_dropped++;
+            return;
+        }
+        bucket->pc = pc;
+        prof->_used++;
+    }
+    if (bucket->hits != UINT32_MAX) {
+        bucket->hits++;
+    }
+    prof->_samples++;
+}
+
+swd_err_t _swd_profile_halt_sample(swd_profile_t *prof, uint32_t *pc) {
+    uint32_t start = _swd_profile_now(prof);
+
+    swd_err_t err = swd_host_halt_target(prof->host);
+    SWD_RETURN_IF_NON_OK(err);
+
+    err = swd_host_register_read(prof->host, REG_DEBUG_RETURN_ADDRESS, pc);
+    SWD_RETURN_IF_NON_OK(err);
+
+    err = swd_host_continue_target(prof->host);
+    SWD_RETURN_IF_NON_OK(err);
+
+    prof->_stopped_us += (uint32_t)(_swd_profile_now(prof) - start);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_profile_emit(uint8_t *chunk, uint32_t *chunk_len, uint64_t *offset,
+                            const char *text, uint32_t len, swd_host_stream_consumer_t consumer,
+                            void *_Nullable ctx) {
+    while (len > 0) {
+        uint32_t n = SWD_HOST_STREAM_CHUNK_BYTES - *chunk_len;
+        n = (n < len) ? n : len;
+        memcpy(&chunk[*chunk_len], text, n);
+        *chunk_len += n;
+        text += n;
+        len -= n;
+
+        if (*chunk_len == SWD_HOST_STREAM_CHUNK_BYTES) {
+            swd_err_t err = consumer(ctx, *offset, chunk, *chunk_len);
+            SWD_RETURN_IF_NON_OK(err);
+            *offset += *chunk_len;
+            *chunk_len = 0;
+        }
+    }
+
+    return SWD_OK;
+}
+
+uint32_t _swd_profile_now(const swd_profile_t *prof) {
+    return (prof->_clock != NULL) ? prof->_clock(prof->_clock_ctx) : 0;
+}
\ No newline at end of file
@@ -0,0 +1,239 @@
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_err.h"
+#include "swd_host.h"
+#include "swd_image.h"
+#include "swd_log.h"
+#include "swd_target_register.h"
+#include "swd_testrun.h"
+
+#include "_swd_arch_addr_decl.h"
+
+#define TESTRUN_SEQ_SHIFT (16)
+#define TESTRUN_LEN_MASK ((uint32_t)0xFFFF)
+
+// Size of the Thumb BKPT instruction ending a test
+#define TESTRUN_BKPT_SIZE (2)
+
+/*
+ * @brief Wait for `(word & mask) == value` at `addr` with pipelined repeated reads, checking
+ *          between bursts that the core neither halted nor locked up
+ * @param uint32_t* last value read
+ * @param uint32_t* reads done
+ */
+swd_err_t _swd_testrun_poll(swd_testrun_t *run, uint32_t addr, uint32_t mask, uint32_t value,
+                            uint32_t *word, uint32_t *polls);
+
+/*
+ * @brief Wait for the core to halt on the BKPT ending a test, one DHCSR read per poll
+ */
+swd_err_t _swd_testrun_wait_bkpt(swd_testrun_t *run, uint32_t *polls);
+
+/*
+ * @brief Halt a core which stopped outside of the protocol and report where
+ */
+swd_err_t _swd_testrun_stopped(swd_testrun_t *run, uint32_t dhcsr);
+
+swd_err_t swd_testrun_open(swd_testrun_t *run, swd_host_t *host, const swd_image_t *elf,
+                           swd_testrun_done_t done, uint32_t max_polls) {
+    SWD_ASSERT(run != NULL);
+    SWD_ASSERT(host != NULL);
+    SWD_ASSERT(elf != NULL);
+
+    bool found;
+    uint32_t mailbox;
+    swd_err_t err = swd_image_elf_symbol(elf, SWD_TESTRUN_MAILBOX_SYMBOL, &found, &mailbox);
+    SWD_RETURN_IF_NON_OK(err);
+    if (!found || (mailbox & 0x3)) {
+        SWD_LOGE("No word aligned %s in the image", SWD_TESTRUN_MAILBOX_SYMBOL);
+        return SWD_TARGET_NOT_SUPPORTED;
+    }
+
+    *run = (swd_testrun_t){
+        .host = host,
+        .mailbox = mailbox,
+        .done = done,
+        .max_polls = max_polls,
+    };
+
+    // The firmware may be held in reset halt or sit on a halt of the previous session
+    bool is_halted;
+    err = swd_host_is_target_halted(host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    if (is_halted) {
+        // Resuming on the BKPT ending the previous session's last test would halt again at once
+        uint32_t pc;
+        uint8_t insn[2];
+        err = swd_host_register_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
+        SWD_RETURN_IF_NON_OK(err);
+        err = swd_host_memory_read_byte_block(host, pc, insn, sizeof(insn), NULL);
+        SWD_RETURN_IF_NON_OK(err);
+        if (insn[1] == (THUMB_BKPT >> 8)) { // BKPT #imm8, whatever the immediate
+            err = swd_host_registers_stage(host, REG_DEBUG_RETURN_ADDRESS,
+                                           pc + TESTRUN_BKPT_SIZE);
+            SWD_RETURN_IF_NON_OK(err);
+        }
+        err = swd_host_continue_target(host);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    uint32_t word;
+    uint32_t polls;
+    err = _swd_testrun_poll(run, mailbox + SWD_TESTRUN_MAGIC_OFFSET, UINT32_MAX,
+                            SWD_TESTRUN_MAGIC, &word, &polls);
+    SWD_RETURN_IF_NON_OK(err);
+
+    // Continue the sequence of a previous session, the firmware waits for a different value
+    err = swd_host_memory_read_word(host, mailbox + SWD_TESTRUN_DOORBELL_OFFSET, &word);
+    SWD_RETURN_IF_NON_OK(err);
+    run->_seq = (uint16_t)word;
+
+    SWD_LOGI("Test mailbox at 0x%08" PRIx32 " ready after %" PRIu32 " polls", mailbox, polls);
+    return SWD_OK;
+}
+
+swd_err_t swd_testrun_run(swd_testrun_t *run, uint32_t test_id, swd_testrun_result_t *result) {
+    SWD_ASSERT(run != NULL);
+    SWD_ASSERT(result != NULL);
+    SWD_ASSERT(result->records != NULL || result->records_size == 0);
+
+    swd_host_t *host = run->host;
+    uint16_t seq = (uint16_t)(run->_seq + 1);
+    seq = (seq == 0) ? 1 : seq;
+
+    // The test id lands before the doorbell, both in one transfer
+    uint32_t words[2] = {test_id, seq};
+    swd_err_t err = swd_host_memory_write_word_block(
+        host, run->mailbox + SWD_TESTRUN_TEST_ID_OFFSET, words, 2, NULL);
+    SWD_RETURN_IF_NON_OK(err);
+    run->_seq = seq;
+
+    if (run->_at_bkpt) {
+        uint32_t pc;
+        err = swd_host_register_read(host, REG_DEBUG_RETURN_ADDRESS, &pc);
+        SWD_RETURN_IF_NON_OK(err);
+        err = swd_host_registers_stage(host, REG_DEBUG_RETURN_ADDRESS, pc + TESTRUN_BKPT_SIZE);
+        SWD_RETURN_IF_NON_OK(err);
+        err = swd_host_continue_target(host);
+        SWD_RETURN_IF_NON_OK(err);
+        run->_at_bkpt = false;
+    }
+
+    uint32_t status;
+    uint32_t status_addr = run->mailbox + SWD_TESTRUN_STATUS_OFFSET;
+    if (run->done == SWD_TESTRUN_DONE_BKPT) {
+        err = _swd_testrun_wait_bkpt(run, &result->polls);
+        SWD_RETURN_IF_NON_OK(err);
+        err = swd_host_memory_read_word(host, status_addr, &status);
+        SWD_RETURN_IF_NON_OK(err);
+        if ((status >> TESTRUN_SEQ_SHIFT) != seq) {
+            run->_at_bkpt = false;
+            return _swd_testrun_stopped(run, S_HALTED);
+        }
+    } else {
+        err = _swd_testrun_poll(run, status_addr, ~TESTRUN_LEN_MASK,
+                                (uint32_t)seq << TESTRUN_SEQ_SHIFT, &status, &result->polls);
+        SWD_RETURN_IF_NON_OK(err);
+    }
+
+    // The result word and the records are adjacent, so they come in one block read
+    uint8_t code[4];
+    result->records_len = status & TESTRUN_LEN_MASK;
+    uint32_t len = result->records_len;
+    len = (len < result->records_size) ? len : result->records_size;
+    swd_host_iovec_t iov[2] = {
+        {.addr = run->mailbox + SWD_TESTRUN_RESULT_OFFSET, .len = sizeof(code), .buf = code},
+        {.addr = run->mailbox + SWD_TESTRUN_RECORDS_OFFSET, .len = len, .buf = result->records},
+    };
+    err = swd_host_memory_readv(host, iov, (len > 0) ? 2 : 1);
+    SWD_RETURN_IF_NON_OK(err);
+    result->result = (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) |
+                     ((uint32_t)code[3] << 24);
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_testrun_poll(swd_testrun_t *run, uint32_t addr, uint32_t mask, uint32_t value,
+                            uint32_t *word, uint32_t *polls) {
+    uint32_t burst[SWD_TESTRUN_POLL_BURST];
+
+    *word = 0;
+    *polls = 0;
+    while (*polls < run->max_polls) {
+        uint32_t n = run->max_polls - *polls;
+        n = (n < SWD_TESTRUN_POLL_BURST) ? n : SWD_TESTRUN_POLL_BURST;
+        swd_err_t err = swd_host_memory_read_repeat(run->host, addr, burst, n);
+        SWD_RETURN_IF_NON_OK(err);
+
+        for (uint32_t i = 0; i < n; i++) {
+            if ((burst[i] & mask) == value) {
+                *word = burst[i];
+                *polls += i + 1;
+                return SWD_OK;
+            }
+        }
+        *polls += n;
+        *word = burst[n - 1];
+
+        // A test which faults halts or locks up instead of completing
+        uint32_t dhcsr;
+        err = swd_host_window_read(run->host, DHCSR, &dhcsr);
+        SWD_RETURN_IF_NON_OK(err);
+        if (dhcsr & (S_HALTED | S_LOCKUP)) {
+            return _swd_testrun_stopped(run, dhcsr);
+        }
+    }
+
+    SWD_LOGW("Mailbox word 0x%08" PRIx32 " still 0x%08" PRIx32 " after %" PRIu32 " polls", addr,
+             *word, *polls);
+    swd_err_t err = swd_host_halt_target(run->host);
+    SWD_RETURN_IF_NON_OK(err);
+
+    return SWD_TARGET_NOT_HALTED;
+}
+
+swd_err_t _swd_testrun_wait_bkpt(swd_testrun_t *run, uint32_t *polls) {
+    uint32_t dhcsr = 0;
+    for (*polls = 0; *polls < run->max_polls; (*polls)++) {
+        swd_err_t err = swd_host_window_read(run->host, DHCSR, &dhcsr);
+        SWD_RETURN_IF_NON_OK(err);
+        if (dhcsr & (S_HALTED | S_LOCKUP)) {
+            (*polls)++;
+            break;
+        }
+    }
+
+    if (!(dhcsr & (S_HALTED | S_LOCKUP))) {
+        SWD_LOGW("Test did not halt after %" PRIu32 " polls", *polls);
+        swd_err_t err = swd_host_halt_target(run->host);
+        SWD_RETURN_IF_NON_OK(err);
+        return SWD_TARGET_NOT_HALTED;
+    }
+    if (dhcsr & S_LOCKUP) {
+        return _swd_testrun_stopped(run, dhcsr);
+    }
+
+    // Let the host know the core is halted, so memory reads may be cached
+    bool is_halted;
+    swd_err_t err = swd_host_is_target_halted(run->host, &is_halted);
+    SWD_RETURN_IF_NON_OK(err);
+    run->_at_bkpt = is_halted;
+
+    return SWD_OK;
+}
+
+swd_err_t _swd_testrun_stopped(swd_testrun_t *run, uint32_t dhcsr) {
+    swd_err_t err = swd_host_halt_target(run->host);
+    SWD_RETURN_IF_NON_OK(err);
+
+    uint32_t pc;
+    err = swd_host_register_read(run->host, REG_DEBUG_RETURN_ADDRESS, &pc);
+    SWD_RETURN_IF_NON_OK(err);
+    SWD_LOGE("Test %s at 0x%08" PRIx32 " instead of completing",
+             (dhcsr & S_LOCKUP) ? "locked up" : "halted", pc);
+
+    return SWD_ERR;
+}
\ No newline at end of file